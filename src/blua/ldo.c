@@ -498,6 +498,7 @@ struct SParser {  /* data to `f_parser' */
   ZIO *z;
   Mbuffer buff;  /* buffer to be used by the scanner */
   const char *name;
+  int binary;  /* accept precompiled chunks? */
 };
 
 static void f_parser (lua_State *L, void *ud) {
@@ -508,13 +509,12 @@ static void f_parser (lua_State *L, void *ud) {
   int c = luaZ_lookahead(p->z);
   luaC_checkGC(L);
 #ifdef LUA_ALLOW_BYTECODE
+  p->binary = 1;
+#endif
+  if (c == LUA_SIGNATURE[0] && !p->binary)
+		luaG_runerror(L, "invalid format, cannot load bytecode scripts");
   tf = ((c == LUA_SIGNATURE[0]) ? luaU_undump : luaY_parser)(L, p->z,
                                                              &p->buff, p->name);
-#else
-  if (c == LUA_SIGNATURE[0])
-		luaG_runerror(L, "invalid format, cannot load bytecode scripts");
-  tf = luaY_parser(L, p->z, &p->buff, p->name);
-#endif
   cl = luaF_newLclosure(L, tf->nups, hvalue(gt(L)));
   cl->l.p = tf;
   for (i = 0; i < tf->nups; i++)  /* initialize eventual upvalues */
@@ -524,10 +524,10 @@ static void f_parser (lua_State *L, void *ud) {
 }
 
 
-int luaD_protectedparser (lua_State *L, ZIO *z, const char *name) {
+int luaD_protectedparser (lua_State *L, ZIO *z, const char *name, int binary) {
   struct SParser p;
   int status;
-  p.z = z; p.name = name;
+  p.z = z; p.name = name; p.binary = binary;
   luaZ_initbuffer(L, &p.buff);
   status = luaD_pcall(L, f_parser, &p, savestack(L, L->top), L->errfunc);
   luaZ_freebuffer(L, &p.buff);
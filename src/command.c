@@ -35,6 +35,7 @@
 #include "d_netfil.h" // findfile
 #include "r_data.h" // Color_cons_t
 #include "d_main.h" // D_IsPathAllowed
+#include "i_system.h" // I_GetPreciseTime
 
 //========
 // protos.
@@ -63,6 +64,14 @@ static boolean CV_Immutable(const consvar_t *var);
 static consvar_t *consvar_vars; // list of registered console variables
 static UINT16     consvar_number_of_netids = 0;
 
+// Names are looked up case insensitively through these hash tables; the
+// lists above and below keep registration order for completion and saving.
+#define COM_HASHSIZE 256
+#define COM_NameHash(name) (quickncasehash(name, (size_t)-1) & (COM_HASHSIZE-1))
+
+static consvar_t *consvar_hash[COM_HASHSIZE];
+static consvar_t **consvar_netvars; // indexed by netid
+
 #ifdef OLD22DEMOCOMPAT
 static old_demo_var_t *consvar_old_demo_vars;
 #endif
@@ -100,11 +109,13 @@ static INT32 com_wait; // one command per frame (for cmd sequences)
 typedef struct cmdalias_s
 {
 	struct cmdalias_s *next;
+	struct cmdalias_s *hashnext;
 	char *name;
 	char *value; // the command string to replace the alias
 } cmdalias_t;
 
 static cmdalias_t *com_alias; // aliases list
+static cmdalias_t *com_aliashash[COM_HASHSIZE];
 
 // =========================================================================
 //                            COMMAND BUFFER
@@ -313,11 +324,43 @@ typedef struct xcommand_s
 {
 	const char *name;
 	struct xcommand_s *next;
+	struct xcommand_s *hashnext;
 	com_func_t function;
 	com_flags_t flags;
 } xcommand_t;
 
 static xcommand_t *com_commands = NULL; // current commands
+static xcommand_t *com_commandhash[COM_HASHSIZE];
+
+/** Finds a command by name.
+  *
+  * \param name Name of the command, case insensitive.
+  * \return The command, or NULL if there's none by that name.
+  */
+static xcommand_t *COM_FindCommand(const char *name)
+{
+	xcommand_t *cmd;
+
+	for (cmd = com_commandhash[COM_NameHash(name)]; cmd; cmd = cmd->hashnext)
+		if (!stricmp(name, cmd->name))
+			return cmd;
+
+	return NULL;
+}
+
+/** Links a new command into the command list.
+  *
+  * \param cmd The command, with name, function and flags filled in.
+  */
+static void COM_LinkCommand(xcommand_t *cmd)
+{
+	UINT32 hash = COM_NameHash(cmd->name);
+
+	cmd->next = com_commands;
+	com_commands = cmd;
+	cmd->hashnext = com_commandhash[hash];
+	com_commandhash[hash] = cmd;
+}
 
 #define MAX_ARGS 80
 static size_t com_argc;
@@ -495,27 +538,24 @@ void COM_AddCommand(const char *name, com_func_t func, com_flags_t flags)
 	}
 
 	// fail if the command already exists
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	cmd = COM_FindCommand(name); //case insensitive now that we have lower and uppercase!
+	if (cmd)
 	{
-		if (!stricmp(name, cmd->name)) //case insensitive now that we have lower and uppercase!
-		{
-			// don't I_Error for Lua commands
-			// Lua commands can replace game commands, and they have priority.
-			// BUT, if for some reason we screwed up and made two console commands with the same name,
-			// it's good to have this here so we find out.
-			if (cmd->function != COM_Lua_f)
-				I_Error("Command %s already exists\n", name);
+		// don't I_Error for Lua commands
+		// Lua commands can replace game commands, and they have priority.
+		// BUT, if for some reason we screwed up and made two console commands with the same name,
+		// it's good to have this here so we find out.
+		if (cmd->function != COM_Lua_f)
+			I_Error("Command %s already exists\n", name);
 
-			return;
-		}
+		return;
 	}
 
 	cmd = ZZ_Alloc(sizeof *cmd);
 	cmd->name = name;
 	cmd->function = func;
 	cmd->flags = flags;
-	cmd->next = com_commands;
-	com_commands = cmd;
+	COM_LinkCommand(cmd);
 }
 
 /** Adds a console command for Lua.
@@ -532,14 +572,12 @@ int COM_AddLuaCommand(const char *name)
 		return -1;
 
 	// command already exists
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	cmd = COM_FindCommand(name); //case insensitive now that we have lower and uppercase!
+	if (cmd)
 	{
-		if (!stricmp(name, cmd->name)) //case insensitive now that we have lower and uppercase!
-		{
-			// replace the built in command.
-			cmd->function = COM_Lua_f;
-			return 1;
-		}
+		// replace the built in command.
+		cmd->function = COM_Lua_f;
+		return 1;
 	}
 
 	// Add a new command.
@@ -547,8 +585,7 @@ int COM_AddLuaCommand(const char *name)
 	cmd->name = name;
 	cmd->function = COM_Lua_f;
 	cmd->flags = COM_LUA;
-	cmd->next = com_commands;
-	com_commands = cmd;
+	COM_LinkCommand(cmd);
 	return 0;
 }
 
@@ -559,13 +596,7 @@ int COM_AddLuaCommand(const char *name)
   */
 static boolean COM_Exists(const char *com_name)
 {
-	xcommand_t *cmd;
-
-	for (cmd = com_commands; cmd; cmd = cmd->next)
-		if (!stricmp(com_name, cmd->name))
-			return true;
-
-	return false;
+	return COM_FindCommand(com_name) != NULL;
 }
 
 /** Does command completion for the console.
@@ -620,6 +651,22 @@ const char *COM_CompleteAlias(const char *partial, INT32 skips)
 	return NULL;
 }
 
+/** Finds an alias by name.
+  *
+  * \param name Name of the alias, case insensitive.
+  * \return The alias, or NULL if there's none by that name.
+  */
+static cmdalias_t *COM_FindAlias(const char *name)
+{
+	cmdalias_t *a;
+
+	for (a = com_aliashash[COM_NameHash(name)]; a; a = a->hashnext)
+		if (!stricmp(name, a->name))
+			return a;
+
+	return NULL;
+}
+
 /** Parses a single line of text into arguments and tries to execute it.
   * The text can come from the command buffer, a remote client, or stdin.
   *
@@ -638,36 +685,32 @@ static void COM_ExecuteString(char *ptext)
 		return; // no tokens
 
 	// check functions
-	for (cmd = com_commands; cmd; cmd = cmd->next)
+	cmd = COM_FindCommand(com_argv[0]); //case insensitive now that we have lower and uppercase!
+	if (cmd)
 	{
-		if (!stricmp(com_argv[0], cmd->name)) //case insensitive now that we have lower and uppercase!
+		if ((com_flags & COM_LUA) && !(cmd->flags & COM_LUA))
 		{
-			if ((com_flags & COM_LUA) && !(cmd->flags & COM_LUA))
-			{
-				CONS_Alert(CONS_WARNING, "Command '%s' cannot be run from Lua.\n", cmd->name);
-				return;
-			}
-
-			cmd->function();
+			CONS_Alert(CONS_WARNING, "Command '%s' cannot be run from Lua.\n", cmd->name);
 			return;
 		}
+
+		cmd->function();
+		return;
 	}
 
 	// check aliases
-	for (a = com_alias; a; a = a->next)
+	a = COM_FindAlias(com_argv[0]);
+	if (a)
 	{
-		if (!stricmp(com_argv[0], a->name))
-		{
-			if (recursion > MAX_ALIAS_RECURSION)
-				CONS_Alert(CONS_WARNING, M_GetText("Alias recursion cycle detected!\n"));
-			else
-			{ // Monster Iestyn: keep track of how many levels of recursion we're in
-				recursion++;
-				COM_BufInsertTextEx(a->value, com_flags);
-				recursion--;
-			}
-			return;
+		if (recursion > MAX_ALIAS_RECURSION)
+			CONS_Alert(CONS_WARNING, M_GetText("Alias recursion cycle detected!\n"));
+		else
+		{ // Monster Iestyn: keep track of how many levels of recursion we're in
+			recursion++;
+			COM_BufInsertTextEx(a->value, com_flags);
+			recursion--;
 		}
+		return;
 	}
 
 	// check cvars
@@ -695,22 +738,24 @@ static void print_alias(void)
 static void add_alias(char *newname, char *newcmd)
 {
 	cmdalias_t *a;
+	UINT32 hash;
 
 	// Check for existing aliases first
-	for (a = com_alias; a; a = a->next)
+	a = COM_FindAlias(newname);
+	if (a)
 	{
-		if (!stricmp(newname, a->name))
-		{
-			Z_Free(a->value); // Free old cmd 
-			a->value = newcmd;
-			return;
-		}
+		Z_Free(a->value); // Free old cmd 
+		a->value = newcmd;
+		return;
 	}
 
 	// No alias found, add it instead
+	hash = COM_NameHash(newname);
 	a = ZZ_Alloc(sizeof *a);
 	a->next = com_alias;
 	com_alias = a;
+	a->hashnext = com_aliashash[hash];
+	com_aliashash[hash] = a;
 
 	a->name = newname;
 	a->value = newcmd;
@@ -1225,7 +1270,7 @@ consvar_t *CV_FindVar(const char *name)
 {
 	consvar_t *cvar;
 
-	for (cvar = consvar_vars; cvar; cvar = cvar->next)
+	for (cvar = consvar_hash[COM_NameHash(name)]; cvar; cvar = cvar->hashnext)
 		if (!stricmp(name,cvar->name))
 			return cvar;
 
@@ -1291,16 +1336,10 @@ static old_demo_var_t *CV_FindOldDemoVar(UINT16 chk)
   */
 static consvar_t *CV_FindNetVar(UINT16 netid)
 {
-	consvar_t *cvar;
-
-	if (netid > consvar_number_of_netids)
+	if (netid > consvar_number_of_netids || !consvar_netvars)
 		return NULL;
 
-	for (cvar = consvar_vars; cvar; cvar = cvar->next)
-		if (cvar->netid == netid)
-			return cvar;
-
-	return NULL;
+	return consvar_netvars[netid];
 }
 
 static void Setvalue(consvar_t *var, const char *valstr, boolean stealth);
@@ -1360,6 +1399,10 @@ void CV_RegisterVar(consvar_t *variable)
 
 		variable->netid = ++consvar_number_of_netids;
 
+		consvar_netvars = Z_Realloc(consvar_netvars,
+			(consvar_number_of_netids + 1) * sizeof *consvar_netvars, PU_STATIC, NULL);
+		consvar_netvars[variable->netid] = NULL;
+
 #ifdef OLD22DEMOCOMPAT
 		CV_RegisterOldDemoVar(variable);
 #endif
@@ -1368,8 +1411,15 @@ void CV_RegisterVar(consvar_t *variable)
 	// link the variable in
 	if (!(variable->flags & CV_HIDEN))
 	{
+		UINT32 hash = COM_NameHash(variable->name);
+
 		variable->next = consvar_vars;
 		consvar_vars = variable;
+		variable->hashnext = consvar_hash[hash];
+		consvar_hash[hash] = variable;
+
+		if (variable->flags & CV_NETVAR)
+			consvar_netvars[variable->netid] = variable;
 	}
 	variable->string = variable->zstring = NULL;
 	memset(&variable->revert, 0, sizeof variable->revert);
@@ -2554,6 +2604,113 @@ void CV_SaveVariables(FILE *f)
 		}
 }
 
+/** Tokenizes a config with a line for every variable and command, and looks
+  * up each line's first word the way COM_ExecuteString does, through the
+  * hash tables and by walking the registration lists. Also looks up every
+  * netvar by its id. Nothing is actually run.
+  *
+  * Usage: execbench [iterations]
+  */
+void COM_ExecBenchmark(void)
+{
+	INT32 iterations = 100, n;
+	size_t numconfiglines = 0, len = 0, found = 0, i;
+	char *config, *p, **configlines;
+	const char **names;
+	consvar_t *cvar;
+	xcommand_t *cmd;
+	cmdalias_t *a;
+	UINT16 netid;
+	precise_t tokentime = 0, hashtime = 0, listtime = 0, netidtime = 0, netlisttime = 0, t;
+	const double ms = 1000.0 / I_GetPrecisePrecision();
+
+	if (COM_Argc() > 1)
+		iterations = max(1, atoi(COM_Argv(1)));
+
+	// Lines like M_SaveConfig writes, plus one per command
+	for (cvar = consvar_vars; cvar; cvar = cvar->next, numconfiglines++)
+		len += strlen(cvar->name) + strlen(cvar->string) + 4;
+	for (cmd = com_commands; cmd; cmd = cmd->next, numconfiglines++)
+		len += strlen(cmd->name) + 1;
+
+	config = p = Z_Malloc(len, PU_STATIC, NULL);
+	configlines = Z_Malloc(numconfiglines * sizeof *configlines, PU_STATIC, NULL);
+	names = Z_Malloc(numconfiglines * sizeof *names, PU_STATIC, NULL);
+
+	for (i = 0, cvar = consvar_vars; cvar; cvar = cvar->next, i++)
+	{
+		configlines[i] = p;
+		names[i] = cvar->name;
+		p += sprintf(p, "%s \"%s\"", cvar->name, cvar->string) + 1;
+	}
+	for (cmd = com_commands; cmd; cmd = cmd->next, i++)
+	{
+		configlines[i] = p;
+		names[i] = cmd->name;
+		p += sprintf(p, "%s", cmd->name) + 1;
+	}
+
+	for (n = 0; n < iterations; n++)
+	{
+		t = I_GetPreciseTime();
+		for (i = 0; i < numconfiglines; i++)
+			COM_TokenizeString(configlines[i]);
+		tokentime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		for (i = 0, found = 0; i < numconfiglines; i++)
+			if (COM_FindCommand(names[i]) || COM_FindAlias(names[i]) || CV_FindVar(names[i]))
+				found++;
+		hashtime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		for (i = 0; i < numconfiglines; i++)
+		{
+			for (cmd = com_commands; cmd; cmd = cmd->next)
+				if (!stricmp(names[i], cmd->name))
+					break;
+			if (cmd)
+				continue;
+			for (a = com_alias; a; a = a->next)
+				if (!stricmp(names[i], a->name))
+					break;
+			if (a)
+				continue;
+			for (cvar = consvar_vars; cvar; cvar = cvar->next)
+				if (!stricmp(names[i], cvar->name))
+					break;
+		}
+		listtime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		for (netid = 1; netid <= consvar_number_of_netids; netid++)
+			CV_FindNetVar(netid);
+		netidtime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		for (netid = 1; netid <= consvar_number_of_netids; netid++)
+			for (cvar = consvar_vars; cvar; cvar = cvar->next)
+				if (cvar->netid == netid)
+					break;
+		netlisttime += I_GetPreciseTime() - t;
+	}
+
+	// Don't leave com_args pointing into the config
+	config[0] = '\0';
+	COM_TokenizeString(config);
+
+	Z_Free(names);
+	Z_Free(configlines);
+	Z_Free(config);
+
+	CONS_Printf(M_GetText("%s configlines, %s found, %d iterations\n"), sizeu1(numconfiglines), sizeu2(found), iterations);
+	CONS_Printf(M_GetText("Tokenizing: %.3f ms per config\n"), tokentime * ms / iterations);
+	CONS_Printf(M_GetText("Lookups: %.3f ms hashed, %.3f ms walking the lists\n"),
+		hashtime * ms / iterations, listtime * ms / iterations);
+	CONS_Printf(M_GetText("%u netvars by id: %.3f ms indexed, %.3f ms walking the list\n"),
+		consvar_number_of_netids, netidtime * ms / iterations, netlisttime * ms / iterations);
+}
+
 // Returns true if this cvar cannot be modified in current context.
 // Such as if the cvar does not have CV_ALLOWLUA.
 static boolean CV_Immutable(const consvar_t *var)
@@ -34,6 +34,7 @@
 #include "m_menu.h"
 #include "filesrch.h"
 #include "m_misc.h"
+#include "r_draw.h" // TRANSPARENTPIXEL
 
 #ifdef _WINDOWS
 #include "win32/win_main.h"
@@ -91,6 +92,18 @@ static size_t con_width;           // columns of chars, depend on vid mode width
 static size_t con_scrollup;        // how many rows of text to scroll up (pgup/pgdn)
 UINT32 con_scalefactor;            // text size scale factor
 
+// In software mode, the console text is drawn once into con_textlayer and
+// copied to the screen from there, so only lines that changed are redrawn.
+static UINT8 *con_textlayer;       // vid-sized, TRANSPARENTPIXEL where there's no text
+static INT32 *con_textspan;        // right edge of the text in each row of the layer
+static INT32 con_textrows;         // rows of text the layer holds
+static size_t con_textbottom;      // line number in the layer's last row
+static size_t con_textdirty;       // first line printed to since the layer was drawn
+static boolean con_textvalid;      // false to draw the whole layer again
+static INT32 con_textwidth, con_textheight, con_textsize;
+static UINT32 con_textscale;
+static patch_t *con_textfont;
+
 // hold 32 last lines of input for history
 #define CON_MAXPROMPTCHARS 256
 #define CON_PROMPTCHAR '$'
@@ -207,6 +220,7 @@ static void CONS_Clear_f(void)
 	con_cy = con_totallines-1;
 	con_line = &con_buffer[con_cy*con_width];
 	con_scrollup = 0;
+	con_textvalid = false;
 
 	Unlock_state();
 }
@@ -613,6 +627,7 @@ static void CON_RecalcSize(void)
 	con_cy = con_totallines-1;
 	con_line = &con_buffer[con_cy*con_width];
 	con_scrollup = 0;
+	con_textvalid = false;
 
 	Unlock_state();
 
@@ -1441,6 +1456,9 @@ static void CON_Print(char *msg)
 
 	Lock_state();
 
+	if (con_cy < con_textdirty)
+		con_textdirty = con_cy;
+
 	if (!(*msg & 0x80))
 	{
 		con_line[con_cx++] = '\x80';
@@ -1876,14 +1894,160 @@ static void CON_DrawBackpic(void)
 	}
 }
 
+// Draws one line of console text at the given height.
+// Returns how far right the text goes.
+static INT32 CON_DrawTextLine(size_t i, INT32 y)
+{
+	UINT8 *p = (UINT8 *)&con_buffer[((i > 0 ? i : 0)%con_totallines)*con_width];
+	INT32 charflags = 0;
+	INT32 charwidth = (INT32)con_scalefactor << 3;
+	INT32 x, right = 0;
+	size_t c;
+
+	for (c = 0, x = charwidth; c < con_width; c++, x += charwidth, p++)
+	{
+		while (*p & 0x80)
+		{
+			charflags = (*p & 0x7f) << V_CHARCOLORSHIFT;
+			p++;
+			c++;
+		}
+		if (c >= con_width)
+			break;
+		V_DrawCharacter(x, y, (INT32)(*p) | charflags | cv_constextsize.value | V_NOSCALESTART, true);
+		if (*p != ' ')
+			right = x + 2*charwidth; // some room for glyphs wider than the cell
+	}
+
+	return min(right, vid.width);
+}
+
+// Draws rows first to last of the text layer again.
+static void CON_RedrawTextLayer(INT32 first, INT32 last)
+{
+	INT32 charheight = (INT32)con_scalefactor << 3;
+	UINT8 *screen = screens[0];
+	INT32 row;
+
+	screens[0] = con_textlayer;
+
+	for (row = first; row <= last; row++)
+	{
+		memset(&con_textlayer[row*charheight*vid.width], TRANSPARENTPIXEL, charheight*vid.width);
+		con_textspan[row] = CON_DrawTextLine(con_textbottom - (con_textrows - 1 - row), row*charheight);
+	}
+
+	screens[0] = screen;
+}
+
+// Brings the text layer up to date, with its last row holding line bottom,
+// then copies the last numrows rows to the screen, starting at y. Only lines
+// that came into view or were printed to since the last frame are drawn.
+static void CON_DrawTextLayer(size_t bottom, INT32 y, INT32 numrows)
+{
+	INT32 charheight = (INT32)con_scalefactor << 3;
+	size_t rowsize = charheight*vid.width;
+	INT32 rows, shift, first, last, dirty, row;
+
+	if (!con_textlayer || con_textwidth != vid.width || con_textheight != vid.height)
+	{
+		if (con_textlayer)
+		{
+			Z_Free(con_textlayer);
+			Z_Free(con_textspan);
+		}
+		con_textwidth = vid.width;
+		con_textheight = vid.height;
+		con_textlayer = Z_Malloc(vid.width*vid.height, PU_STATIC, NULL);
+		con_textspan = Z_Malloc(vid.height * sizeof (*con_textspan), PU_STATIC, NULL);
+		con_textvalid = false;
+	}
+
+	if (con_textscale != con_scalefactor || con_textsize != cv_constextsize.value
+	|| con_textfont != hu_font['A'-HU_FONTSTART])
+	{
+		con_textscale = con_scalefactor;
+		con_textsize = cv_constextsize.value;
+		con_textfont = hu_font['A'-HU_FONTSTART];
+		con_textvalid = false;
+	}
+
+	rows = con_textrows = vid.height / charheight;
+
+	// Lines that don't fit in the layer (only while the console is
+	// taller than the screen) are drawn directly.
+	for (; numrows > rows; numrows--, y += charheight)
+		CON_DrawTextLine(bottom - (numrows - 1), y);
+
+	// Scroll what's already there, and find which rows are new
+	shift = (INT32)(bottom - con_textbottom);
+	con_textbottom = bottom;
+
+	if (!con_textvalid || shift >= rows || shift <= -rows)
+	{
+		first = 0;
+		last = rows - 1;
+		con_textvalid = true;
+	}
+	else if (shift > 0) // new lines at the bottom
+	{
+		memmove(con_textlayer, con_textlayer + shift*rowsize, (rows - shift)*rowsize);
+		memmove(con_textspan, con_textspan + shift, (rows - shift) * sizeof (*con_textspan));
+		first = rows - shift;
+		last = rows - 1;
+	}
+	else if (shift < 0) // new lines at the top
+	{
+		memmove(con_textlayer - shift*rowsize, con_textlayer, (rows + shift)*rowsize);
+		memmove(con_textspan - shift, con_textspan, (rows + shift) * sizeof (*con_textspan));
+		first = 0;
+		last = -shift - 1;
+	}
+	else
+	{
+		first = rows;
+		last = rows - 1;
+	}
+
+	if (first <= last)
+		CON_RedrawTextLayer(first, last);
+
+	// Lines printed to since the last frame
+	if (con_textdirty != (size_t)-1 && (INT32)(bottom - con_textdirty) >= 0)
+	{
+		dirty = max(0, rows - 1 - (INT32)(bottom - con_textdirty));
+
+		if (last == rows - 1) // the new rows are at the bottom
+			CON_RedrawTextLayer(dirty, first - 1);
+		else
+			CON_RedrawTextLayer(max(dirty, last + 1), rows - 1);
+	}
+	con_textdirty = (size_t)-1;
+
+	// Copy the visible rows, skipping the transparent parts
+	for (row = rows - numrows; row < rows; row++, y += charheight)
+	{
+		INT32 span = con_textspan[row];
+		INT32 x, j;
+
+		for (j = 0; j < charheight && span > 0; j++)
+		{
+			const UINT8 *src = &con_textlayer[(row*charheight + j)*vid.width];
+			UINT8 *dest = &screens[0][(y + j)*vid.width];
+
+			for (x = 0; x < span; x++)
+				if (src[x] != TRANSPARENTPIXEL)
+					dest[x] = src[x];
+		}
+	}
+}
+
 // draw the console background, text, and prompt if enough place
 //
 static void CON_DrawConsole(void)
 {
-	UINT8 *p;
 	size_t i;
 	INT32 y;
-	INT32 charflags = 0;
 	INT32 charwidth = (INT32)con_scalefactor << 3;
 	INT32 charheight = charwidth;
 	INT32 minheight = 20 * con_scalefactor;	// 20 = 8+8+4
@@ -1917,26 +2081,12 @@ static void CON_DrawConsole(void)
 
 		if (rendermode == render_none) return;
 
-		for (y = (con_curlines-minheight) % charheight; y <= con_curlines-minheight; y += charheight, i++)
-		{
-			INT32 x;
-			size_t c;
-
-			p = (UINT8 *)&con_buffer[((i > 0 ? i : 0)%con_totallines)*con_width];
+		y = (con_curlines-minheight) % charheight;
 
-			for (c = 0, x = charwidth; c < con_width; c++, x += charwidth, p++)
-			{
-				while (*p & 0x80)
-				{
-					charflags = (*p & 0x7f) << V_CHARCOLORSHIFT;
-					p++;
-					c++;
-				}
-				if (c >= con_width)
-					break;
-				V_DrawCharacter(x, y, (INT32)(*p) | charflags | cv_constextsize.value | V_NOSCALESTART, true);
-			}
-		}
+		if (rendermode == render_soft)
+			CON_DrawTextLayer(con_cy - con_scrollup - 1, y, (con_curlines-minheight) / charheight + 1);
+		else for (; y <= con_curlines-minheight; y += charheight, i++)
+			CON_DrawTextLine(i, y);
 	}
 
 	// draw prompt if enough place (not while game startup)
@@ -1584,8 +1584,6 @@ static boolean SV_SendServerConfig(INT32 node)
 }
 
 #ifndef NONET
-#define SAVEGAMESIZE (768*1024)
-
 static boolean SV_ResendingSavegameToAnyone(void)
 {
 	INT32 i;
@@ -1604,7 +1602,7 @@ static void SV_SendSaveGame(INT32 node, boolean resending)
 	UINT8 *buffertosend;
 
 	// first save it in a malloced buffer
-	savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
+	savebuffer = (UINT8 *)malloc(NETSAVEGAMESIZE);
 	if (!savebuffer)
 	{
 		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
@@ -1617,7 +1615,7 @@ static void SV_SendSaveGame(INT32 node, boolean resending)
 	P_SaveNetGame(resending);
 
 	length = save_p - savebuffer;
-	if (length > SAVEGAMESIZE)
+	if (length > NETSAVEGAMESIZE)
 	{
 		free(savebuffer);
 		save_p = NULL;
@@ -1680,7 +1678,7 @@ static void SV_SavedGame(void)
 	sprintf(tmpsave, "%s" PATHSEP TMPSAVENAME, srb2home);
 
 	// first save it in a malloced buffer
-	save_p = savebuffer = (UINT8 *)malloc(SAVEGAMESIZE);
+	save_p = savebuffer = (UINT8 *)malloc(NETSAVEGAMESIZE);
 	if (!save_p)
 	{
 		CONS_Alert(CONS_ERROR, M_GetText("No more free memory for savegame\n"));
@@ -1690,7 +1688,7 @@ static void SV_SavedGame(void)
 	P_SaveNetGame(false);
 
 	length = save_p - savebuffer;
-	if (length > SAVEGAMESIZE)
+	if (length > NETSAVEGAMESIZE)
 	{
 		free(savebuffer);
 		save_p = NULL;
@@ -42,6 +42,8 @@ therein, increment this number.
 #define BACKUPTICS 1024
 #define CLIENTBACKUPTICS 32
 #define MAXTEXTCMD 256
+// Largest net savegame, also the bound for demo seek snapshots
+#define NETSAVEGAMESIZE (768*1024)
 //
 // Packet structure
 //
@@ -959,7 +959,9 @@ void D_SRB2Loop(void)
 		HW3S_EndFrameUpdate();
 #endif
 
-		LUA_Step();
+		// Whatever is left of the frame cap goes to the Lua GC before it goes to sleep.
+		finishprecise = I_GetPreciseTime();
+		LUA_Step(singletics || finishprecise - enterprecise >= capbudget ? 0 : capbudget - (finishprecise - enterprecise));
 
 #if defined(__ANDROID__)
 		if (!firstframe)
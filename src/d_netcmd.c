@@ -44,6 +44,7 @@
 #include "mserv.h"
 #include "z_zone.h"
 #include "lua_script.h"
+#include "lua_profile.h"
 #include "lua_hook.h"
 #include "m_cond.h"
 #include "m_anigif.h"
@@ -115,6 +116,7 @@ static void Fishcake_OnChange(void);
 static void Command_Playdemo_f(void);
 static void Command_Timedemo_f(void);
 static void Command_Stopdemo_f(void);
+static void Command_Seekdemo_f(void);
 static void Command_StartMovie_f(void);
 static void Command_StopMovie_f(void);
 static void Command_Map_f(void);
@@ -404,6 +406,8 @@ static CV_PossibleValue_t ps_descriptor_cons_t[] = {
 consvar_t cv_ps_descriptor = CVAR_INIT ("ps_descriptor", "Average", 0, ps_descriptor_cons_t, NULL);
 
 consvar_t cv_freedemocamera = CVAR_INIT("freedemocamera", "Off", CV_SAVE, CV_OnOff, NULL);
+static CV_PossibleValue_t demosnapshotinterval_cons_t[] = {{0, "MIN"}, {600, "MAX"}, {0, NULL}};
+consvar_t cv_demosnapshotinterval = CVAR_INIT ("demosnapshotinterval", "10", CV_SAVE, demosnapshotinterval_cons_t, NULL);
 
 char timedemo_name[256];
 boolean timedemo_csv;
@@ -682,6 +686,7 @@ void D_RegisterClientCommands(void)
 	COM_AddCommand("playdemo", Command_Playdemo_f, 0);
 	COM_AddCommand("timedemo", Command_Timedemo_f, 0);
 	COM_AddCommand("stopdemo", Command_Stopdemo_f, COM_LUA);
+	COM_AddCommand("seekdemo", Command_Seekdemo_f, 0);
 	COM_AddCommand("playintro", Command_Playintro_f, COM_LUA);
 
 	COM_AddCommand("resetcamera", Command_ResetCamera_f, COM_LUA);
@@ -690,6 +695,12 @@ void D_RegisterClientCommands(void)
 	COM_AddCommand("setcontrol2", Command_Setcontrol2_f, 0);
 
 	COM_AddCommand("screenshot", M_ScreenShot, COM_LUA);
+	COM_AddCommand("encodebench", M_EncodeBenchmark, 0);
+	COM_AddCommand("textmapbench", P_TextmapBenchmark, 0);
+	COM_AddCommand("luaallocbench", LUA_AllocBenchmark, 0);
+	COM_AddCommand("luapushbench", LUA_PushBenchmark, 0);
+	COM_AddCommand("ghostbench", G_GhostBenchmark, 0);
+	COM_AddCommand("execbench", COM_ExecBenchmark, 0);
 	COM_AddCommand("startmovie", Command_StartMovie_f, COM_LUA);
 	COM_AddCommand("stopmovie", Command_StopMovie_f, COM_LUA);
 
@@ -699,6 +710,8 @@ void D_RegisterClientCommands(void)
 	CV_RegisterVar(&cv_moviemode);
 	CV_RegisterVar(&cv_movie_option);
 	CV_RegisterVar(&cv_movie_folder);
+	CV_RegisterVar(&cv_movie_overflow);
+	CV_RegisterVar(&cv_encode_threads);
 	// PNG variables
 	CV_RegisterVar(&cv_zlib_level);
 	CV_RegisterVar(&cv_zlib_memory);
@@ -934,8 +947,13 @@ void D_RegisterClientCommands(void)
 
 	CV_RegisterVar(&cv_soundtest);
 
+	// caches kept in srb2home to speed up loading
+	CV_RegisterVar(&cv_mapcache);
+	CV_RegisterVar(&cv_luacache);
+
 	CV_RegisterVar(&cv_perfstats);
 	CV_RegisterVar(&cv_ps_samplesize);
+	CV_RegisterVar(&cv_luagcbudget);
 	CV_RegisterVar(&cv_ps_descriptor);
 
 	// ingame object placing
@@ -949,6 +967,7 @@ void D_RegisterClientCommands(void)
 //	CV_RegisterVar(&cv_snapto);
 
 	CV_RegisterVar(&cv_freedemocamera);
+	CV_RegisterVar(&cv_demosnapshotinterval);
 
 	// add cheat commands
 	COM_AddCommand("noclip", Command_CheatNoClip_f, COM_LUA);
@@ -972,6 +991,8 @@ void D_RegisterClientCommands(void)
 	COM_AddCommand("skynum", Command_Skynum_f, COM_LUA);
 	COM_AddCommand("weather", Command_Weather_f, COM_LUA);
 	COM_AddCommand("toggletwod", Command_Toggletwod_f, COM_LUA);
+	COM_AddCommand("luaprofile", Command_LuaProfile_f, 0);
+	COM_AddCommand("luaarchivesize", LUA_ArchiveSizes, 0);
 #ifdef _DEBUG
 	COM_AddCommand("causecfail", Command_CauseCfail_f, COM_LUA);
 #endif
@@ -1790,6 +1811,33 @@ static void Command_Stopdemo_f(void)
 	CONS_Printf(M_GetText("Stopped demo.\n"));
 }
 
+// seek the current demo to a level time, eg: seekdemo 2:30, seekdemo -10
+static void Command_Seekdemo_f(void)
+{
+	const char *arg, *colon;
+	INT32 sign = 0;
+	tic_t tics;
+
+	if (COM_Argc() != 2)
+	{
+		CONS_Printf(M_GetText("seekdemo <[mm:]ss> or <+/-[mm:]ss>: jump to a time in the current replay\n"));
+		return;
+	}
+
+	arg = COM_Argv(1);
+	if (*arg == '+' || *arg == '-')
+		sign = (*arg++ == '-') ? -1 : 1;
+	colon = strchr(arg, ':');
+	tics = (tic_t)max(colon ? atoi(arg)*60 + atoi(colon+1) : atoi(arg), 0) * TICRATE;
+
+	if (sign < 0)
+		G_SeekDemo(tics > leveltime ? 0 : leveltime - tics);
+	else if (sign > 0)
+		G_SeekDemo(leveltime + tics);
+	else
+		G_SeekDemo(tics);
+}
+
 static void Command_StartMovie_f(void)
 {
 	M_StartMovie();
@@ -3529,11 +3577,9 @@ static void Command_Addfile(void)
 
 			if ((fhandle = W_OpenWadFile(&fn, FILEHANDLE_STANDARD, true)) != NULL)
 			{
-				tic_t t = I_GetTime();
-				CONS_Debug(DBG_SETUP, "Making MD5 for %s\n",fn);
-				md5_stream(fhandle, md5sum);
-				CONS_Debug(DBG_SETUP, "MD5 calc for %s took %f second\n", fn, (float)(I_GetTime() - t)/TICRATE);
 				fclose(fhandle);
+				if (W_GetFileMD5(fn, md5sum))
+					continue;
 			}
 			else // file not found
 				continue;
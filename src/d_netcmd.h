@@ -128,7 +128,7 @@ extern boolean timedemo_csv;
 extern char timedemo_csv_id[256];
 extern boolean timedemo_quit;
 
-extern consvar_t cv_freedemocamera;
+extern consvar_t cv_freedemocamera, cv_demosnapshotinterval;
 
 typedef enum
 {
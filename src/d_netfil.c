@@ -103,6 +103,11 @@ typedef struct
 } pauseddownload_t;
 static pauseddownload_t *pauseddownload = NULL;
 
+#ifdef HAVE_THREADS
+// The files in fileneeded were handed to the MD5 workers by CL_CheckFiles
+static boolean md5queued = false;
+#endif
+
 #ifndef NONET
 // for cl loading screen
 INT32 lastfilenum = -1;
@@ -235,6 +240,9 @@ void D_ParseFileneeded(INT32 fileneedednum_parm, UINT8 *fileneededstr, UINT16 fi
 
 	fileneedednum = firstfile + fileneedednum_parm;
 	p = (UINT8 *)fileneededstr;
+#ifdef HAVE_THREADS
+	md5queued = false;
+#endif
 
 	AllocFileNeeded(fileneedednum);
 
@@ -261,6 +269,9 @@ void CL_PrepareDownloadSaveGame(const char *tmpsave)
 
 	FreeFileNeeded();
 	AllocFileNeeded(1);
+#ifdef HAVE_THREADS
+	md5queued = false;
+#endif
 
 	fileneedednum = 1;
 	fileneeded[0].type = FILENEEDED_SAVEGAME;
@@ -503,6 +514,27 @@ INT32 CL_CheckFiles(void)
 		return 1;
 	}
 
+#ifdef HAVE_THREADS
+	// First time through, hash every file we don't have loaded yet in the
+	// background; the searches below then hit the MD5 cache.
+	if (fileneedednum && !md5queued)
+	{
+		md5queued = true;
+		for (i = 0; i < fileneedednum; i++)
+		{
+			if (fileneeded[i].folder)
+				continue;
+
+			for (j = mainwads; j < numwadfiles; j++)
+				if (!memcmp(wadfiles[j]->md5sum, fileneeded[i].md5sum, 16))
+					break;
+
+			if (j == numwadfiles)
+				W_QueueFileMD5(fileneeded[i].filename);
+		}
+	}
+#endif
+
 	for (i = 0; i < fileneedednum; i++)
 	{
 		if (fileneeded[i].status == FS_NOTFOUND || fileneeded[i].status == FS_MD5SUMBAD)
@@ -543,13 +575,20 @@ INT32 CL_CheckFiles(void)
 		if (fileneeded[i].folder)
 			fileneeded[i].status = findfolder(fileneeded[i].filename);
 		else
+		{
+			// Still hashing, check again next tic
+			if (W_FileMD5sPending())
+				return 4;
 			fileneeded[i].status = findfile(fileneeded[i].filename, fileneeded[i].md5sum, true);
+		}
 
 		CONS_Debug(DBG_NETPLAY, "found %d\n", fileneeded[i].status);
 		return 4;
 	}
 
 	//now making it here means we've checked the entire list and no FS_NOTCHECKED files remain
+	W_SaveMD5Cache();
+
 	if (numwadfiles+filestoload > MAX_WADFILES)
 		return 3;
 	else if (downloadrequired)
@@ -1618,17 +1657,13 @@ filestatus_t checkfilemd5(char *filename, const UINT8 *wantedmd5sum)
 	(void)wantedmd5sum;
 	(void)filename;
 #else
-	FILE *fhandle;
 	UINT8 md5sum[16];
 
 	if (!wantedmd5sum)
 		return FS_FOUND;
 
-	fhandle = fopen(filename, "rb");
-	if (fhandle)
+	if (!W_GetFileMD5(filename, md5sum))
 	{
-		md5_stream(fhandle,md5sum);
-		fclose(fhandle);
 		if (!memcmp(wantedmd5sum, md5sum, 16))
 			return FS_FOUND;
 		return FS_MD5SUMBAD;
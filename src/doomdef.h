@@ -601,6 +601,28 @@ void M_TokenizerClose(void);
 const char *M_TokenizerRead(UINT32 i);
 UINT32 M_TokenizerGetEndPos(void);
 void M_TokenizerSetEndPos(UINT32 newPos);
+
+// Zero-copy scanner: same token rules as M_TokenizerRead, but tokens are
+// views into the (not necessarily NUL-terminated) input.
+typedef struct
+{
+	const char *text; // Points into the scanned input; NOT NUL-terminated!
+	UINT32 length;
+	UINT32 start; // Offset of text from the beginning of the input
+	boolean quoted;
+} tokenview_t;
+
+typedef struct
+{
+	const char *input;
+	UINT32 length;
+	UINT32 pos;
+} textscanner_t;
+
+void M_ScannerOpen(textscanner_t *scanner, const char *input, size_t length);
+boolean M_ScannerRead(textscanner_t *scanner, tokenview_t *tkn);
+boolean M_TokenIs(const tokenview_t *tkn, const char *str);
+boolean M_TokenIsI(const tokenview_t *tkn, const char *str);
 char *sizeu1(size_t num);
 char *sizeu2(size_t num);
 char *sizeu3(size_t num);
@@ -95,6 +95,11 @@ boolean I_SetSongSpeed(float speed)
 	return false;
 }
 
+void I_SetModFilter(INT32 filter)
+{
+	(void)filter;
+}
+
 /// ------------------------
 //  MUSIC SEEKING
 /// ------------------------
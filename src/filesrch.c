@@ -31,6 +31,8 @@
 #include "z_zone.h"
 #include "m_menu.h" // Addons_option_Onchange
 #include "w_wad.h"
+#include "md5.h"
+#include "i_threads.h"
 
 #if defined (_WIN32) && defined (_MSC_VER)
 
@@ -864,15 +866,369 @@ char exttable[NUM_EXT_TABLE][7] = { // maximum extension length (currently 4) pl
 
 static char (*filenamebuf)[MAX_WADPATH];
 
-static boolean filemenucmp(char *haystack, char *needle)
+//
+// Addons directory index
+//
+// Every directory the addons menu opens is read once into an index, which
+// is kept until the directory's mtime changes. Going back into a folder,
+// refreshing after an addfile or typing in the search box then works from
+// memory instead of rereading and restatting the whole folder. A worker
+// thread indexes the subfolders of whatever is on screen ahead of time
+// and hashes files for addons_md5 "Contents" without holding up the menu.
+//
+#define MAXDIRINDEXES 64
+#define MAXPREFETCHDIRS 32
+
+typedef enum
 {
-	static char localhaystack[128];
-	strlcpy(localhaystack, haystack, 128);
-	if (!cv_addons_search_case.value)
-		strupr(localhaystack);
+	DIRMD5_NONE = 0,
+	DIRMD5_QUEUED,
+	DIRMD5_DONE,
+	DIRMD5_FAILED
+} dirmd5_enum;
+
+typedef struct
+{
+	char *name;
+	time_t mtime;
+	off_t size;
+	UINT8 folder;
+	UINT8 ext; // index into exttable, NUM_EXT_TABLE if none
+	UINT8 md5state;
+	UINT8 md5sum[16];
+} direntry_t;
+
+typedef struct dirindex_s
+{
+	struct dirindex_s *next;
+	char *path; // with the trailing PATHSEP, like menupath
+	time_t mtime;
+	direntry_t *entries;
+	size_t numentries;
+} dirindex_t;
+
+typedef struct dirjob_s
+{
+	struct dirjob_s *next;
+	boolean hash; // hash the file at path, or index the folder at path
+	char path[1];
+} dirjob_t;
+
+static dirindex_t *dirindexes;
+static size_t numdirindexes;
+static UINT32 dirindexgeneration, dirindexseen; // bumped when a hash comes in
+
+#ifdef HAVE_THREADS
+static I_mutex dirindex_mutex;
+static dirjob_t *dirjobs, **dirjobtail = &dirjobs;
+static boolean dirindexing = false; // worker thread is running
+
+#  define Lock_dirindex()   I_lock_mutex  (&dirindex_mutex)
+#  define Unlock_dirindex() I_unlock_mutex (dirindex_mutex)
+#else/*HAVE_THREADS*/
+#  define Lock_dirindex()
+#  define Unlock_dirindex()
+#endif/*HAVE_THREADS*/
+
+static UINT8 fileextension(const char *name)
+{
+	size_t len = strlen(name)+1;
+	UINT8 ext;
+	for (ext = 0; ext < NUM_EXT_TABLE; ext++)
+		if (len > (size_t)exttable[ext][0] && !strcasecmp(exttable[ext]+1, name+len-(exttable[ext][0]))) break; // extension comparison
+	return ext;
+}
+
+static void freedirindex(dirindex_t *index)
+{
+	size_t i;
+	for (i = 0; i < index->numentries; i++)
+		free(index->entries[i].name);
+	free(index->entries);
+	free(index->path);
+	free(index);
+}
+
+// Reads a whole folder in one pass. Only uses malloc, so the worker can call it.
+static dirindex_t *scandirectory(const char *path)
+{
+	char fullpath[dirpathlen];
+	size_t pathlen, maxentries = 0;
+	DIR *dirhandle;
+	struct dirent *dent;
+	struct stat fsstat;
+	dirindex_t *index;
+
+	pathlen = strlcpy(fullpath, path, dirpathlen);
+	if (pathlen >= dirpathlen || stat(path, &fsstat) < 0)
+		return NULL;
+	if (!(dirhandle = opendir(path)))
+		return NULL;
+
+	index = calloc(1, sizeof (*index));
+	if (index)
+		index->path = malloc(pathlen+1);
+	if (!index || !index->path)
+	{
+		free(index);
+		closedir(dirhandle);
+		return NULL;
+	}
+	strcpy(index->path, path);
+	index->mtime = fsstat.st_mtime;
+
+	while ((dent = readdir(dirhandle)))
+	{
+		direntry_t *entry;
+
+		if (isuptree(dent->d_name))
+			continue; // we don't want to scan uptree
+
+		strlcpy(fullpath+pathlen, dent->d_name, dirpathlen-pathlen);
+		if (stat(fullpath, &fsstat) < 0) // do we want to follow symlinks? if not: change it to lstat
+			continue; // was the file (re)moved? can't stat it
+
+		if (index->numentries == maxentries)
+		{
+			direntry_t *newentries;
+			maxentries = maxentries ? maxentries*2 : 64;
+			if (!(newentries = realloc(index->entries, maxentries * sizeof (*newentries))))
+				break;
+			index->entries = newentries;
+		}
+
+		entry = &index->entries[index->numentries];
+		if (!(entry->name = malloc(strlen(dent->d_name)+1)))
+			break;
+		strcpy(entry->name, dent->d_name);
+		entry->mtime = fsstat.st_mtime;
+		entry->size = fsstat.st_size;
+		entry->folder = S_ISDIR(fsstat.st_mode) ? 1 : 0;
+		entry->ext = entry->folder ? NUM_EXT_TABLE : fileextension(dent->d_name);
+		entry->md5state = DIRMD5_NONE;
+		index->numentries++;
+	}
+
+	closedir(dirhandle);
+	return index;
+}
+
+static dirindex_t *finddirindex(const char *path)
+{
+	dirindex_t *index;
+	for (index = dirindexes; index; index = index->next)
+		if (!strcmp(index->path, path))
+			return index;
+	return NULL;
+}
+
+static direntry_t *finddirentry(dirindex_t *index, const char *name)
+{
+	size_t i;
+	for (i = 0; i < index->numentries; i++)
+		if (!strcmp(index->entries[i].name, name))
+			return &index->entries[i];
+	return NULL;
+}
+
+// Puts a fresh index at the front of the list, in place of any older one
+// for the same folder. Hashes of files that haven't changed carry over.
+// Call with the index locked.
+static dirindex_t *insertdirindex(dirindex_t *index)
+{
+	dirindex_t **prev, *old;
+	size_t i;
+
+	for (prev = &dirindexes; *prev; prev = &(*prev)->next)
+		if (!strcmp((*prev)->path, index->path))
+			break;
+
+	if ((old = *prev))
+	{
+		*prev = old->next;
+		numdirindexes--;
+
+		for (i = 0; i < old->numentries; i++)
+		{
+			direntry_t *entry, *oldentry = &old->entries[i];
+			if (oldentry->md5state != DIRMD5_DONE)
+				continue;
+			entry = finddirentry(index, oldentry->name);
+			if (entry && entry->mtime == oldentry->mtime && entry->size == oldentry->size)
+			{
+				entry->md5state = DIRMD5_DONE;
+				M_Memcpy(entry->md5sum, oldentry->md5sum, 16);
+			}
+		}
+		freedirindex(old);
+	}
+
+	index->next = dirindexes;
+	dirindexes = index;
+
+	if (++numdirindexes > MAXDIRINDEXES)
+	{
+		for (prev = &dirindexes; (*prev)->next; prev = &(*prev)->next)
+			;
+		freedirindex(*prev);
+		*prev = NULL;
+		numdirindexes--;
+	}
+
+	return index;
+}
+
+#ifdef HAVE_THREADS
+static boolean hashfile(const char *path, UINT8 *md5sum)
+{
+#ifdef NOMD5
+	(void)path;
+	(void)md5sum;
+	return false;
+#else
+	return !W_GetFileMD5(path, md5sum);
+#endif
+}
+
+static void hashdirentry(const char *path)
+{
+	const char *name = strrchr(path, PATHSEP[0]) + 1;
+	char dirpath[dirpathlen];
+	UINT8 md5sum[16];
+	struct stat fsstat;
+	boolean ok;
+	dirindex_t *index;
+	direntry_t *entry;
+
+	ok = (stat(path, &fsstat) == 0 && hashfile(path, md5sum));
+	strlcpy(dirpath, path, min((size_t)(name - path) + 1, dirpathlen));
+
+	Lock_dirindex();
+	{
+		if ((index = finddirindex(dirpath)) && (entry = finddirentry(index, name)))
+		{
+			if (ok && entry->mtime == fsstat.st_mtime && entry->size == fsstat.st_size)
+			{
+				entry->md5state = DIRMD5_DONE;
+				M_Memcpy(entry->md5sum, md5sum, 16);
+			}
+			else
+				entry->md5state = DIRMD5_FAILED;
+			dirindexgeneration++;
+		}
+	}
+	Unlock_dirindex();
+}
+
+static void rundirjob(dirjob_t *job)
+{
+	if (job->hash)
+		hashdirentry(job->path);
+	else
+	{
+		dirindex_t *index;
+		boolean indexed;
+
+		Lock_dirindex();
+		indexed = (finddirindex(job->path) != NULL);
+		Unlock_dirindex();
+
+		if (!indexed && (index = scandirectory(job->path)))
+		{
+			Lock_dirindex();
+			insertdirindex(index);
+			Unlock_dirindex();
+		}
+	}
+	free(job);
+}
+
+// Runs only while there are jobs queued, like the movie encoder.
+static void dirindex_thread(void *userdata)
+{
+	dirjob_t *job;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		Lock_dirindex();
+		{
+			job = dirjobs;
+			if (!job)
+			{
+				dirindexing = false;
+				Unlock_dirindex();
+				return;
+			}
+			dirjobs = job->next;
+			if (!dirjobs)
+				dirjobtail = &dirjobs;
+		}
+		Unlock_dirindex();
+
+		rundirjob(job);
+	}
+}
+#endif
+
+// Queues a hash or a folder scan. Call with the index locked.
+// Returns false if it can only be done right now, on this thread.
+static boolean queuedirjob(const char *path, boolean hash)
+{
+#ifdef HAVE_THREADS
+	dirjob_t *job;
+
+	if (I_thread_is_stopped())
+		return false;
+
+	if (!(job = malloc(sizeof (*job) + strlen(path))))
+		return false;
+	job->next = NULL;
+	job->hash = hash;
+	strcpy(job->path, path);
+
+	*dirjobtail = job;
+	dirjobtail = &job->next;
+	if (!dirindexing)
+	{
+		dirindexing = true;
+		I_spawn_thread("addons-index", (I_thread_fn)dirindex_thread, NULL);
+	}
+	return true;
+#else
+	(void)path;
+	(void)hash;
+	return false;
+#endif
+}
+
+/** Checks whether a hash for the folder on screen came in since last time.
+  * The addons menu refreshes itself when it did.
+  */
+boolean filemenuupdated(void)
+{
+	boolean updated;
+	Lock_dirindex();
+	updated = (dirindexgeneration != dirindexseen);
+	dirindexseen = dirindexgeneration;
+	Unlock_dirindex();
+	return updated;
+}
+
+
+// Entries keep an uppercase copy of their name after it, for searching.
+#define DIR_SEARCHSTRING(entry) ((entry)+DIR_STRING+(UINT8)((entry)[DIR_LEN]))
+
+static char lastsearch[MAXSTRINGLENGTH]; // what dirmenu holds the results of
+static INT32 lastsearchflags;
+
+static boolean filemenucmp(char *entry, char *needle)
+{
+	char *haystack = cv_addons_search_case.value ? entry+DIR_STRING : DIR_SEARCHSTRING(entry);
 	if (cv_addons_search_type.value)
-		return (strstr(localhaystack, needle) != 0);
-	return (!strncmp(localhaystack, needle, menusearch[0]));
+		return (strstr(haystack, needle) != 0);
+	return (!strncmp(haystack, needle, menusearch[0]));
 }
 
 #if defined(__ANDROID__)
@@ -928,12 +1284,15 @@ void closefilemenu(boolean validsize)
 	if (refreshdirname)
 		Z_Free(refreshdirname);
 	refreshdirname = NULL;
+	lastsearch[0] = '\0';
 }
 
 void searchfilemenu(char *tempname)
 {
 	size_t i, first;
 	char localmenusearch[MAXSTRINGLENGTH] = "";
+	const INT32 searchflags = cv_addons_search_case.value | (cv_addons_search_type.value<<1);
+	boolean narrow, noresults = false;
 
 	if (dirmenu)
 	{
@@ -943,6 +1302,7 @@ void searchfilemenu(char *tempname)
 			{
 				Z_Free(dirmenu[0]);
 				dirmenu[0] = NULL;
+				noresults = true;
 			}
 			//Z_Free(dirmenu); -- Z_Realloc later tho...
 		}
@@ -958,6 +1318,7 @@ void searchfilemenu(char *tempname)
 			Z_Free(dirmenu);
 		dirmenu = coredirmenu;
 		sizedirmenu = sizecoredirmenu;
+		lastsearch[0] = '\0';
 
 		if (tempname)
 		{
@@ -983,11 +1344,34 @@ void searchfilemenu(char *tempname)
 	if (!cv_addons_search_case.value)
 		strupr(localmenusearch);
 
-	sizedirmenu = 0;
-	for (i = first; i < sizecoredirmenu; i++)
+	// Typing another letter can only take results away,
+	// so only look through what the last search found.
+	narrow = (dirmenu && lastsearch[0] && searchflags == lastsearchflags
+		&& !strncmp(localmenusearch, lastsearch, strlen(lastsearch)));
+	strcpy(lastsearch, localmenusearch);
+	lastsearchflags = searchflags;
+
+	if (narrow)
 	{
-		if (filemenucmp(coredirmenu[i]+DIR_STRING, localmenusearch))
-			sizedirmenu++;
+		size_t n = 0;
+		if (!noresults)
+		{
+			for (i = 0; i < sizedirmenu; i++)
+			{
+				if (filemenucmp(dirmenu[i], localmenusearch))
+					dirmenu[n++] = dirmenu[i];
+			}
+		}
+		sizedirmenu = n;
+	}
+	else
+	{
+		sizedirmenu = 0;
+		for (i = first; i < sizecoredirmenu; i++)
+		{
+			if (filemenucmp(coredirmenu[i], localmenusearch))
+				sizedirmenu++;
+		}
 	}
 
 	if (!sizedirmenu) // no results...
@@ -1006,37 +1390,84 @@ void searchfilemenu(char *tempname)
 		return;
 	}
 
-	if (!(dirmenu = Z_Realloc(dirmenu, sizedirmenu*sizeof(char *), PU_STATIC, NULL)))
-		I_Error("searchfilemenu(): could not reallocate dirmenu.");
-
-	sizedirmenu = 0;
-	for (i = first; i < sizecoredirmenu; i++)
+	if (!narrow)
 	{
-		if (filemenucmp(coredirmenu[i]+DIR_STRING, localmenusearch))
+		if (!(dirmenu = Z_Realloc(dirmenu, sizedirmenu*sizeof(char *), PU_STATIC, NULL)))
+			I_Error("searchfilemenu(): could not reallocate dirmenu.");
+
+		sizedirmenu = 0;
+		for (i = first; i < sizecoredirmenu; i++)
 		{
-			if (tempname && !strcmp(coredirmenu[i]+DIR_STRING, tempname))
-			{
-				dir_on[menudepthleft] = sizedirmenu;
-				Z_Free(tempname);
-				tempname = NULL;
-			}
-			dirmenu[sizedirmenu++] = coredirmenu[i]; // pointer reuse
+			if (filemenucmp(coredirmenu[i], localmenusearch))
+				dirmenu[sizedirmenu++] = coredirmenu[i]; // pointer reuse
 		}
 	}
 
 	if (tempname)
 	{
-		dir_on[menudepthleft] = 0; //first; -- can't be first, causes problems
+		for (i = 0; i < sizedirmenu; i++)
+		{
+			if (!strcmp(dirmenu[i]+DIR_STRING, tempname))
+				break;
+		}
+
+		dir_on[menudepthleft] = (i < sizedirmenu) ? i : 0; // can't be first, causes problems
 		Z_Free(tempname);
 	}
 }
 
+// Whether a file with a loaded addon's name is that addon. Call with the index locked.
+static boolean fileisloaded(dirindex_t *index, direntry_t *entry, const UINT8 *md5sum)
+{
+#ifdef NOMD5
+	(void)index;
+	(void)entry;
+	(void)md5sum;
+	return true;
+#else
+	char path[dirpathlen];
+	struct stat fsstat;
+
+	if (!cv_addons_md5.value)
+		return true;
+
+	snprintf(path, dirpathlen, "%s%s", index->path, entry->name);
+
+	// Changed in place since it was hashed?
+	if (entry->md5state == DIRMD5_DONE)
+	{
+		if (stat(path, &fsstat) < 0)
+			entry->md5state = DIRMD5_NONE;
+		else if (entry->mtime != fsstat.st_mtime || entry->size != fsstat.st_size)
+		{
+			entry->md5state = DIRMD5_NONE;
+			entry->mtime = fsstat.st_mtime;
+			entry->size = fsstat.st_size;
+		}
+	}
+
+	if (entry->md5state == DIRMD5_NONE)
+	{
+		if (queuedirjob(path, true))
+			entry->md5state = DIRMD5_QUEUED;
+#ifndef HAVE_THREADS
+		else // no lock held without threads, so hash it right here
+			entry->md5state = W_GetFileMD5(path, entry->md5sum) ? DIRMD5_FAILED : DIRMD5_DONE;
+#endif
+		// Otherwise it's left alone and queued again on the next refresh,
+		// rather than hashing with the index locked.
+	}
+
+	// Not marked until the hash comes in; filemenuupdated tells the menu when.
+	return (entry->md5state == DIRMD5_DONE && !memcmp(entry->md5sum, md5sum, 16));
+#endif
+}
+
 boolean preparefilemenu(boolean samedepth)
 {
-	DIR *dirhandle;
-	struct dirent *dent;
 	struct stat fsstat;
-	size_t pos = 0, folderpos = 0, numfolders = 0;
+	dirindex_t *index;
+	size_t i, pos = 0, folderpos = 0, numfolders = 0, numprefetch = 0;
 	char *tempname = NULL;
 
 	if (samedepth)
@@ -1047,9 +1478,28 @@ boolean preparefilemenu(boolean samedepth)
 	else
 		menusearch[0] = menusearch[1] = 0; // clear search
 
-	if (!(dirhandle = opendir(menupath))) // get directory
+	menupath[menupathindex[menudepthleft]] = 0;
+
+	// Only read the folder again if something in it was added, removed or renamed
+	Lock_dirindex();
+	index = finddirindex(menupath);
+	if (stat(menupath, &fsstat) < 0)
+		index = NULL;
+	else if (!index || index->mtime != fsstat.st_mtime)
 	{
+		Unlock_dirindex();
+		index = scandirectory(menupath);
+		Lock_dirindex();
+		if (index)
+			insertdirindex(index);
+	}
+
+	if (!index) // get directory
+	{
+		Unlock_dirindex();
 		closefilemenu(true);
+		if (tempname)
+			Z_Free(tempname);
 		return false;
 	}
 
@@ -1058,44 +1508,21 @@ boolean preparefilemenu(boolean samedepth)
 		Z_Free(coredirmenu[sizecoredirmenu-1]);
 		coredirmenu[sizecoredirmenu-1] = NULL;
 	}
+	lastsearch[0] = '\0'; // dirmenu pointed into those
 
-	while (true)
+	for (i = 0; i < index->numentries; i++)
 	{
-		menupath[menupathindex[menudepthleft]] = 0;
-		dent = readdir(dirhandle);
-
-		if (!dent)
-			break;
-		else if (isuptree(dent->d_name))
-			continue; // we don't want to scan uptree
+		if (index->entries[i].folder)
+			numfolders++;
+		else if (index->entries[i].ext == NUM_EXT_TABLE && !cv_addons_showall.value)
+			continue; // not an addfile-able (or exec-able) file
 
-		strcpy(&menupath[menupathindex[menudepthleft]],dent->d_name);
-
-		if (stat(menupath,&fsstat) < 0) // do we want to follow symlinks? if not: change it to lstat
-			; // was the file (re)moved? can't stat it
-		else // is a file or directory
-		{
-			if (!S_ISDIR(fsstat.st_mode)) // file
-			{
-				if (!cv_addons_showall.value)
-				{
-					size_t len = strlen(dent->d_name)+1;
-					UINT8 ext;
-					for (ext = 0; ext < NUM_EXT_TABLE; ext++)
-						if (!strcasecmp(exttable[ext]+1, dent->d_name+len-(exttable[ext][0]))) break; // extension comparison
-					if (ext == NUM_EXT_TABLE) continue; // not an addfile-able (or exec-able) file
-				}
-			}
-			else // directory
-				numfolders++;
-
-			sizecoredirmenu++;
-		}
+		sizecoredirmenu++;
 	}
 
 	if (!sizecoredirmenu)
 	{
-		closedir(dirhandle);
+		Unlock_dirindex();
 		closefilemenu(false);
 		if (tempname)
 			Z_Free(tempname);
@@ -1113,111 +1540,99 @@ boolean preparefilemenu(boolean samedepth)
 		dirmenu = NULL;
 
 	if (!(coredirmenu = Z_Realloc(coredirmenu, sizecoredirmenu*sizeof(char *), PU_STATIC, NULL)))
-	{
-		closedir(dirhandle); // just in case
 		I_Error("preparefilemenu(): could not reallocate coredirmenu.");
-	}
 
-	rewinddir(dirhandle);
-
-	while ((pos+folderpos) < sizecoredirmenu)
+	for (i = 0; i < index->numentries; i++)
 	{
-		menupath[menupathindex[menudepthleft]] = 0;
-		dent = readdir(dirhandle);
+		direntry_t *entry = &index->entries[i];
+		char *temp;
+		size_t len = strlen(entry->name)+1;
+		UINT8 ext = EXT_FOLDER;
+		UINT8 folder;
 
-		if (!dent)
-			break;
-		else if (isuptree(dent->d_name))
-			continue; // we don't want to scan uptree
-
-		strcpy(&menupath[menupathindex[menudepthleft]],dent->d_name);
-
-		if (stat(menupath,&fsstat) < 0) // do we want to follow symlinks? if not: change it to lstat
-			; // was the file (re)moved? can't stat it
-		else // is a file or directory
+		if (!entry->folder) // file
 		{
-			char *temp;
-			size_t len = strlen(dent->d_name)+1;
-			UINT8 ext = EXT_FOLDER;
-			UINT8 folder;
+			if (entry->ext == NUM_EXT_TABLE && !cv_addons_showall.value) continue; // not an addfile-able (or exec-able) file
+			ext = entry->ext + EXT_START; // moving to be appropriate position
 
-			if (!S_ISDIR(fsstat.st_mode)) // file
+			if (ext >= EXT_LOADSTART)
 			{
-				if (!((numfolders+pos) < sizecoredirmenu)) continue; // crash prevention
-				for (; ext < NUM_EXT_TABLE; ext++)
-					if (!strcasecmp(exttable[ext]+1, dent->d_name+len-(exttable[ext][0]))) break; // extension comparison
-				if (ext == NUM_EXT_TABLE && !cv_addons_showall.value) continue; // not an addfile-able (or exec-able) file
-				ext += EXT_START; // moving to be appropriate position
+				size_t j;
 
-				if (ext >= EXT_LOADSTART)
-				{
-					size_t i;
-
-					if (filenamebuf == NULL)
-						filenamebuf = calloc(sizeof(char) * MAX_WADPATH, numwadfiles);
+				if (filenamebuf == NULL)
+					filenamebuf = calloc(sizeof(char) * MAX_WADPATH, numwadfiles);
 
-					for (i = 0; i < numwadfiles; i++)
+				for (j = 0; j < numwadfiles; j++)
+				{
+					if (!filenamebuf[j][0])
 					{
-						if (!filenamebuf[i][0])
-						{
-							strncpy(filenamebuf[i], wadfiles[i]->filename, MAX_WADPATH);
-							filenamebuf[i][MAX_WADPATH - 1] = '\0';
-							nameonly(filenamebuf[i]);
-						}
-
-						if (strcmp(dent->d_name, filenamebuf[i]))
-							continue;
-						if (cv_addons_md5.value && !checkfilemd5(menupath, wadfiles[i]->md5sum))
-							continue;
-
-						ext |= EXT_LOADED;
+						strncpy(filenamebuf[j], wadfiles[j]->filename, MAX_WADPATH);
+						filenamebuf[j][MAX_WADPATH - 1] = '\0';
+						nameonly(filenamebuf[j]);
 					}
-				}
-				else if (ext == EXT_CFG)
-				{
-					if (!strncmp(dent->d_name, "layout", 6))
-						ext |= EXT_LOADED;
-				}
-				else if (ext == EXT_TXT)
-				{
-					if (!strncmp(dent->d_name, "log-", 4) || !strcmp(dent->d_name, "errorlog.txt"))
-						ext |= EXT_LOADED;
-				}
 
-				if (!strcmp(dent->d_name, configfile))
-					ext |= EXT_LOADED;
+					if (strcmp(entry->name, filenamebuf[j]))
+						continue;
+					if (!fileisloaded(index, entry, wadfiles[j]->md5sum))
+						continue;
 
-				folder = 0;
+					ext |= EXT_LOADED;
+				}
 			}
-			else // directory
-				len += (folder = 1);
-
-			if (len > 255)
-				len = 255;
-
-			if (!(temp = Z_Malloc((len+DIR_STRING+folder) * sizeof (char), PU_STATIC, NULL)))
-				I_Error("preparefilemenu(): could not create file entry.");
-			temp[DIR_TYPE] = ext;
-			temp[DIR_LEN] = (UINT8)(len);
-			strlcpy(temp+DIR_STRING, dent->d_name, len);
-			if (folder)
+			else if (ext == EXT_CFG)
 			{
-				strcpy(temp+len, PATHSEP);
-				coredirmenu[folderpos++] = temp;
+				if (!strncmp(entry->name, "layout", 6))
+					ext |= EXT_LOADED;
 			}
-			else
-				coredirmenu[numfolders + pos++] = temp;
+			else if (ext == EXT_TXT)
+			{
+				if (!strncmp(entry->name, "log-", 4) || !strcmp(entry->name, "errorlog.txt"))
+					ext |= EXT_LOADED;
+			}
+
+			if (!strcmp(entry->name, configfile))
+				ext |= EXT_LOADED;
+
+			folder = 0;
 		}
+		else // directory
+		{
+			len += (folder = 1);
+
+			// Have the worker read it before anyone asks
+			if (numprefetch < MAXPREFETCHDIRS && !finddirindex(va("%s%s"PATHSEP, index->path, entry->name)))
+			{
+				queuedirjob(va("%s%s"PATHSEP, index->path, entry->name), false);
+				numprefetch++;
+			}
+		}
+
+		if (len > 255)
+			len = 255;
+
+		if (!(temp = Z_Malloc((len+DIR_STRING+folder+len) * sizeof (char), PU_STATIC, NULL)))
+			I_Error("preparefilemenu(): could not create file entry.");
+		temp[DIR_TYPE] = ext;
+		temp[DIR_LEN] = (UINT8)(len);
+		strlcpy(temp+DIR_STRING, entry->name, len);
+		if (folder)
+		{
+			strcpy(temp+len, PATHSEP);
+			coredirmenu[folderpos++] = temp;
+		}
+		else
+			coredirmenu[numfolders + pos++] = temp;
+		strupr(strcpy(DIR_SEARCHSTRING(temp), temp+DIR_STRING));
 	}
 
+	Unlock_dirindex();
+
 	if (filenamebuf)
 	{
 		free(filenamebuf);
 		filenamebuf = NULL;
 	}
 
-	closedir(dirhandle);
-
 	if ((menudepthleft != menudepth-1) // now for UP... entry
 #if defined(__ANDROID__)
 		&& !(coredirmenu[0] = writedirmenu("UP...", EXT_UP)))
@@ -1226,8 +1641,7 @@ boolean preparefilemenu(boolean samedepth)
 #endif
 			I_Error("preparefilemenu(): could not create \"UP...\".");
 
-	menupath[menupathindex[menudepthleft]] = 0;
-	sizecoredirmenu = (numfolders+pos); // just in case things shrink between opening and rewind
+	sizecoredirmenu = (numfolders+pos);
 
 	if (!sizecoredirmenu)
 	{
@@ -102,4 +102,5 @@ typedef enum
 void closefilemenu(boolean validsize);
 void searchfilemenu(char *tempname);
 boolean preparefilemenu(boolean samedepth);
+boolean filemenuupdated(void);
 #endif // __FILESRCH_H__
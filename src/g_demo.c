@@ -40,6 +40,13 @@
 #include "lua_hook.h"
 #include "md5.h" // demo checksums
 #include "d_netfil.h" // G_CheckDemoExtraFiles
+#include "i_threads.h"
+#include "p_saveg.h" // demo snapshots
+#include "lzf.h"
+#include "lua_script.h"
+#include "r_fps.h"
+#include "s_sound.h"
+#include "d_netcmd.h"
 
 boolean timingdemo; // if true, exit with report on completion
 boolean nodrawers; // for comparative timing purposes
@@ -86,21 +93,44 @@ static struct {
 // There is no conflict here.
 typedef struct demoghost {
 	UINT8 checksum[16];
-	UINT8 *buffer, *p, fadein;
+	UINT8 *buffer, *p, *end, fadein; // end of the file or lump
 	UINT16 color;
 	UINT16 version;
 	mobj_t oldmo, *mo;
-	struct demoghost *next;
+	fixed_t followx, followy, followz; // last followmobj offset, 0x0011 on
+	struct ghosttic_s *tics; // decoded by G_DecodeGhost
+	size_t numtics, tic;
+	boolean decoded; // tics moved to PU_LEVEL memory
+	struct demoghost *next, *nextjob;
 } demoghost;
 demoghost *ghosts = NULL;
 
+// Where a ghost is and what it looks like on one tic. Anything rarer is
+// read from the file at the offset in extra, the way it always was.
+typedef struct ghosttic_s
+{
+	fixed_t x, y, z;
+	UINT32 extra; // GZT_EXTRA and GZT_FOLLOW data, from the start of the buffer
+	UINT8 ziptic;
+	UINT8 angle, frame, sprite2;
+} ghosttic_t;
+
+static boolean ghostspending; // queued for decoding, see G_FinishGhosts
+static boolean ghostbenchmark; // lets G_GhostBenchmark add duplicates
+
 //
 // DEMO RECORDING
 //
 
-#define DEMOVERSION 0x0010
+#define DEMOVERSION 0x0011
 #define DEMOHEADER  "\xF0" "SRB2Replay" "\x0F"
 
+// 0x0011 stores angle, aiming and button changes, ghost momentum and
+// followmobj offsets as varint deltas (see G_WriteDemoDelta). The tic data
+// is summed as it's written, so the checksum is the MD5 of the header after
+// it followed by the MD5 of the tic data (see WriteDemoChecksum).
+#define DEMODELTAVERSION 0x0011
+
 #define DF_GHOST        0x01 // This demo contains ghost data too!
 #define DF_RECORDATTACK 0x02 // This demo is from record attack and contains its final completion time, score, and rings!
 #define DF_NIGHTSATTACK 0x04 // This demo is from NiGHTS attack and contains its time left, score, and mares!
@@ -151,6 +181,187 @@ static ticcmd_t oldcmd;
 // spare FZT slots 0x20 to 0x80
 
 static mobj_t oldmetal, oldghost;
+static fixed_t oldfollowx, oldfollowy, oldfollowz;
+
+//
+// Demo streaming
+//
+// The header stays in demobuffer, since G_SetDemoTime fills it in at the
+// very end, but the tic data after it goes out to a temporary file in
+// chunks as it is recorded. The demo length is no longer capped by
+// -maxdemo and stopping only has a chunk and the header left to write.
+//
+#define DEMOCHUNKSIZE (64*1024)
+
+typedef struct demochunk_s
+{
+	struct demochunk_s *next;
+	size_t size;
+	UINT8 *data;
+} demochunk_t;
+
+static UINT8 *demobody; // where the tic data starts in demobuffer
+static FILE *demostream;
+static boolean demostreamfailed;
+#ifndef NOMD5
+static struct md5_ctx demomd5;
+#endif
+
+#ifdef HAVE_THREADS
+static demochunk_t *demochunks, **demochunktail = &demochunks;
+static I_mutex demo_mutex;
+static I_cond  demo_cond;
+static boolean demo_writing = false; // writer thread is running
+
+#  define Lock_demo()   I_lock_mutex  (&demo_mutex)
+#  define Unlock_demo() I_unlock_mutex (demo_mutex)
+#else/*HAVE_THREADS*/
+#  define Lock_demo()
+#  define Unlock_demo()
+#endif/*HAVE_THREADS*/
+
+static void G_WriteDemoChunk(demochunk_t *chunk)
+{
+	if (fwrite(chunk->data, 1, chunk->size, demostream) != chunk->size)
+		demostreamfailed = true;
+#ifndef NOMD5
+	md5_process_bytes(chunk->data, chunk->size, &demomd5);
+#endif
+	free(chunk);
+}
+
+#ifdef HAVE_THREADS
+// Runs only while there are chunks queued, like the movie encoder.
+static void G_DemoWriterThread(void *userdata)
+{
+	demochunk_t *chunk;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		Lock_demo();
+		{
+			chunk = demochunks;
+			if (!chunk)
+			{
+				demo_writing = false;
+				I_wake_all_cond(&demo_cond);
+				Unlock_demo();
+				return;
+			}
+			demochunks = chunk->next;
+			if (!demochunks)
+				demochunktail = &demochunks;
+		}
+		Unlock_demo();
+
+		G_WriteDemoChunk(chunk);
+	}
+}
+#endif
+
+// Hands the tic data recorded so far to the writer.
+static void G_FlushDemoChunk(void)
+{
+	demochunk_t *chunk;
+	size_t size = demo_p - demobody;
+
+	if (!demostream || !size)
+		return;
+
+	chunk = malloc(sizeof (*chunk) + size);
+	if (!chunk)
+		I_Error("G_FlushDemoChunk: out of memory");
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->data = (UINT8 *)(chunk + 1);
+	M_Memcpy(chunk->data, demobody, size);
+	demo_p = demobody;
+
+#ifdef HAVE_THREADS
+	if (!I_thread_is_stopped())
+	{
+		Lock_demo();
+		{
+			*demochunktail = chunk;
+			demochunktail = &chunk->next;
+			if (!demo_writing)
+			{
+				demo_writing = true;
+				I_spawn_thread("demo-writer", (I_thread_fn)G_DemoWriterThread, NULL);
+			}
+		}
+		Unlock_demo();
+		return;
+	}
+#endif
+	G_WriteDemoChunk(chunk);
+}
+
+static void G_WaitDemoChunks(void)
+{
+#ifdef HAVE_THREADS
+	Lock_demo();
+	{
+		while (demo_writing)
+			I_hold_cond(&demo_cond, demo_mutex);
+	}
+	Unlock_demo();
+#endif
+}
+
+// Opens the temporary file and writes a placeholder header to it.
+static void G_OpenDemoStream(void)
+{
+	demobody = demo_p;
+	demostreamfailed = false;
+#ifndef NOMD5
+	md5_init_ctx(&demomd5);
+#endif
+
+	demostream = fopen(va("%s"PATHSEP"%s.tmp", srb2home, demoname), "w+b");
+	if (!demostream)
+		return; // keep it all in memory instead
+
+	if (fwrite(demobuffer, 1, demobody - demobuffer, demostream) != (size_t)(demobody - demobuffer))
+		demostreamfailed = true;
+}
+
+//
+// G_WriteDemoDelta
+//
+// Signed values are zigzagged so small changes either way fit in a byte.
+//
+static void G_WriteDemoDelta(UINT8 **p, INT32 delta)
+{
+	UINT32 v = ((UINT32)delta << 1) ^ (UINT32)(delta >> 31);
+
+	while (v >= 0x80)
+	{
+		WRITEUINT8(*p, (UINT8)(v | 0x80));
+		v >>= 7;
+	}
+	WRITEUINT8(*p, (UINT8)v);
+}
+
+static INT32 G_ReadDemoDelta(UINT8 **p)
+{
+	UINT32 v = 0;
+	UINT8 shift = 0, byte;
+
+	do
+	{
+		byte = READUINT8(*p);
+		v |= (UINT32)(byte & 0x7F) << shift;
+		shift += 7;
+	} while ((byte & 0x80) && shift < 35);
+
+	return (INT32)(v >> 1) ^ -(INT32)(v & 1);
+}
+
+// Applies a delta with wraparound, the same on every platform.
+#define DEMODELTA(old, delta) ((fixed_t)((UINT32)(old) + (UINT32)(delta)))
 
 void G_SaveMetal(UINT8 **buffer)
 {
@@ -180,12 +391,24 @@ void G_ReadDemoTiccmd(ticcmd_t *cmd, INT32 playernum)
 		oldcmd.forwardmove = READSINT8(demo_p);
 	if (ziptic & ZT_SIDE)
 		oldcmd.sidemove = READSINT8(demo_p);
-	if (ziptic & ZT_ANGLE)
-		oldcmd.angleturn = READINT16(demo_p);
-	if (ziptic & ZT_BUTTONS)
-		oldcmd.buttons = (oldcmd.buttons & (BT_CAMLEFT|BT_CAMRIGHT)) | (READUINT16(demo_p) & ~(BT_CAMLEFT|BT_CAMRIGHT));
-	if (ziptic & ZT_AIMING)
-		oldcmd.aiming = READINT16(demo_p);
+	if (demoversion >= DEMODELTAVERSION)
+	{
+		if (ziptic & ZT_ANGLE)
+			oldcmd.angleturn = (INT16)(oldcmd.angleturn + G_ReadDemoDelta(&demo_p));
+		if (ziptic & ZT_BUTTONS)
+			oldcmd.buttons = (oldcmd.buttons & (BT_CAMLEFT|BT_CAMRIGHT)) | ((oldcmd.buttons ^ (UINT16)G_ReadDemoDelta(&demo_p)) & ~(BT_CAMLEFT|BT_CAMRIGHT));
+		if (ziptic & ZT_AIMING)
+			oldcmd.aiming = (INT16)(oldcmd.aiming + G_ReadDemoDelta(&demo_p));
+	}
+	else
+	{
+		if (ziptic & ZT_ANGLE)
+			oldcmd.angleturn = READINT16(demo_p);
+		if (ziptic & ZT_BUTTONS)
+			oldcmd.buttons = (oldcmd.buttons & (BT_CAMLEFT|BT_CAMRIGHT)) | (READUINT16(demo_p) & ~(BT_CAMLEFT|BT_CAMRIGHT));
+		if (ziptic & ZT_AIMING)
+			oldcmd.aiming = READINT16(demo_p);
+	}
 	if (ziptic & ZT_LATENCY)
 		oldcmd.latency = READUINT8(demo_p);
 
@@ -226,21 +449,21 @@ void G_WriteDemoTiccmd(ticcmd_t *cmd, INT32 playernum)
 
 	if (cmd->angleturn != oldcmd.angleturn)
 	{
-		WRITEINT16(demo_p,cmd->angleturn);
+		G_WriteDemoDelta(&demo_p, (INT16)(cmd->angleturn - oldcmd.angleturn));
 		oldcmd.angleturn = cmd->angleturn;
 		ziptic |= ZT_ANGLE;
 	}
 
 	if (cmd->buttons != oldcmd.buttons)
 	{
-		WRITEUINT16(demo_p,cmd->buttons);
+		G_WriteDemoDelta(&demo_p, (INT16)(cmd->buttons ^ oldcmd.buttons));
 		oldcmd.buttons = cmd->buttons;
 		ziptic |= ZT_BUTTONS;
 	}
 
 	if (cmd->aiming != oldcmd.aiming)
 	{
-		WRITEINT16(demo_p,cmd->aiming);
+		G_WriteDemoDelta(&demo_p, (INT16)(cmd->aiming - oldcmd.aiming));
 		oldcmd.aiming = cmd->aiming;
 		ziptic |= ZT_AIMING;
 	}
@@ -364,18 +587,18 @@ void G_WriteGhostTic(mobj_t *ghost)
 		if (momx != oldghost.momx
 		|| momy != oldghost.momy)
 		{
+			G_WriteDemoDelta(&demo_p, (INT32)((UINT32)momx - (UINT32)oldghost.momx));
+			G_WriteDemoDelta(&demo_p, (INT32)((UINT32)momy - (UINT32)oldghost.momy));
 			oldghost.momx = momx;
 			oldghost.momy = momy;
 			ziptic |= GZT_MOMXY;
-			WRITEFIXED(demo_p,momx);
-			WRITEFIXED(demo_p,momy);
 		}
 		momx = ghost->z-oldghost.z;
 		if (momx != oldghost.momz)
 		{
+			G_WriteDemoDelta(&demo_p, (INT32)((UINT32)momx - (UINT32)oldghost.momz));
 			oldghost.momz = momx;
 			ziptic |= GZT_MOMZ;
-			WRITEFIXED(demo_p,momx);
 		}
 
 		// This SHOULD set oldghost.x/y/z to match ghost->x/y/z
@@ -503,11 +726,14 @@ void G_WriteGhostTic(mobj_t *ghost)
 		}
 
 		temp = ghost->player->followmobj->x-ghost->x;
-		WRITEFIXED(demo_p,temp);
+		G_WriteDemoDelta(&demo_p, (INT32)((UINT32)temp - (UINT32)oldfollowx));
+		oldfollowx = temp;
 		temp = ghost->player->followmobj->y-ghost->y;
-		WRITEFIXED(demo_p,temp);
+		G_WriteDemoDelta(&demo_p, (INT32)((UINT32)temp - (UINT32)oldfollowy));
+		oldfollowy = temp;
 		temp = ghost->player->followmobj->z-ghost->z;
-		WRITEFIXED(demo_p,temp);
+		G_WriteDemoDelta(&demo_p, (INT32)((UINT32)temp - (UINT32)oldfollowz));
+		oldfollowz = temp;
 		if (followtic & FZT_SKIN)
 			WRITEUINT8(demo_p,ghost->player->followmobj->sprite2);
 		WRITEUINT16(demo_p,ghost->player->followmobj->sprite);
@@ -521,6 +747,9 @@ void G_WriteGhostTic(mobj_t *ghost)
 
 	*ziptic_p = ziptic;
 
+	if (demostream && demo_p - demobody >= DEMOCHUNKSIZE)
+		G_FlushDemoChunk();
+
 	// attention here for the ticcmd size!
 	// latest demos with mouse aiming byte in ticcmd
 	if (demo_p >= demoend - (13 + 9 + 9))
@@ -530,6 +759,51 @@ void G_WriteGhostTic(mobj_t *ghost)
 	}
 }
 
+static void G_SkipGhostExtra(UINT8 **p, UINT16 version)
+{
+	UINT8 xziptic = READUINT8(*p);
+	if (xziptic & EZT_COLOR)
+		*p += (version==0x000c) ? 1 : sizeof(UINT16);
+	if (xziptic & EZT_SCALE)
+		*p += sizeof(fixed_t);
+	if (xziptic & EZT_HIT)
+	{
+		UINT16 count = READUINT16(*p);
+		*p += count * (sizeof(UINT32) + sizeof(UINT16) + 3*sizeof(fixed_t) + sizeof(angle_t)); // type, health, x, y, z, angle
+	}
+	if (xziptic & EZT_SPRITE)
+		*p += sizeof(UINT16);
+	if (xziptic & EZT_HEIGHT)
+		*p += (version < 0x000e) ? sizeof(INT16) : sizeof(fixed_t);
+}
+
+static void G_SkipGhostFollow(UINT8 **p, UINT16 version)
+{
+	UINT8 followtic = READUINT8(*p);
+	if (followtic & FZT_SPAWNED)
+	{
+		*p += sizeof(INT16);
+		if (followtic & FZT_SKIN)
+			(*p)++;
+	}
+	if (followtic & FZT_SCALE)
+		*p += sizeof(fixed_t);
+	// x, y and z offsets
+	if (version >= DEMODELTAVERSION)
+	{
+		G_ReadDemoDelta(p);
+		G_ReadDemoDelta(p);
+		G_ReadDemoDelta(p);
+	}
+	else
+		*p += (version < 0x000e) ? sizeof(INT16) * 3 : sizeof(fixed_t) * 3;
+	if (followtic & FZT_SKIN)
+		(*p)++;
+	*p += sizeof(UINT16);
+	(*p)++;
+	*p += (version==0x000c) ? 1 : sizeof(UINT16);
+}
+
 // Uses ghost data to do consistency checks on your position.
 // This fixes desynchronising demos when fighting eggman.
 void G_ConsGhostTic(void)
@@ -553,6 +827,19 @@ void G_ConsGhostTic(void)
 		oldghost.y = READFIXED(demo_p);
 		oldghost.z = READFIXED(demo_p);
 	}
+	else if (demoversion >= DEMODELTAVERSION)
+	{
+		if (ziptic & GZT_MOMXY)
+		{
+			oldghost.momx = DEMODELTA(oldghost.momx, G_ReadDemoDelta(&demo_p));
+			oldghost.momy = DEMODELTA(oldghost.momy, G_ReadDemoDelta(&demo_p));
+		}
+		if (ziptic & GZT_MOMZ)
+			oldghost.momz = DEMODELTA(oldghost.momz, G_ReadDemoDelta(&demo_p));
+		oldghost.x += oldghost.momx;
+		oldghost.y += oldghost.momy;
+		oldghost.z += oldghost.momz;
+	}
 	else
 	{
 		if (ziptic & GZT_MOMXY)
@@ -627,24 +914,7 @@ void G_ConsGhostTic(void)
 	}
 
 	if (ziptic & GZT_FOLLOW)
-	{ // Even more...
-		UINT8 followtic = READUINT8(demo_p);
-		if (followtic & FZT_SPAWNED)
-		{
-			demo_p += sizeof(INT16);
-			if (followtic & FZT_SKIN)
-				demo_p++;
-		}
-		if (followtic & FZT_SCALE)
-			demo_p += sizeof(fixed_t);
-		// momx, momy and momz
-		demo_p += (demoversion < 0x000e) ? sizeof(INT16) * 3 : sizeof(fixed_t) * 3;
-		if (followtic & FZT_SKIN)
-			demo_p++;
-		demo_p += sizeof(UINT16);
-		demo_p++;
-		demo_p += (demoversion==0x000c) ? 1 : sizeof(UINT16);
-	}
+		G_SkipGhostFollow(&demo_p, demoversion); // Even more...
 
 	// Re-synchronise
 	px = testmo->x>>FRACBITS;
@@ -675,54 +945,279 @@ void G_ConsGhostTic(void)
 	}
 }
 
-void G_GhostTicker(void)
+//
+// G_DecodeGhost
+//
+// Walks a ghost's whole tic stream once and keeps its position and looks
+// for every tic in g->tics, so G_GhostTicker doesn't have to parse the
+// stream every tic. Doesn't touch the zone or anything else shared, since
+// it can run on a decoder thread.
+//
+static void G_DecodeGhost(demoghost *g)
 {
-	demoghost *g,*p;
-	for(g = ghosts, p = NULL; g; g = g->next)
+	UINT8 *p = g->p;
+	ghosttic_t *tics = NULL, *t;
+	size_t numtics = 0, maxtics = 0;
+	fixed_t x = g->oldmo.x, y = g->oldmo.y, z = g->oldmo.z;
+	fixed_t momx = 0, momy = 0, momz = 0;
+	UINT8 ziptic, frame = 0, sprite2 = 0;
+
+	// A truncated file ends without a DEMOMARKER, so stop at its end too.
+	while (p < g->end && *p != DEMOMARKER)
 	{
+		if (numtics == maxtics)
+		{
+			ghosttic_t *newtics;
+			maxtics = maxtics ? maxtics*2 : 4*TICRATE*60;
+			newtics = realloc(tics, maxtics * sizeof (*tics));
+			if (!newtics)
+			{
+				free(tics);
+				g->tics = NULL;
+				g->numtics = 0;
+				return;
+			}
+			tics = newtics;
+		}
+		t = &tics[numtics++];
+
 		// Skip normal demo data.
-		UINT8 ziptic = READUINT8(g->p);
-		UINT8 xziptic = 0;
+		ziptic = READUINT8(p);
 		if (ziptic & ZT_FWD)
-			g->p++;
+			p++;
 		if (ziptic & ZT_SIDE)
-			g->p++;
-		if (ziptic & ZT_ANGLE)
-			g->p += 2;
-		if (ziptic & ZT_BUTTONS)
-			g->p += 2;
-		if (ziptic & ZT_AIMING)
-			g->p += 2;
+			p++;
+		if (g->version >= DEMODELTAVERSION)
+		{
+			if (ziptic & ZT_ANGLE)
+				G_ReadDemoDelta(&p);
+			if (ziptic & ZT_BUTTONS)
+				G_ReadDemoDelta(&p);
+			if (ziptic & ZT_AIMING)
+				G_ReadDemoDelta(&p);
+		}
+		else
+		{
+			if (ziptic & ZT_ANGLE)
+				p += 2;
+			if (ziptic & ZT_BUTTONS)
+				p += 2;
+			if (ziptic & ZT_AIMING)
+				p += 2;
+		}
 		if (ziptic & ZT_LATENCY)
-			g->p++;
+			p++;
 
 		// Grab ghost data.
-		ziptic = READUINT8(g->p);
+		ziptic = READUINT8(p);
 		if (ziptic & GZT_XYZ)
 		{
-			g->oldmo.x = READFIXED(g->p);
-			g->oldmo.y = READFIXED(g->p);
-			g->oldmo.z = READFIXED(g->p);
+			x = READFIXED(p);
+			y = READFIXED(p);
+			z = READFIXED(p);
+		}
+		else if (g->version >= DEMODELTAVERSION)
+		{
+			if (ziptic & GZT_MOMXY)
+			{
+				momx = DEMODELTA(momx, G_ReadDemoDelta(&p));
+				momy = DEMODELTA(momy, G_ReadDemoDelta(&p));
+			}
+			if (ziptic & GZT_MOMZ)
+				momz = DEMODELTA(momz, G_ReadDemoDelta(&p));
+			x += momx;
+			y += momy;
+			z += momz;
 		}
 		else
 		{
 			if (ziptic & GZT_MOMXY)
 			{
-				g->oldmo.momx = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
-				g->oldmo.momy = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
+				momx = (g->version < 0x000e) ? READINT16(p)<<8 : READFIXED(p);
+				momy = (g->version < 0x000e) ? READINT16(p)<<8 : READFIXED(p);
 			}
 			if (ziptic & GZT_MOMZ)
-				g->oldmo.momz = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
-			g->oldmo.x += g->oldmo.momx;
-			g->oldmo.y += g->oldmo.momy;
-			g->oldmo.z += g->oldmo.momz;
+				momz = (g->version < 0x000e) ? READINT16(p)<<8 : READFIXED(p);
+			x += momx;
+			y += momy;
+			z += momz;
 		}
-		if (ziptic & GZT_ANGLE)
-			g->mo->angle = READUINT8(g->p)<<24;
+		t->angle = (ziptic & GZT_ANGLE) ? READUINT8(p) : 0;
 		if (ziptic & GZT_FRAME)
-			g->oldmo.frame = READUINT8(g->p);
+			frame = READUINT8(p);
 		if (ziptic & GZT_SPR2)
-			g->oldmo.sprite2 = READUINT8(g->p);
+			sprite2 = READUINT8(p);
+
+		t->x = x;
+		t->y = y;
+		t->z = z;
+		t->ziptic = ziptic;
+		t->frame = frame;
+		t->sprite2 = sprite2;
+		t->extra = (UINT32)(p - g->buffer);
+
+		if (ziptic & GZT_EXTRA)
+			G_SkipGhostExtra(&p, g->version);
+		if (ziptic & GZT_FOLLOW)
+			G_SkipGhostFollow(&p, g->version);
+
+		if (p > g->end) // cut off partway through
+		{
+			numtics--;
+			break;
+		}
+	}
+
+	g->tics = tics;
+	g->numtics = numtics;
+}
+
+//
+// Ghost decoding
+//
+// G_AddGhost queues each ghost it loads, and a few decoder threads work
+// through them while the next replay file is read in.
+//
+#ifdef HAVE_THREADS
+#define GHOSTDECODERS 4
+
+static I_mutex ghost_mutex;
+static I_cond  ghost_cond;
+static demoghost *ghostjobs, **ghostjobtail = &ghostjobs;
+static INT32 ghostdecoders; // decoder threads running
+
+static void G_GhostDecoderThread(void *userdata)
+{
+	demoghost *g;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		I_lock_mutex(&ghost_mutex);
+		{
+			g = ghostjobs;
+			if (!g)
+			{
+				ghostdecoders--;
+				I_wake_all_cond(&ghost_cond);
+				I_unlock_mutex(ghost_mutex);
+				return;
+			}
+			ghostjobs = g->nextjob;
+			if (!ghostjobs)
+				ghostjobtail = &ghostjobs;
+		}
+		I_unlock_mutex(ghost_mutex);
+
+		G_DecodeGhost(g);
+	}
+}
+#endif
+
+static void G_QueueGhostDecode(demoghost *g)
+{
+	ghostspending = true;
+
+#ifdef HAVE_THREADS
+	if (!I_thread_is_stopped())
+	{
+		I_lock_mutex(&ghost_mutex);
+		{
+			g->nextjob = NULL;
+			*ghostjobtail = g;
+			ghostjobtail = &g->nextjob;
+			if (ghostdecoders < GHOSTDECODERS)
+			{
+				ghostdecoders++;
+				I_spawn_thread("ghost-decoder", (I_thread_fn)G_GhostDecoderThread, NULL);
+			}
+		}
+		I_unlock_mutex(ghost_mutex);
+		return;
+	}
+#endif
+	G_DecodeGhost(g);
+}
+
+static void G_WaitGhostDecoders(void)
+{
+#ifdef HAVE_THREADS
+	I_lock_mutex(&ghost_mutex);
+	{
+		while (ghostdecoders)
+			I_hold_cond(&ghost_cond, ghost_mutex);
+	}
+	I_unlock_mutex(ghost_mutex);
+#endif
+}
+
+//
+// G_FinishGhosts
+//
+// Waits for the decoders and moves the decoded tics into level memory,
+// so they go away with the ghost's replay buffer.
+//
+void G_FinishGhosts(void)
+{
+	demoghost *g, *p, *next;
+	ghosttic_t *tics;
+
+	if (!ghostspending)
+		return;
+	G_WaitGhostDecoders();
+	ghostspending = false;
+
+	for (g = ghosts, p = NULL; g; g = next)
+	{
+		next = g->next;
+		if (g->decoded)
+		{
+			p = g;
+			continue;
+		}
+
+		if (!g->tics)
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("Not enough memory to decode a ghost.\n"));
+			P_RemoveMobj(g->mo);
+			if (p)
+				p->next = next;
+			else
+				ghosts = next;
+			Z_Free(g);
+			continue;
+		}
+
+		tics = Z_Malloc(g->numtics * sizeof (*tics), PU_LEVEL, NULL);
+		M_Memcpy(tics, g->tics, g->numtics * sizeof (*tics));
+		free(g->tics);
+		g->tics = tics;
+		g->decoded = true;
+		p = g;
+	}
+}
+
+void G_GhostTicker(void)
+{
+	demoghost *g,*p;
+
+	G_FinishGhosts();
+
+	for(g = ghosts, p = NULL; g; g = g->next)
+	{
+		const ghosttic_t *t = &g->tics[g->tic++];
+		UINT8 ziptic = t->ziptic;
+		UINT8 xziptic = 0;
+
+		g->oldmo.x = t->x;
+		g->oldmo.y = t->y;
+		g->oldmo.z = t->z;
+		if (ziptic & GZT_ANGLE)
+			g->mo->angle = t->angle<<24;
+		g->oldmo.frame = t->frame;
+		g->oldmo.sprite2 = t->sprite2;
+		g->p = g->buffer + t->extra;
 
 		// Update ghost
 		P_UnsetThingPosition(g->mo);
@@ -916,12 +1411,24 @@ void G_GhostTicker(void)
 					P_SetScale(follow, follow->destscale);
 
 				P_UnsetThingPosition(follow);
-				temp = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
-				follow->x = g->mo->x + temp;
-				temp = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
-				follow->y = g->mo->y + temp;
-				temp = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
-				follow->z = g->mo->z + temp;
+				if (g->version >= DEMODELTAVERSION)
+				{
+					g->followx = DEMODELTA(g->followx, G_ReadDemoDelta(&g->p));
+					g->followy = DEMODELTA(g->followy, G_ReadDemoDelta(&g->p));
+					g->followz = DEMODELTA(g->followz, G_ReadDemoDelta(&g->p));
+					follow->x = g->mo->x + g->followx;
+					follow->y = g->mo->y + g->followy;
+					follow->z = g->mo->z + g->followz;
+				}
+				else
+				{
+					temp = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
+					follow->x = g->mo->x + temp;
+					temp = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
+					follow->y = g->mo->y + temp;
+					temp = (g->version < 0x000e) ? READINT16(g->p)<<8 : READFIXED(g->p);
+					follow->z = g->mo->z + temp;
+				}
 				P_SetThingPosition(follow);
 				if (followtic & FZT_SKIN)
 					follow->sprite2 = READUINT8(g->p);
@@ -948,7 +1455,7 @@ void G_GhostTicker(void)
 			P_SetTarget(&follow, NULL);
 		}
 		// Demo ends after ghost data.
-		if (*g->p == DEMOMARKER)
+		if (g->tic >= g->numtics)
 		{
 			g->mo->momx = g->mo->momy = g->mo->momz = 0;
 #if 1 // freeze frame (maybe more useful for time attackers)
@@ -964,6 +1471,7 @@ void G_GhostTicker(void)
 				p->next = g->next;
 			else
 				ghosts = g->next;
+			Z_Free(g->tics);
 			Z_Free(g);
 			continue;
 		}
@@ -1570,6 +2078,10 @@ void G_BeginRecording(void)
 	memset(&ghostext,0,sizeof(ghostext));
 	ghostext.lastcolor = ghostext.color = GHC_NORMAL;
 	ghostext.lastscale = ghostext.scale = FRACUNIT;
+	oldfollowx = oldfollowy = oldfollowz = 0;
+
+	// Everything from here on is tic data
+	G_OpenDemoStream();
 
 	if (player->mo)
 	{
@@ -1605,6 +2117,7 @@ void G_BeginMetal(void)
 	demo_p += 16;
 
 	M_Memcpy(demo_p, "METL", 4); demo_p += 4;
+	demobody = demo_p;
 
 	memset(&ghostext,0,sizeof(ghostext));
 	ghostext.lastscale = ghostext.scale = FRACUNIT;
@@ -1890,6 +2403,7 @@ UINT8 G_CmpDemoTime(char *oldname, char *newname)
 	switch(oldversion) // demoversion
 	{
 	case DEMOVERSION: // latest always supported
+	case 0x0010:
 	case 0x000f: // The previous demoversions also supported 
 	case 0x000e:
 	case 0x000d: // all that changed between then and now was longer color name
@@ -1961,6 +2475,222 @@ void G_DeferedPlayDemo(const char *name)
 	COM_BufAddText("\"\n");
 }
 
+//
+// Demo seeking
+//
+// While a demo plays, the world is saved every cv_demosnapshotinterval
+// seconds of level time, the same way a netgame is sent to a joiner, along
+// with where the demo reader was. Seeking back restores the nearest
+// snapshot before the target and runs the rest without drawing anything.
+// Seeking ahead just runs forward, taking snapshots on the way.
+//
+typedef struct
+{
+	tic_t leveltime;
+	size_t demooffset; // demo_p - demobuffer
+	ticcmd_t oldcmd;
+	mobj_t oldghost;
+	boolean synced;
+	size_t length; // uncompressed
+	size_t size;
+	UINT8 *data; // lzf compressed, or raw if size == length
+} demosnapshot_t;
+
+static demosnapshot_t *demosnapshots;
+static size_t numdemosnapshots, maxdemosnapshots;
+static UINT8 *demosnapshotbuf;
+
+static void G_DemoTimeString(char *buf, size_t len, tic_t tics)
+{
+	snprintf(buf, len, "%d:%02d.%02d", G_TicsToMinutes(tics, true), G_TicsToSeconds(tics), G_TicsToCentiseconds(tics));
+}
+
+static void G_FreeDemoSnapshots(void)
+{
+	size_t i;
+
+	for (i = 0; i < numdemosnapshots; i++)
+		free(demosnapshots[i].data);
+	free(demosnapshots);
+	free(demosnapshotbuf);
+	demosnapshots = NULL;
+	demosnapshotbuf = NULL;
+	numdemosnapshots = maxdemosnapshots = 0;
+}
+
+//
+// G_StoreDemoSnapshot
+//
+// Called at the end of every played back tic.
+//
+void G_StoreDemoSnapshot(void)
+{
+	demosnapshot_t *snap;
+	size_t length, size;
+	UINT8 *data;
+
+	if (!demoplayback || titledemo || !demo_p || gamestate != GS_LEVEL || !cv_demosnapshotinterval.value)
+		return;
+
+	// Snapshots are taken in order, so the last one is the latest
+	if (numdemosnapshots && leveltime < demosnapshots[numdemosnapshots-1].leveltime + (tic_t)cv_demosnapshotinterval.value*TICRATE)
+		return;
+
+	if (!demosnapshotbuf)
+	{
+		demosnapshotbuf = malloc(NETSAVEGAMESIZE);
+		if (!demosnapshotbuf)
+			return;
+	}
+
+	save_p = demosnapshotbuf;
+	P_SaveNetGame(true);
+	length = save_p - demosnapshotbuf;
+	save_p = NULL;
+	if (length > NETSAVEGAMESIZE)
+		I_Error("Demo snapshot buffer overrun");
+
+	data = malloc(length);
+	if (!data)
+		return;
+	size = lzf_compress(demosnapshotbuf, length, data, length - 1);
+	if (size)
+		data = realloc(data, size);
+	else
+	{
+		M_Memcpy(data, demosnapshotbuf, length);
+		size = length;
+	}
+
+	if (numdemosnapshots == maxdemosnapshots)
+	{
+		demosnapshot_t *newsnapshots;
+		maxdemosnapshots = maxdemosnapshots ? maxdemosnapshots*2 : 32;
+		newsnapshots = realloc(demosnapshots, maxdemosnapshots * sizeof (*demosnapshots));
+		if (!newsnapshots)
+		{
+			free(data);
+			maxdemosnapshots = numdemosnapshots;
+			return;
+		}
+		demosnapshots = newsnapshots;
+	}
+
+	snap = &demosnapshots[numdemosnapshots++];
+	snap->leveltime = leveltime;
+	snap->demooffset = demo_p - demobuffer;
+	snap->oldcmd = oldcmd;
+	snap->oldghost = oldghost;
+	snap->synced = demosynced;
+	snap->length = length;
+	snap->size = size;
+	snap->data = data;
+}
+
+static boolean G_RestoreDemoSnapshot(demosnapshot_t *snap)
+{
+	INT32 i;
+	boolean loaded;
+
+	if (snap->size == snap->length)
+		M_Memcpy(demosnapshotbuf, snap->data, snap->length);
+	else if (lzf_decompress(snap->data, snap->size, demosnapshotbuf, NETSAVEGAMESIZE) != snap->length)
+		return false;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+		LUA_InvalidatePlayer(&players[i]);
+
+	save_p = demosnapshotbuf;
+	loaded = P_LoadNetGame(true);
+	save_p = NULL;
+	if (!loaded)
+		return false;
+
+	demo_p = demobuffer + snap->demooffset;
+	oldcmd = snap->oldcmd;
+	oldghost = snap->oldghost;
+	demosynced = snap->synced;
+
+	if (players[displayplayer].mo)
+		P_ResetCamera(&players[displayplayer], &camera);
+	R_ResetViewInterpolation(0);
+	return true;
+}
+
+//
+// G_SeekDemo
+//
+// Jumps playback to the given level time.
+//
+void G_SeekDemo(tic_t target)
+{
+	demosnapshot_t *snap = NULL;
+	boolean wasdisabled = sound_disabled;
+	tic_t start = leveltime, lasttime;
+	char from[16], to[16];
+	precise_t t;
+	size_t i;
+
+	if (!demoplayback || titledemo || gamestate != GS_LEVEL)
+	{
+		CONS_Printf(M_GetText("You can only seek while a replay is playing.\n"));
+		return;
+	}
+	if (ghosts)
+	{
+		CONS_Printf(M_GetText("You can't seek while ghosts are shown.\n"));
+		return;
+	}
+
+	for (i = numdemosnapshots; i-- > 0;)
+		if (demosnapshots[i].leveltime <= target)
+		{
+			snap = &demosnapshots[i];
+			break;
+		}
+
+	t = I_GetPreciseTime();
+
+	// Go back, or skip ahead to a snapshot already taken
+	if (target < leveltime || (snap && snap->leveltime > leveltime))
+	{
+		if (!snap)
+			snap = demosnapshots; // before the first snapshot; as close as it gets
+		if (!numdemosnapshots)
+		{
+			CONS_Printf(M_GetText("There is nothing to seek back to yet.\n"));
+			return;
+		}
+		if (!G_RestoreDemoSnapshot(snap))
+		{
+			CONS_Alert(CONS_ERROR, M_GetText("Couldn't restore the replay.\n"));
+			G_CheckDemoStatus();
+			return;
+		}
+	}
+
+	// Run the rest without drawing or playing sounds
+	sound_disabled = true;
+	while (demoplayback && gamestate == GS_LEVEL && leveltime < target)
+	{
+		lasttime = leveltime;
+		G_Ticker((gametic % NEWTICRATERATIO) == 0);
+		gametic++;
+		if (leveltime == lasttime)
+			break; // paused
+	}
+	sound_disabled = wasdisabled;
+	S_StopSounds();
+
+	if (demoplayback)
+	{
+		G_DemoTimeString(from, sizeof from, start);
+		G_DemoTimeString(to, sizeof to, leveltime);
+		CONS_Printf(M_GetText("Seeked from %s to %s in %d ms.\n"), from, to,
+			(INT32)((I_GetPreciseTime() - t) * 1000 / I_GetPrecisePrecision()));
+	}
+}
+
 //
 // Start a demo from a .LMP file or from a wad resource
 //
@@ -1978,6 +2708,8 @@ void G_DoPlayDemo(char *defdemoname)
 	boolean use_old_demo_vars = false;
 #endif
 
+	G_FreeDemoSnapshots();
+
 	skin[16] = '\0';
 	color[MAXCOLORNAME] = '\0';
 
@@ -2040,6 +2772,7 @@ void G_DoPlayDemo(char *defdemoname)
 	case 0x000f:
 	case 0x000d:
 	case 0x000e:
+	case 0x0010:
 	case DEMOVERSION: // latest always supported
 		cnamelen = MAXCOLORNAME;
 		break;
@@ -2354,6 +3087,7 @@ UINT8 G_CheckDemoForError(char *defdemoname)
 	case 0x000d:
 	case 0x000e:
 	case 0x000f:
+	case 0x0010:
 	case DEMOVERSION: // latest always supported
 		break;
 #ifdef OLD22DEMOCOMPAT
@@ -2387,6 +3121,7 @@ void G_AddGhost(char *defdemoname)
 	demoghost *gh;
 	UINT8 flags, subversion;
 	UINT8 *buffer,*p;
+	size_t size;
 	mapthing_t *mthing;
 	UINT16 count, ghostversion;
 
@@ -2406,7 +3141,7 @@ void G_AddGhost(char *defdemoname)
 	if (FIL_CheckExtension(defdemoname))
 	{
 		//FIL_DefaultExtension(defdemoname, ".lmp");
-		if (!FIL_ReadFileTag(defdemoname, &buffer, PU_LEVEL))
+		if (!(size = FIL_ReadFileTag(defdemoname, &buffer, PU_LEVEL)))
 		{
 			CONS_Alert(CONS_ERROR, M_GetText("Failed to read file '%s'.\n"), defdemoname);
 			Z_Free(pdemoname);
@@ -2422,7 +3157,10 @@ void G_AddGhost(char *defdemoname)
 		return;
 	}
 	else // it's an internal demo
+	{
 		buffer = p = W_CacheLumpNum(l, PU_LEVEL);
+		size = W_LumpLength(l);
+	}
 
 	// read demo header
 	if (memcmp(p, DEMOHEADER, 12))
@@ -2440,6 +3178,7 @@ void G_AddGhost(char *defdemoname)
 	case 0x000f:
 	case 0x000d:
 	case 0x000e:
+	case 0x0010:
 	case DEMOVERSION: // latest always supported
 		cnamelen = MAXCOLORNAME;
 		break;
@@ -2455,7 +3194,7 @@ void G_AddGhost(char *defdemoname)
 		return;
 	}
 	M_Memcpy(md5, p, 16); p += 16; // demo checksum
-	for (gh = ghosts; gh; gh = gh->next)
+	for (gh = ghosts; gh && !ghostbenchmark; gh = gh->next)
 		if (!memcmp(md5, gh->checksum, 16)) // another ghost in the game already has this checksum?
 		{ // Don't add another one, then!
 			CONS_Debug(DBG_SETUP, "Rejecting duplicate ghost %s (MD5 was matched)\n", pdemoname);
@@ -2558,6 +3297,7 @@ void G_AddGhost(char *defdemoname)
 	gh = Z_Calloc(sizeof(demoghost), PU_LEVEL, NULL);
 	gh->next = ghosts;
 	gh->buffer = buffer;
+	gh->end = buffer + size;
 	M_Memcpy(gh->checksum, md5, 16);
 	gh->p = p;
 
@@ -2620,22 +3360,125 @@ void G_AddGhost(char *defdemoname)
 	gh->fadein = (9-3)*6; // fade from invisible to trans30 over as close to 35 tics as possible
 	gh->mo->tics = -1;
 
-	CONS_Printf(M_GetText("Added ghost %s from %s\n"), name, pdemoname);
+	G_QueueGhostDecode(gh);
+
+	if (!ghostbenchmark)
+		CONS_Printf(M_GetText("Added ghost %s from %s\n"), name, pdemoname);
 	Z_Free(pdemoname);
 }
 
 // Clean up all ghosts
 void G_FreeGhosts(void)
 {
+	G_WaitGhostDecoders();
+	ghostspending = false;
+
 	while (ghosts)
 	{
 		demoghost *next = ghosts->next;
+		if (ghosts->decoded)
+			Z_Free(ghosts->tics);
+		else
+			free(ghosts->tics);
 		Z_Free(ghosts);
 		ghosts = next;
 	}
 	ghosts = NULL;
 }
 
+//
+// G_GhostBenchmark
+//
+// ghostbench <replay> [count]: adds a replay as count ghosts, 100 unless
+// told otherwise, then times loading and ticking them. Any ghosts already
+// in the level are removed first, and all of them are removed after.
+//
+static void G_RemoveGhosts(void)
+{
+	demoghost *g;
+
+	G_FinishGhosts();
+	for (g = ghosts; g; g = g->next)
+	{
+		if (g->mo->tracer && !P_MobjWasRemoved(g->mo->tracer))
+			P_RemoveMobj(g->mo->tracer);
+		P_RemoveMobj(g->mo);
+	}
+	G_FreeGhosts();
+}
+
+void G_GhostBenchmark(void)
+{
+	char name[MAX_WADPATH];
+	INT32 count = 100, i, numticks;
+	size_t numghosts = 0, numtics = 0;
+	precise_t loadtime, decodetime = 0, tickertime, t;
+	const double ms = 1000.0 / I_GetPrecisePrecision();
+	demoghost *g;
+
+	if (COM_Argc() < 2)
+	{
+		CONS_Printf(M_GetText("ghostbench <replay> [count]: time loading and running a replay as many ghosts\n"));
+		return;
+	}
+
+	if (gamestate != GS_LEVEL || !playerstarts[0] || demoplayback)
+	{
+		CONS_Printf(M_GetText("You must be in a level to use this.\n"));
+		return;
+	}
+
+	if (COM_Argc() > 2)
+		count = max(1, atoi(COM_Argv(2)));
+
+	// Same as playdemo: external if it has an extension, a lump if not
+	if (FIL_CheckExtension(COM_Argv(1)))
+		snprintf(name, sizeof name, "%s"PATHSEP"%s", srb2home, COM_Argv(1));
+	else
+		strlcpy(name, COM_Argv(1), sizeof name);
+
+	G_RemoveGhosts();
+
+	ghostbenchmark = true;
+	t = I_GetPreciseTime();
+	for (i = 0; i < count; i++)
+		G_AddGhost(name);
+	G_FinishGhosts();
+	loadtime = I_GetPreciseTime() - t;
+	ghostbenchmark = false;
+
+	if (!ghosts)
+		return; // G_AddGhost said why
+
+	// The same decoding again, one ghost after another
+	for (g = ghosts; g; g = g->next)
+	{
+		demoghost copy = *g;
+		copy.tics = NULL;
+		t = I_GetPreciseTime();
+		G_DecodeGhost(&copy);
+		decodetime += I_GetPreciseTime() - t;
+		numtics += copy.numtics;
+		numghosts++;
+		free(copy.tics);
+	}
+
+	P_MapStart();
+	t = I_GetPreciseTime();
+	for (numticks = 0; ghosts && numticks < 10*TICRATE; numticks++)
+		G_GhostTicker();
+	tickertime = I_GetPreciseTime() - t;
+	P_MapEnd();
+
+	CONS_Printf(M_GetText("%s ghosts, %s tics of ghost data\n"), sizeu1(numghosts), sizeu2(numtics));
+	CONS_Printf(M_GetText("Loaded and decoded in %.2f ms (decoding one at a time takes %.2f ms)\n"),
+		loadtime * ms, decodetime * ms);
+	CONS_Printf(M_GetText("G_GhostTicker: %.3f ms per tic over %d tics\n"),
+		numticks ? tickertime * ms / numticks : 0.0, numticks);
+
+	G_RemoveGhosts();
+}
+
 //
 // G_TimeDemo
 // NOTE: name is a full filename for external demos
@@ -2698,6 +3541,7 @@ void G_DoPlayMetal(void)
 	switch(metalversion)
 	{
 	case DEMOVERSION: // latest always supported
+	case 0x0010:
 	case 0x000f:
 	case 0x000e: // There are checks wheter the momentum is from older demo versions or not
 	case 0x000d: // all that changed between then and now was longer color name
@@ -2751,10 +3595,57 @@ static void WriteDemoChecksum(void)
 	for (i = 0; i < 16; i++, p++)
 		*p = P_RandomByte(); // This MD5 was chosen by fair dice roll and most likely < 50% correct.
 #else
-	md5_buffer((char *)p+16, demo_p - (p+16), p); // make a checksum of everything after the checksum in the file.
+	struct md5_ctx ctx;
+	UINT8 ticsum[16];
+
+	if (demostream)
+		md5_finish_ctx(&demomd5, ticsum); // summed up in G_WriteDemoChunk
+	else
+		md5_buffer((char *)demobody, demo_p - demobody, ticsum);
+
+	// The header is finished by now, so sum it with the tic data's sum.
+	// G_AddGhost tells duplicates apart by this, and ghosts with the same
+	// inputs but another skin, color or name aren't the same ghost.
+	md5_init_ctx(&ctx);
+	md5_process_bytes(p+16, demobody - (p+16), &ctx);
+	md5_process_bytes(ticsum, 16, &ctx);
+	md5_finish_ctx(&ctx, p);
 #endif
 }
 
+// Writes out what is left, then the finished header over the placeholder.
+static boolean G_CloseDemoStream(void)
+{
+	char tmpname[MAX_WADPATH+8];
+	const char *filename;
+	boolean failed;
+
+	snprintf(tmpname, sizeof tmpname, "%s"PATHSEP"%s.tmp", srb2home, demoname);
+
+	G_FlushDemoChunk();
+	G_WaitDemoChunks();
+	WriteDemoChecksum();
+
+	failed = demostreamfailed;
+	if (fseek(demostream, 0, SEEK_SET) != 0
+		|| fwrite(demobuffer, 1, demobody - demobuffer, demostream) != (size_t)(demobody - demobuffer))
+		failed = true;
+	if (fclose(demostream) != 0)
+		failed = true;
+	demostream = NULL;
+
+	filename = va(pandf, srb2home, demoname);
+	if (!failed)
+	{
+		remove(filename);
+		failed = (rename(tmpname, filename) != 0);
+	}
+	if (failed)
+		remove(tmpname);
+
+	return !failed;
+}
+
 // Stops recording a demo.
 static void G_StopDemoRecording(void)
 {
@@ -2762,8 +3653,13 @@ static void G_StopDemoRecording(void)
 	if (demo_p)
 	{
 		WRITEUINT8(demo_p, DEMOMARKER); // add the demo end marker
-		WriteDemoChecksum();
-		saved = FIL_WriteFile(va(pandf, srb2home, demoname), demobuffer, demo_p - demobuffer); // finally output the file.
+		if (demostream)
+			saved = G_CloseDemoStream();
+		else
+		{
+			WriteDemoChecksum();
+			saved = FIL_WriteFile(va(pandf, srb2home, demoname), demobuffer, demo_p - demobuffer); // finally output the file.
+		}
 	}
 	free(demobuffer);
 	demorecording = false;
@@ -2867,6 +3763,7 @@ static void G_StopTimingDemo(void)
 // called from stopdemo command, map command, and g_checkdemoStatus.
 void G_StopDemo(void)
 {
+	G_FreeDemoSnapshots();
 	Z_Free(demobuffer);
 	demobuffer = NULL;
 	demoplayback = false;
@@ -95,9 +95,13 @@ void G_LoadMetal(UINT8 **buffer);
 
 void G_DeferedPlayDemo(const char *demo);
 void G_DoPlayDemo(char *defdemoname);
+void G_StoreDemoSnapshot(void);
+void G_SeekDemo(tic_t target);
 void G_TimeDemo(const char *name);
 void G_AddGhost(char *defdemoname);
+void G_FinishGhosts(void);
 void G_FreeGhosts(void);
+void G_GhostBenchmark(void);
 void G_DoPlayMetal(void);
 void G_DoneLevelLoad(void);
 void G_StopMetalDemo(void);
@@ -144,6 +144,7 @@ boolean I_SongPaused(void);
 /// ------------------------
 
 boolean I_SetSongSpeed(float speed);
+void I_SetModFilter(INT32 filter);
 
 /// ------------------------
 //  MUSIC SEEKING
@@ -15,6 +15,7 @@
 #define I_THREADS_H
 
 typedef void (*I_thread_fn)(void *userdata);
+typedef void (*I_job_fn)(void *userdata, size_t index);
 
 typedef void * I_mutex;
 typedef void * I_cond;
@@ -27,6 +28,13 @@ void      I_spawn_thread (const char *name, I_thread_fn, void *userdata);
 /* check in your thread whether to return early */
 int       I_thread_is_stopped (void);
 
+/* how many threads I_parallel_jobs spreads work across */
+int       I_job_threads   (void);
+
+/* calls the function for every index below count, spread across
+   worker threads and the calling thread; returns once all are done */
+void      I_parallel_jobs (size_t count, I_job_fn, void *userdata);
+
 void      I_lock_mutex      (I_mutex *);
 void      I_unlock_mutex    (I_mutex);
 
@@ -840,6 +840,23 @@ static int lib_pGetMobjGravity(lua_State *L)
 	return 1;
 }
 
+// Six field reads in one call, for thinkers that touch every mobj each tic.
+static int lib_pGetMobjPosMom(lua_State *L)
+{
+	mobj_t *mobj = *((mobj_t **)luaL_checkudata(L, 1, META_MOBJ));
+	//HUDSAFE
+	INLEVEL
+	if (!mobj)
+		return LUA_ErrInvalid(L, "mobj_t");
+	lua_pushfixed(L, mobj->x);
+	lua_pushfixed(L, mobj->y);
+	lua_pushfixed(L, mobj->z);
+	lua_pushfixed(L, mobj->momx);
+	lua_pushfixed(L, mobj->momy);
+	lua_pushfixed(L, mobj->momz);
+	return 6;
+}
+
 static int lib_pWeaponOrPanel(lua_State *L)
 {
 	mobjtype_t type = luaL_checkinteger(L, 1);
@@ -4067,6 +4084,7 @@ static luaL_Reg lib[] = {
 	{"P_SpawnPlayerMissile",lib_pSpawnPlayerMissile},
 	{"P_MobjFlip",lib_pMobjFlip},
 	{"P_GetMobjGravity",lib_pGetMobjGravity},
+	{"P_GetMobjPosMom",lib_pGetMobjPosMom},
 	{"P_WeaponOrPanel",lib_pWeaponOrPanel},
 	{"P_FlashPal",lib_pFlashPal},
 	{"P_GetClosestAxis",lib_pGetClosestAxis},
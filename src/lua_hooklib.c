@@ -17,11 +17,13 @@
 #include "r_skins.h"
 #include "b_bot.h"
 #include "z_zone.h"
+#include "p_local.h" // thlist
 
 #include "lua_script.h"
 #include "lua_libs.h"
 #include "lua_hook.h"
 #include "lua_hud.h" // hud_running errors
+#include "lua_profile.h"
 
 #include "m_perfstats.h"
 #include "d_netcmd.h" // for cv_perfstats
@@ -41,6 +43,10 @@ LIST (stringHookNames, STRING_HOOK_LIST);
 
 #undef LIST
 
+#define HUD_LABEL(name) "HUD " #name
+static const char * const hudHookLabels[] = { HUD_HOOK_LIST (HUD_LABEL) NULL };
+#undef HUD_LABEL
+
 typedef struct {
 	int numHooks;
 	int *ids;
@@ -65,8 +71,14 @@ static int   nextid;
 // After a hook errors once, don't print the error again.
 static UINT8 * hooksErrored;
 
+// Also indexed by hook id, the hook type for the profiler.
+static const char ** hookLabels;
+
 static int errorRef;
 
+// Any MobjThinkerBatch hooks at all?
+static boolean batchHooked = false;
+
 static boolean mobj_hook_available(int hook_type, mobjtype_t mobj_type)
 {
 	return
@@ -171,15 +183,19 @@ static void add_mobj_hook(lua_State *L, int hook_type)
 	luaL_argcheck(L, mobj_type < NUMMOBJTYPES, 3, "invalid mobjtype_t");
 
 	add_hook(&mobjHookIds[mobj_type][hook_type]);
+
+	if (hook_type == MOBJ_HOOK(MobjThinkerBatch))
+		batchHooked = true;
 }
 
-static void add_hud_hook(lua_State *L, int idx)
+static const char * add_hud_hook(lua_State *L, int idx)
 {
-	add_hook(&hudHookIds[luaL_checkoption(L,
-				idx, "game", hudHookNames)]);
+	const int type = luaL_checkoption(L, idx, "game", hudHookNames);
+	add_hook(&hudHookIds[type]);
+	return hudHookLabels[type];
 }
 
-static void add_hook_ref(lua_State *L, int idx)
+static void add_hook_ref(lua_State *L, int idx, const char *label)
 {
 	if (!(nextid & 7))
 	{
@@ -190,6 +206,8 @@ static void add_hook_ref(lua_State *L, int idx)
 	}
 
 	Z_Realloc(hookRefs, (nextid + 1) * sizeof *hookRefs, PU_STATIC, &hookRefs);
+	Z_Realloc(hookLabels, (nextid + 1) * sizeof *hookLabels, PU_STATIC, &hookLabels);
+	hookLabels[nextid] = label;
 
 	// set the hook function in the registry.
 	lua_pushvalue(L, idx);
@@ -200,6 +218,7 @@ static void add_hook_ref(lua_State *L, int idx)
 static int lib_addHook(lua_State *L)
 {
 	const char * name;
+	const char * label;
 	int type;
 
 	if (!lua_lumploading)
@@ -212,25 +231,28 @@ static int lib_addHook(lua_State *L)
 	if (( type = hook_in_list(name, stringHookNames) ) < STRING_HOOK(MAX))
 	{
 		add_string_hook(L, type);
+		label = stringHookNames[type];
 	}
 	else if (( type = hook_in_list(name, mobjHookNames) ) < MOBJ_HOOK(MAX))
 	{
 		add_mobj_hook(L, type);
+		label = mobjHookNames[type];
 	}
 	else if (( type = hook_in_list(name, hookNames) ) < HOOK(MAX))
 	{
 		add_hook(&hookIds[type]);
+		label = hookNames[type];
 	}
 	else if (strcmp(name, "HUD") == 0)
 	{
-		add_hud_hook(L, 3);
+		label = add_hud_hook(L, 3);
 	}
 	else
 	{
 		return luaL_argerror(L, 1, lua_pushfstring(L, "invalid hook " LUA_QS, name));
 	}
 
-	add_hook_ref(L, 2);/* the function */
+	add_hook_ref(L, 2, label);/* the function */
 
 	return 0;
 }
@@ -254,8 +276,7 @@ int lib_hudadd(lua_State *L)
 
 	luaL_checktype(L, 1, LUA_TFUNCTION);
 
-	add_hud_hook(L, 2);
-	add_hook_ref(L, 1);
+	add_hook_ref(L, 1, add_hud_hook(L, 2));
 
 	return 0;
 }
@@ -300,8 +321,14 @@ static boolean begin_hook_values(Hook_State *hook)
 
 static void start_hook_stack(void)
 {
-	lua_settop(gL, 0);
-	push_error_handler();
+	/* call_hooks leaves the error handler behind for the next hook */
+	if (lua_gettop(gL) >= EINDEX && lua_tocfunction(gL, EINDEX) == LUA_GetErrorMessage)
+		lua_settop(gL, EINDEX);
+	else
+	{
+		lua_settop(gL, 0);
+		push_error_handler();
+	}
 }
 
 static boolean init_hook_type
@@ -404,7 +431,18 @@ static void get_hook_from_table(Hook_State *hook, int n)
 
 static int call_single_hook_no_copy(Hook_State *hook)
 {
-	if (lua_pcall(gL, hook->values, hook->results, EINDEX) == 0)
+	const boolean profiling = lua_profiling;
+	int error;
+
+	if (profiling)
+		LUA_ProfileHookStart(hook->id, hookLabels[hook->id], hook->values);
+
+	error = lua_pcall(gL, hook->values, hook->results, EINDEX);
+
+	if (profiling)
+		LUA_ProfileHookEnd();
+
+	if (error == 0)
 	{
 		if (hook->results > 0)
 		{
@@ -517,7 +555,8 @@ static int call_hooks
 	else
 		calls += call_mapped(hook, &hookIds[hook->hook_type]);
 
-	lua_settop(gL, 0);
+	/* keep the error handler; mobj hooks tend to come one after another */
+	lua_settop(gL, EINDEX);
 
 	return calls;
 }
@@ -714,6 +753,76 @@ void LUA_HookThinkFrame(void)
 	}
 }
 
+static void add_to_batch(int batches, mobjtype_t type, mobj_t *mobj, UINT32 *counts)
+{
+	lua_rawgeti(gL, batches, type);
+	if (lua_isnil(gL, -1))
+	{
+		lua_pop(gL, 1);
+		lua_newtable(gL);
+		lua_pushvalue(gL, -1);
+		lua_rawseti(gL, batches, type);
+	}
+	LUA_PushUserdata(gL, mobj, META_MOBJ);
+	lua_rawseti(gL, -2, ++counts[type]);
+	lua_pop(gL, 1);
+}
+
+// Hands each MobjThinkerBatch hook one table with every thinking mobj of its
+// type, so an addon pays for one call per tic instead of one per mobj.
+// Generic hooks get every thinking mobj.
+void LUA_HookMobjThinkerBatch(void)
+{
+	static UINT32 counts[NUMMOBJTYPES]; // mobjs per type, MT_NULL for all of them
+	const int type = MOBJ_HOOK(MobjThinkerBatch);
+	const boolean generic = mobjHookIds[MT_NULL][type].numHooks > 0;
+	Hook_State hook;
+	thinker_t *th;
+	int batches, batchesref, i;
+
+	if (!batchHooked)
+		return;
+
+	start_hook_stack();
+	lua_newtable(gL);
+	batches = lua_gettop(gL);
+
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+	{
+		mobj_t *mobj = (mobj_t *)th;
+
+		if (th->function.acp1 != (actionf_p1)P_MobjThinker || (mobj->flags & MF_NOTHINK))
+			continue;
+
+		if (generic)
+			add_to_batch(batches, MT_NULL, mobj, counts);
+		if (mobj->type != MT_NULL && mobjHookIds[mobj->type][type].numHooks > 0)
+			add_to_batch(batches, mobj->type, mobj, counts);
+	}
+
+	// init_hook_type resets the stack for every type, so keep it out of the way
+	batchesref = luaL_ref(gL, LUA_REGISTRYINDEX);
+
+	for (i = 0; i < NUMMOBJTYPES; i++)
+	{
+		if (!counts[i])
+			continue;
+		counts[i] = 0;
+
+		if (init_hook_type(&hook, 0, type, i, NULL, mobjHookIds[i][type].numHooks))
+		{
+			lua_rawgeti(gL, LUA_REGISTRYINDEX, batchesref);
+			lua_rawgeti(gL, -1, i);
+			lua_remove(gL, -2);
+			init_hook_call(&hook, 0, res_none);
+			ps_lua_mobjhooks.value.i += call_mapped(&hook, &mobjHookIds[i][type]);
+		}
+	}
+
+	luaL_unref(gL, LUA_REGISTRYINDEX, batchesref);
+	lua_settop(gL, EINDEX);
+}
+
 int LUA_HookMobjLineCollide(mobj_t *mobj, line_t *line)
 {
 	Hook_State hook;
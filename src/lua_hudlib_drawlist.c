@@ -14,6 +14,8 @@
 
 #include <string.h>
 
+#include "doomstat.h"
+#include "p_local.h" // stplyr
 #include "v_video.h"
 #include "z_zone.h"
 
@@ -69,6 +71,18 @@ struct huddrawlist_s {
 	char *strbuf;
 	size_t strbuf_capacity;
 	size_t strbuf_len;
+
+	// Items left to draw after culling, in order. Lists are replayed every
+	// frame but only rebuilt every tic, so this is kept until the items or
+	// the screen they were culled against change.
+	size_t *replay;
+	size_t replay_capacity;
+	size_t replay_len;
+	boolean replay_valid;
+	INT32 replay_width;
+	INT32 replay_height;
+	boolean replay_splitscreen;
+	player_t *replay_stplyr;
 };
 
 // alignment types for v.drawString
@@ -110,6 +124,10 @@ huddrawlist_h LUA_HUD_CreateDrawList(void)
 	drawlist->strbuf = NULL;
 	drawlist->strbuf_capacity = 0;
 	drawlist->strbuf_len = 0;
+	drawlist->replay = NULL;
+	drawlist->replay_capacity = 0;
+	drawlist->replay_len = 0;
+	drawlist->replay_valid = false;
 
 	return drawlist;
 }
@@ -132,6 +150,9 @@ void LUA_HUD_ClearDrawList(huddrawlist_h list)
 		list->strbuf[0] = 0;
 	}
 	list->strbuf_len = 0;
+
+	list->replay_len = 0;
+	list->replay_valid = false;
 }
 
 void LUA_HUD_DestroyDrawList(huddrawlist_h list)
@@ -142,6 +163,14 @@ void LUA_HUD_DestroyDrawList(huddrawlist_h list)
 	{
 		Z_Free(list->items);
 	}
+	if (list->strbuf)
+	{
+		Z_Free(list->strbuf);
+	}
+	if (list->replay)
+	{
+		Z_Free(list->replay);
+	}
 	Z_Free(list);
 }
 
@@ -163,6 +192,7 @@ static size_t AllocateDrawItem(huddrawlist_h list)
 		list->items = (drawitem_t *) Z_Realloc(list->items, sizeof(struct drawitem_s) * list->items_capacity, PU_STATIC, NULL);
 	}
 
+	list->replay_valid = false;
 	return list->items_len++;
 }
 
@@ -446,6 +476,94 @@ void LUA_HUD_AddFadeScreen(
 	item->strength = strength;
 }
 
+// Gets the scales of a patch draw. Returns false for anything else.
+static boolean GetPatchScales(const drawitem_t *item, fixed_t *x, fixed_t *y, fixed_t *hscale, fixed_t *vscale)
+{
+	switch (item->type)
+	{
+		case DI_Draw:
+			*x = item->x<<FRACBITS;
+			*y = item->y<<FRACBITS;
+			*hscale = *vscale = FRACUNIT;
+			return true;
+		case DI_DrawScaled:
+			*x = item->x;
+			*y = item->y;
+			*hscale = *vscale = item->scale;
+			return true;
+		case DI_DrawStretched:
+			*x = item->x;
+			*y = item->y;
+			*hscale = item->hscale;
+			*vscale = item->vscale;
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Whether a patch draw lands entirely outside of the screen.
+static boolean IsOffscreen(const drawitem_t *item)
+{
+	const fixed_t margin = 2*FRACUNIT; // rounding in the renderers
+	fixed_t x, y, w = 0, h = 0, hscale, vscale;
+
+	if (!item->patch || !GetPatchScales(item, &x, &y, &hscale, &vscale))
+		return false;
+
+	V_GetPatchScreenRegion(&x, &y, &w, &h, hscale, vscale, item->flags, item->patch);
+	if (w <= 0 || h <= 0) // negative scales, leave those alone
+		return false;
+
+	return (x + w < -margin || y + h < -margin
+		|| x > (vid.width<<FRACBITS) + margin || y > (vid.height<<FRACBITS) + margin);
+}
+
+// Whether drawing b right after a changes nothing: the same opaque patch in the same spot.
+static boolean IsRepeatedDraw(const drawitem_t *a, const drawitem_t *b)
+{
+	fixed_t ax, ay, ah, av, bx, by, bh, bv;
+
+	if (a->type != b->type || a->patch != b->patch || a->colormap != b->colormap || a->flags != b->flags)
+		return false;
+	if (b->flags & (V_ALPHAMASK|V_BLENDMASK))
+		return false;
+	if (!GetPatchScales(a, &ax, &ay, &ah, &av) || !GetPatchScales(b, &bx, &by, &bh, &bv))
+		return false;
+
+	return (ax == bx && ay == by && ah == bh && av == bv);
+}
+
+static void BuildReplay(huddrawlist_h list)
+{
+	drawitem_t *last = NULL;
+	size_t i;
+
+	if (list->replay_capacity < list->items_capacity)
+	{
+		list->replay_capacity = list->items_capacity;
+		list->replay = (size_t *) Z_Realloc(list->replay, sizeof(size_t) * list->replay_capacity, PU_STATIC, NULL);
+	}
+
+	list->replay_len = 0;
+	for (i = 0; i < list->items_len; i++)
+	{
+		drawitem_t *item = &list->items[i];
+
+		if (IsOffscreen(item) || (last && IsRepeatedDraw(last, item)))
+			continue;
+
+		list->replay[list->replay_len++] = i;
+		last = item;
+	}
+
+	list->replay_valid = true;
+	list->replay_width = vid.width;
+	list->replay_height = vid.height;
+	list->replay_splitscreen = splitscreen;
+	list->replay_stplyr = stplyr;
+}
+
 void LUA_HUD_DrawList(huddrawlist_h list)
 {
 	size_t i;
@@ -454,9 +572,13 @@ void LUA_HUD_DrawList(huddrawlist_h list)
 	if (list->items_len <= 0) return;
 	if (!list->items) I_Error("HUD drawlist->items invalid");
 
-	for (i = 0; i < list->items_len; i++)
+	if (!list->replay_valid || list->replay_width != vid.width || list->replay_height != vid.height
+		|| list->replay_splitscreen != splitscreen || list->replay_stplyr != stplyr)
+		BuildReplay(list);
+
+	for (i = 0; i < list->replay_len; i++)
 	{
-		drawitem_t *item = &list->items[i];
+		drawitem_t *item = &list->items[list->replay[i]];
 
 		switch (item->type)
 		{
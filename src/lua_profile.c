@@ -0,0 +1,422 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2023 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  lua_profile.c
+/// \brief Lua hook profiler with flamegraph export
+///
+/// Every hook call is timed, and while one runs a count hook interrupts it
+/// every thousand instructions (by default) to charge the time since the
+/// last interruption to the Lua call stack it finds. Stacks are kept in the
+/// collapsed format flamegraph.pl and speedscope read, rooted at the hook
+/// type, with the line being run as the leaf.
+///
+/// luaprofile is a client command; it only measures hooks run on this
+/// machine, whether hosting or not.
+
+#include "doomdef.h"
+#include "command.h"
+#include "i_system.h"
+#include "z_zone.h"
+#include "d_main.h" // srb2home
+#include "d_netfil.h" // nameonly
+
+#include "lua_script.h"
+#include "lua_libs.h"
+#include "lua_profile.h"
+
+boolean lua_profiling = false;
+
+#define PROFMAXDEPTH 16 // hooks running inside other hooks
+#define PROFMAXFRAMES 48 // outermost Lua frames beyond this are dropped
+#define PROFSTACKSIZE 2048
+#define PROFFRAMESIZE (LUA_IDSIZE + 64)
+
+typedef struct
+{
+	char *name; // NULL for an empty bucket
+	UINT32 hash;
+	precise_t time;
+	UINT32 samples;
+} profentry_t;
+
+typedef struct
+{
+	profentry_t *entries;
+	size_t size, count;
+} proftable_t;
+
+typedef struct
+{
+	const char *hookname; // NULL until the hook first runs
+	char func[PROFFRAMESIZE];
+	UINT32 calls;
+	precise_t time;
+} profhook_t;
+
+typedef struct
+{
+	int id;
+	precise_t start;
+} profcall_t;
+
+static proftable_t profstacks; // time by collapsed call stack
+static proftable_t proflines; // time by the line being run
+
+static profhook_t *profhooks = NULL; // indexed by hook id
+static int numprofhooks = 0;
+
+static profcall_t profcalls[PROFMAXDEPTH];
+static int profdepth = 0;
+
+static precise_t proflast; // when time was last charged to a stack
+static precise_t profstart, profelapsed;
+static INT32 profinterval = 1000;
+
+static UINT32 ProfileHash(const char *s)
+{
+	UINT32 hash = 2166136261u;
+	while (*s)
+		hash = (hash ^ (UINT8)*s++) * 16777619u;
+	return hash;
+}
+
+static void ProfileGrow(proftable_t *table)
+{
+	profentry_t *old = table->entries;
+	const size_t oldsize = table->size;
+	size_t i, j;
+
+	table->size = oldsize ? oldsize * 2 : 256;
+	table->entries = Z_Calloc(table->size * sizeof (*table->entries), PU_STATIC, NULL);
+
+	for (i = 0; i < oldsize; i++)
+	{
+		if (!old[i].name)
+			continue;
+		for (j = old[i].hash & (table->size - 1); table->entries[j].name; j = (j + 1) & (table->size - 1))
+			;
+		table->entries[j] = old[i];
+	}
+
+	if (old)
+		Z_Free(old);
+}
+
+static void ProfileAdd(proftable_t *table, const char *name, precise_t time)
+{
+	const UINT32 hash = ProfileHash(name);
+	profentry_t *entry;
+	size_t i;
+
+	if (table->count + 1 > table->size / 2)
+		ProfileGrow(table);
+
+	for (i = hash & (table->size - 1); table->entries[i].name; i = (i + 1) & (table->size - 1))
+		if (table->entries[i].hash == hash && !strcmp(table->entries[i].name, name))
+			break;
+
+	entry = &table->entries[i];
+	if (!entry->name)
+	{
+		entry->name = Z_StrDup(name);
+		entry->hash = hash;
+		table->count++;
+	}
+	entry->time += time;
+	entry->samples++;
+}
+
+static void ProfileClearTable(proftable_t *table)
+{
+	size_t i;
+
+	for (i = 0; i < table->size; i++)
+		if (table->entries[i].name)
+			Z_Free(table->entries[i].name);
+	if (table->entries)
+		Z_Free(table->entries);
+
+	memset(table, 0, sizeof (*table));
+}
+
+static void ProfileClear(void)
+{
+	ProfileClearTable(&profstacks);
+	ProfileClearTable(&proflines);
+
+	if (profhooks)
+		Z_Free(profhooks);
+	profhooks = NULL;
+	numprofhooks = 0;
+
+	profelapsed = 0;
+}
+
+// Semicolons separate frames in the collapsed format.
+static void ProfileFrameName(char *buf, size_t size, const lua_Debug *ar)
+{
+	char *p;
+
+	if (*ar->what == 'C')
+		snprintf(buf, size, "%s [C]", ar->name ? ar->name : "function");
+	else if (*ar->what == 'm')
+		snprintf(buf, size, "main (%s)", ar->short_src);
+	else
+		snprintf(buf, size, "%s (%s:%d)", ar->name ? ar->name : "function", ar->short_src, ar->linedefined);
+
+	for (p = buf; *p; p++)
+		if (*p == ';')
+			*p = ':';
+}
+
+static void ProfileAppend(char *stack, size_t *len, const char *frame)
+{
+	if (*len + 1 + strlen(frame) >= PROFSTACKSIZE)
+		return;
+	if (*len)
+		stack[(*len)++] = ';';
+	strcpy(&stack[*len], frame);
+	*len += strlen(frame);
+}
+
+// Charges the time since the last charge to what L is running now.
+// leaf names a hook function that has already returned.
+static void ProfileCharge(lua_State *L, const char *leaf)
+{
+	const precise_t now = I_GetPreciseTime();
+	const precise_t time = now - proflast;
+	char stack[PROFSTACKSIZE], frame[PROFFRAMESIZE];
+	size_t len = 0;
+	lua_Debug ar;
+	int level;
+
+	proflast = now;
+
+	ProfileAppend(stack, &len, profhooks[profcalls[0].id].hookname);
+
+	for (level = 0; level < PROFMAXFRAMES && lua_getstack(L, level, &ar); level++)
+		;
+
+	while (level--)
+	{
+		lua_getstack(L, level, &ar);
+		lua_getinfo(L, "Sln", &ar);
+		ProfileFrameName(frame, sizeof frame, &ar);
+		ProfileAppend(stack, &len, frame);
+
+		if (level == 0 && !leaf && *ar.what != 'C' && ar.currentline > 0)
+		{
+			snprintf(frame, sizeof frame, "%s:%d", ar.short_src, ar.currentline);
+			ProfileAppend(stack, &len, frame);
+			ProfileAdd(&proflines, frame, time);
+		}
+	}
+
+	if (leaf)
+		ProfileAppend(stack, &len, leaf);
+
+	stack[len] = '\0';
+	ProfileAdd(&profstacks, stack, time);
+}
+
+static void ProfileSample(lua_State *L, lua_Debug *ar)
+{
+	(void)ar;
+	ProfileCharge(L, NULL);
+}
+
+void LUA_ProfileHookStart(int id, const char *hookname, int nargs)
+{
+	profhook_t *hook;
+
+	if (profdepth++ >= PROFMAXDEPTH)
+		return;
+
+	if (id >= numprofhooks)
+	{
+		profhooks = Z_Realloc(profhooks, (id + 1) * sizeof (*profhooks), PU_STATIC, NULL);
+		memset(&profhooks[numprofhooks], 0, (id + 1 - numprofhooks) * sizeof (*profhooks));
+		numprofhooks = id + 1;
+	}
+
+	hook = &profhooks[id];
+	if (!hook->hookname)
+	{
+		lua_Debug ar;
+		hook->hookname = hookname;
+		lua_pushvalue(gL, -1 - nargs);
+		lua_getinfo(gL, ">S", &ar);
+		ar.name = NULL;
+		ProfileFrameName(hook->func, sizeof hook->func, &ar);
+	}
+
+	// Whatever called into this hook gets the time up to here.
+	if (profdepth > 1)
+		ProfileCharge(gL, NULL);
+	else
+		lua_sethook(gL, ProfileSample, LUA_MASKCOUNT, profinterval);
+
+	profcalls[profdepth - 1].id = id;
+	profcalls[profdepth - 1].start = proflast = I_GetPreciseTime();
+}
+
+void LUA_ProfileHookEnd(void)
+{
+	profcall_t *call;
+	profhook_t *hook;
+
+	if (!profdepth)
+		return;
+	if (profdepth > PROFMAXDEPTH)
+	{
+		profdepth--;
+		return;
+	}
+
+	call = &profcalls[profdepth - 1];
+	hook = &profhooks[call->id];
+
+	ProfileCharge(gL, hook->func);
+	hook->calls++;
+	hook->time += proflast - call->start;
+
+	if (!--profdepth)
+		lua_sethook(gL, NULL, 0, 0);
+}
+
+static int ProfileCompareHooks(const void *a, const void *b)
+{
+	const precise_t ta = profhooks[*(const int *)a].time, tb = profhooks[*(const int *)b].time;
+	return (ta < tb) - (ta > tb);
+}
+
+static int ProfileCompareEntries(const void *a, const void *b)
+{
+	const precise_t ta = (*(profentry_t *const *)a)->time, tb = (*(profentry_t *const *)b)->time;
+	return (ta < tb) - (ta > tb);
+}
+
+static void ProfileReport(void)
+{
+	const double ms = 1000.0 / I_GetPrecisePrecision();
+	precise_t elapsed = profelapsed;
+	profentry_t **lines;
+	int *order, numhooks = 0, i;
+	size_t numlines = 0, j;
+
+	if (lua_profiling)
+		elapsed += I_GetPreciseTime() - profstart;
+
+	CONS_Printf(M_GetText("Profiled %.1f seconds\n"), elapsed * ms / 1000.0);
+
+	if (numprofhooks)
+	{
+		order = Z_Malloc(numprofhooks * sizeof (*order), PU_STATIC, NULL);
+		for (i = 0; i < numprofhooks; i++)
+			if (profhooks[i].calls)
+				order[numhooks++] = i;
+		qsort(order, numhooks, sizeof (*order), ProfileCompareHooks);
+
+		CONS_Printf(M_GetText("\x82Hooks by total time:\n"));
+		for (i = 0; i < min(numhooks, 15); i++)
+		{
+			const profhook_t *hook = &profhooks[order[i]];
+			CONS_Printf("%9.2f ms %8u calls  %s  %s\n", hook->time * ms, hook->calls, hook->hookname, hook->func);
+		}
+		Z_Free(order);
+	}
+
+	if (proflines.count)
+	{
+		lines = Z_Malloc(proflines.count * sizeof (*lines), PU_STATIC, NULL);
+		for (j = 0; j < proflines.size; j++)
+			if (proflines.entries[j].name)
+				lines[numlines++] = &proflines.entries[j];
+		qsort(lines, numlines, sizeof (*lines), ProfileCompareEntries);
+
+		CONS_Printf(M_GetText("\x82Lines by sampled time:\n"));
+		for (j = 0; j < min(numlines, 15); j++)
+			CONS_Printf("%9.2f ms %8u samples  %s\n", lines[j]->time * ms, lines[j]->samples, lines[j]->name);
+		Z_Free(lines);
+	}
+}
+
+// One "frame;frame;frame microseconds" line per stack.
+static void ProfileSave(const char *name)
+{
+	const double us = 1000000.0 / I_GetPrecisePrecision();
+	char filename[MAX_WADPATH];
+	const char *path;
+	size_t i, written = 0;
+	FILE *f;
+
+	strlcpy(filename, name, sizeof filename);
+	nameonly(filename);
+	path = va("%s" PATHSEP "%s", srb2home, filename);
+
+	f = fopen(path, "w");
+	if (!f)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Can't write to %s\n"), path);
+		return;
+	}
+
+	for (i = 0; i < profstacks.size; i++)
+	{
+		const profentry_t *entry = &profstacks.entries[i];
+		const UINT32 time = (UINT32)(entry->time * us);
+
+		if (!entry->name || !time)
+			continue;
+		fprintf(f, "%s %u\n", entry->name, time);
+		written++;
+	}
+
+	fclose(f);
+	CONS_Printf(M_GetText("Wrote %s stacks to %s\n"), sizeu1(written), path);
+}
+
+void Command_LuaProfile_f(void)
+{
+	const char *arg = COM_Argc() > 1 ? COM_Argv(1) : "";
+
+	if (!stricmp(arg, "start"))
+	{
+		if (COM_Argc() > 2)
+			profinterval = max(10, atoi(COM_Argv(2)));
+		ProfileClear();
+		profstart = I_GetPreciseTime();
+		lua_profiling = true;
+		CONS_Printf(M_GetText("Profiling Lua hooks, sampling every %d instructions.\n"), profinterval);
+	}
+	else if (!stricmp(arg, "stop"))
+	{
+		if (lua_profiling)
+			profelapsed += I_GetPreciseTime() - profstart;
+		lua_profiling = false;
+		ProfileReport();
+	}
+	else if (!stricmp(arg, "report"))
+		ProfileReport();
+	else if (!stricmp(arg, "save"))
+		ProfileSave(COM_Argc() > 2 ? COM_Argv(2) : "luaprofile.txt");
+	else if (!stricmp(arg, "clear"))
+	{
+		ProfileClear();
+		profstart = I_GetPreciseTime();
+	}
+	else
+	{
+		CONS_Printf(M_GetText(
+			"luaprofile start [instructions]: time every Lua hook, sampling stacks every so many instructions\n"
+			"luaprofile stop: stop and show the report\n"
+			"luaprofile report: show the slowest hooks and lines\n"
+			"luaprofile save [file]: write collapsed stacks for flamegraph.pl, in microseconds\n"
+			"luaprofile clear: forget everything measured so far\n"));
+	}
+}
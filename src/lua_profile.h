@@ -0,0 +1,27 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2023 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  lua_profile.h
+/// \brief Lua hook profiler with flamegraph export
+
+#ifndef __LUA_PROFILE__
+#define __LUA_PROFILE__
+
+#include "doomtype.h"
+
+// Set by the luaprofile command; the hook library checks it around every call.
+extern boolean lua_profiling;
+
+// Called around every hook function call. The function and its arguments
+// (nargs of them) are on top of gL when LUA_ProfileHookStart is called.
+void LUA_ProfileHookStart(int id, const char *hookname, int nargs);
+void LUA_ProfileHookEnd(void);
+
+void Command_LuaProfile_f(void);
+
+#endif
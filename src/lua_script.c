@@ -15,6 +15,7 @@
 #include "dehacked.h"
 #include "deh_lua.h"
 #include "z_zone.h"
+#include "i_system.h" // I_GetPreciseTime
 #include "w_wad.h"
 #include "p_setup.h"
 #include "r_state.h"
@@ -30,10 +31,13 @@
 #ifdef LUA_ALLOW_BYTECODE
 #include "d_netfil.h" // for LUA_DumpFile
 #endif
+#include "d_main.h" // srb2home
+#include "m_misc.h" // FIL_ReadFile, FIL_WriteFile
 
 #include "lua_script.h"
 #include "lua_libs.h"
 #include "lua_hook.h"
+#include "m_perfstats.h"
 
 #include "doomstat.h"
 #include "g_state.h"
@@ -62,8 +66,116 @@ static lua_CFunction liblist[] = {
 	NULL
 };
 
-// Lua asks for memory using this.
+// Lua allocates huge numbers of tiny objects (strings, tables, closures,
+// userdata boxes). Rather than giving each one its own zone block, they are
+// carved out of PU_LUA slabs with one free list per size class. Slabs are kept
+// until the state is closed, so memfree still shows them under PU_LUA.
+#define LUAPOOL_GRANULARITY 16
+#define LUAPOOL_MAXSIZE 256
+#define LUAPOOL_CLASSES (LUAPOOL_MAXSIZE / LUAPOOL_GRANULARITY)
+#define LUAPOOL_SLABSIZE (64*1024)
+
+#define LUAPOOL_CLASS(size) (((size) - 1) / LUAPOOL_GRANULARITY)
+
+typedef struct luapoolslab_s
+{
+	struct luapoolslab_s *next;
+	size_t pad; // Keeps the objects after it 16-byte aligned
+} luapoolslab_t;
+
+typedef struct
+{
+	void *freelist[LUAPOOL_CLASSES];
+	luapoolslab_t *slabs;
+	UINT8 *bump, *bumpend; // Unused space left in the newest slab
+} luapool_t;
+
+static luapool_t luapool;
+
+static void *LUA_PoolGet(luapool_t *pool, size_t size)
+{
+	const size_t c = LUAPOOL_CLASS(size);
+	void *ptr = pool->freelist[c];
+
+	if (ptr)
+	{
+		pool->freelist[c] = *(void **)ptr;
+		return ptr;
+	}
+
+	size = (c + 1) * LUAPOOL_GRANULARITY;
+	if (pool->bump + size > pool->bumpend)
+	{
+		luapoolslab_t *slab = Z_Malloc(LUAPOOL_SLABSIZE, PU_LUA, NULL);
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+		pool->bump = (UINT8 *)(slab + 1);
+		pool->bumpend = (UINT8 *)slab + LUAPOOL_SLABSIZE;
+	}
+
+	ptr = pool->bump;
+	pool->bump += size;
+	return ptr;
+}
+
+static void LUA_PoolPut(luapool_t *pool, void *ptr, size_t size)
+{
+	const size_t c = LUAPOOL_CLASS(size);
+	*(void **)ptr = pool->freelist[c];
+	pool->freelist[c] = ptr;
+}
+
+// Gives every slab back to the zone; only valid once the state using it is closed.
+static void LUA_PoolFree(luapool_t *pool)
+{
+	while (pool->slabs)
+	{
+		luapoolslab_t *next = pool->slabs->next;
+		Z_Free(pool->slabs);
+		pool->slabs = next;
+	}
+	memset(pool, 0, sizeof (*pool));
+}
+
+// Lua asks for memory using this. Lua always passes the current size of
+// the block as osize, so the size class of a pooled block never has to be stored.
 static void *LUA_Alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	luapool_t *pool = ud;
+	void *newptr;
+
+	if (nsize == 0)
+	{
+		if (osize > LUAPOOL_MAXSIZE)
+			Z_Free(ptr);
+		else if (osize != 0)
+			LUA_PoolPut(pool, ptr, osize);
+		return NULL;
+	}
+
+	if (osize > LUAPOOL_MAXSIZE && nsize > LUAPOOL_MAXSIZE)
+		return Z_Realloc(ptr, nsize, PU_LUA, NULL);
+
+	if (osize != 0 && nsize <= LUAPOOL_MAXSIZE && LUAPOOL_CLASS(osize) == LUAPOOL_CLASS(nsize))
+		return ptr;
+
+	// Moving between size classes, or in or out of the pool.
+	if (nsize <= LUAPOOL_MAXSIZE)
+		newptr = LUA_PoolGet(pool, nsize);
+	else
+		newptr = Z_Malloc(nsize, PU_LUA, NULL);
+
+	if (osize != 0)
+	{
+		M_Memcpy(newptr, ptr, min(osize, nsize));
+		LUA_Alloc(ud, ptr, osize, 0);
+	}
+
+	return newptr;
+}
+
+// The old allocator, kept around for luaallocbench to compare against.
+static void *LUA_ZoneAlloc(void *ud, void *ptr, size_t osize, size_t nsize)
 {
 	(void)ud;
 	if (nsize == 0) {
@@ -538,6 +650,119 @@ static int setglobals(lua_State *L)
 	return luaL_error(L, "Implicit global " LUA_QS " prevented. Create a local variable instead.", csname);
 }
 
+// Every userdata pushed to Lua, found by the pointer it wraps. The userdata
+// itself sits at an integer slot of the LREG_VALID table, so pushing a known
+// object again is one hash probe and a lua_rawgeti instead of a string lookup
+// in the registry and a lightuserdata rawget.
+typedef struct
+{
+	void *data;
+	INT32 slot; // 0 for an empty bucket
+} udcacheentry_t;
+
+static udcacheentry_t *udcache = NULL;
+static size_t udcachesize = 0; // always a power of two
+static size_t udcachecount = 0;
+static INT32 *udfreeslots = NULL; // LREG_VALID slots left by invalidated userdata
+static size_t udnumfreeslots = 0, udmaxfreeslots = 0;
+static INT32 udnumslots = 0;
+static int udvalidref = LUA_NOREF; // LREG_VALID's own slot in the registry
+
+static size_t UD_Hash(void *data)
+{
+	return (size_t)(((UINT32)((size_t)data >> 3) ^ (UINT32)((UINT64)(size_t)data >> 32)) * 2654435769u);
+}
+
+// Returns the bucket holding data, or the empty bucket it would go in.
+static size_t UD_Find(void *data)
+{
+	const size_t mask = udcachesize - 1;
+	size_t i = UD_Hash(data) & mask;
+
+	while (udcache[i].slot && udcache[i].data != data)
+		i = (i + 1) & mask;
+
+	return i;
+}
+
+static void UD_Grow(void)
+{
+	udcacheentry_t *old = udcache;
+	const size_t oldsize = udcachesize;
+	size_t i;
+
+	udcachesize = oldsize ? oldsize * 2 : 1024;
+	udcache = Z_Calloc(udcachesize * sizeof (*udcache), PU_STATIC, NULL);
+
+	for (i = 0; i < oldsize; i++)
+		if (old[i].slot)
+			udcache[UD_Find(old[i].data)] = old[i];
+
+	if (old)
+		Z_Free(old);
+}
+
+// Empties bucket i, moving up any entries that probed past it.
+static void UD_Remove(size_t i)
+{
+	const size_t mask = udcachesize - 1;
+	size_t j = i;
+
+	for (;;)
+	{
+		size_t home;
+
+		j = (j + 1) & mask;
+		if (!udcache[j].slot)
+			break;
+
+		home = UD_Hash(udcache[j].data) & mask;
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			udcache[i] = udcache[j];
+			i = j;
+		}
+	}
+
+	udcache[i].slot = 0;
+	udcache[i].data = NULL;
+	udcachecount--;
+}
+
+static void UD_Clear(void)
+{
+	udcacheentry_t *cache = udcache;
+	INT32 *freeslots = udfreeslots;
+
+	udcache = NULL;
+	udfreeslots = NULL;
+	udcachesize = udcachecount = 0;
+	udnumfreeslots = udmaxfreeslots = 0;
+	udnumslots = 0;
+	udvalidref = LUA_NOREF;
+
+	if (cache)
+		Z_Free(cache);
+	if (freeslots)
+		Z_Free(freeslots);
+}
+
+static CV_PossibleValue_t luagcbudget_cons_t[] = {{0, "MIN"}, {20000, "MAX"}, {0, NULL}};
+consvar_t cv_luagcbudget = CVAR_INIT ("luagcbudget", "1000", CV_SAVE, luagcbudget_cons_t, NULL);
+
+static boolean gcwaiting = false; // a cycle finished and the heap hasn't grown enough for another
+static INT32 gccycleheap = 0; // KB still in use when the last cycle finished
+static INT32 gcscale = 1; // how far the budget may stretch into idle time
+
+static void LUA_ResetGCSchedule(void)
+{
+	gcwaiting = false;
+	gccycleheap = 0;
+	gcscale = 1;
+}
+
+static void LUA_FreeFieldHashes(void);
+
 // Clear and create a new Lua state, laddo!
 // There's SCRIPTIN to be had!
 static void LUA_ClearState(void)
@@ -549,11 +774,15 @@ static void LUA_ClearState(void)
 	if (gL)
 		lua_close(gL);
 	gL = NULL;
+	UD_Clear();
+	LUA_FreeFieldHashes();
+	LUA_PoolFree(&luapool);
+	LUA_ResetGCSchedule();
 
 	CONS_Printf(M_GetText("Pardon me while I initialize the Lua scripting interface...\n"));
 
 	// allocate state
-	L = lua_newstate(LUA_Alloc, NULL);
+	L = lua_newstate(LUA_Alloc, &luapool);
 	lua_atpanic(L, LUA_Panic);
 
 	// open base libraries
@@ -562,7 +791,9 @@ static void LUA_ClearState(void)
 
 	// make LREG_VALID table for all pushed userdata cache.
 	lua_newtable(L);
+	lua_pushvalue(L, -1);
 	lua_setfield(L, LUA_REGISTRYINDEX, LREG_VALID);
+	udvalidref = luaL_ref(L, LUA_REGISTRYINDEX);
 
 	// make LREG_METATABLES table for all registered metatables
 	lua_newtable(L);
@@ -601,8 +832,216 @@ void LUA_ClearExtVars(void)
 // (i.e. they were called in hooks or coroutines etc)
 INT32 lua_lumploading = 0;
 
+//
+// Lua bytecode cache
+//
+// Compiling every script from source adds up with large addons, so lumps
+// that compiled successfully are dumped under srb2home, keyed by their
+// file's MD5 and lump number, and loaded back from there the next time.
+// Only bytecode the engine wrote itself is ever loaded this way, and any
+// mismatch (engine build, source checksum, damaged bytecode) falls back to
+// compiling the source.
+//
+
+#define LUACACHEHEADER "SRB2LUAC"
+#define LUACACHEVERSION 1
+#define LUACACHEBUILDSIZE 64
+#define LUACACHEHEADERSIZE (8 + 2 + LUACACHEBUILDSIZE + 4*4) // Magic, version, engine build, source size and checksum, bytecode size and checksum
+
+consvar_t cv_luacache = CVAR_INIT ("luacache", "On", CV_SAVE, CV_OnOff, NULL);
+
+typedef struct
+{
+	UINT8 *data;
+	size_t size, capacity;
+} luacachebuf_t;
+
+static UINT32 LUA_CacheChecksum(UINT32 sum, const void *data, size_t size)
+{
+	const UINT8 *p = data;
+
+	while (size--)
+		sum = (sum ^ *p++) * 16777619u; // FNV-1a
+
+	return sum;
+}
+
+// The chunk name is part of the checksum, since it is baked into the bytecode.
+static UINT32 LUA_CacheSourceChecksum(MYFILE *f, const char *chunkname)
+{
+	UINT32 sum = LUA_CacheChecksum(2166136261u, chunkname, strlen(chunkname));
+	return LUA_CacheChecksum(sum, f->data, f->size);
+}
+
+static const char *LUA_CacheBuild(void)
+{
+	static char build[LUACACHEBUILDSIZE];
+
+	if (!build[0])
+		snprintf(build, sizeof build, "%s %s", VERSIONSTRING, comprevision);
+
+	return build;
+}
+
+// Returns false for files that aren't identified by their MD5, like folders.
+static boolean LUA_CachePath(char *path, size_t size, UINT16 wad, UINT16 lump)
+{
+	const UINT8 *md5sum = wadfiles[wad]->md5sum;
+	char md5hex[33];
+	INT32 i;
+
+	for (i = 0; i < 16; i++)
+		if (md5sum[i])
+			break;
+	if (i == 16)
+		return false;
+
+	for (i = 0; i < 16; i++)
+		sprintf(&md5hex[i*2], "%02x", md5sum[i]);
+
+	snprintf(path, size, "%s"PATHSEP"luacache"PATHSEP"%s-%u.luac", srb2home, md5hex, lump);
+	return true;
+}
+
+// must match lua_Reader
+static const char *LUA_CacheReader(lua_State *L, void *ud, size_t *size)
+{
+	luacachebuf_t *buf = ud;
+	(void)L;
+
+	*size = buf->size;
+	buf->size = 0;
+	return *size ? (const char *)buf->data : NULL;
+}
+
+// must match lua_Writer
+static int LUA_CacheWriter(lua_State *L, const void *p, size_t sz, void *ud)
+{
+	luacachebuf_t *buf = ud;
+	(void)L;
+
+	if (buf->size + sz > buf->capacity)
+	{
+		while (buf->size + sz > buf->capacity)
+			buf->capacity *= 2;
+		buf->data = Z_Realloc(buf->data, buf->capacity, PU_STATIC, NULL);
+	}
+
+	M_Memcpy(buf->data + buf->size, p, sz);
+	buf->size += sz;
+	return 0;
+}
+
+// Pushes the cached chunk for this lump, if there's an up to date one.
+static boolean LUA_LoadCachedChunk(MYFILE *f, const char *path, const char *chunkname)
+{
+	UINT8 *buffer = NULL, *p;
+	size_t length;
+	UINT16 version;
+	UINT32 sourcesize, sourcesum, size, checksum;
+	luacachebuf_t chunk;
+
+	length = FIL_ReadFile(path, &buffer);
+	if (!length)
+		return false;
+
+	if (length < LUACACHEHEADERSIZE || memcmp(buffer, LUACACHEHEADER, 8))
+	{
+		Z_Free(buffer);
+		return false;
+	}
+
+	p = buffer + 8;
+	version = READUINT16(p);
+	if (version != LUACACHEVERSION || strncmp((char *)p, LUA_CacheBuild(), LUACACHEBUILDSIZE))
+	{
+		Z_Free(buffer);
+		return false;
+	}
+
+	p += LUACACHEBUILDSIZE;
+	sourcesize = READUINT32(p);
+	sourcesum = READUINT32(p);
+	size = READUINT32(p);
+	checksum = READUINT32(p);
+
+	if (sourcesize != f->size || sourcesum != LUA_CacheSourceChecksum(f, chunkname)
+		|| size != length - LUACACHEHEADERSIZE || checksum != LUA_CacheChecksum(2166136261u, p, size))
+	{
+		Z_Free(buffer);
+		return false;
+	}
+
+	// lundump still checks the bytecode header and verifies the code itself.
+	chunk.data = p;
+	chunk.size = chunk.capacity = size;
+	if (lua_loadbinary(gL, LUA_CacheReader, &chunk, chunkname))
+	{
+		CONS_Debug(DBG_LUA, "LUA_LoadCachedChunk: %s\n", lua_tostring(gL, -1));
+		lua_pop(gL, 1);
+		Z_Free(buffer);
+		return false;
+	}
+
+	Z_Free(buffer);
+	CONS_Debug(DBG_LUA, "LUA_LoadCachedChunk: loaded %s from %s\n", chunkname + 1, path);
+	return true;
+}
+
+// Dumps the chunk on top of the stack for this lump.
+static void LUA_SaveCachedChunk(MYFILE *f, const char *path, const char *chunkname)
+{
+	luacachebuf_t dump;
+	UINT8 *p;
+
+	dump.capacity = LUACACHEHEADERSIZE + max(f->size, 1024);
+	dump.data = Z_Malloc(dump.capacity, PU_STATIC, NULL);
+	dump.size = LUACACHEHEADERSIZE; // Header is filled in below
+
+	if (lua_dump(gL, LUA_CacheWriter, &dump))
+	{
+		Z_Free(dump.data);
+		return;
+	}
+
+	p = dump.data;
+	M_Memcpy(p, LUACACHEHEADER, 8);
+	p += 8;
+	WRITEUINT16(p, LUACACHEVERSION);
+	memset(p, 0, LUACACHEBUILDSIZE);
+	strlcpy((char *)p, LUA_CacheBuild(), LUACACHEBUILDSIZE);
+	p += LUACACHEBUILDSIZE;
+	WRITEUINT32(p, f->size);
+	WRITEUINT32(p, LUA_CacheSourceChecksum(f, chunkname));
+	WRITEUINT32(p, dump.size - LUACACHEHEADERSIZE);
+	WRITEUINT32(p, LUA_CacheChecksum(2166136261u, dump.data + LUACACHEHEADERSIZE, dump.size - LUACACHEHEADERSIZE));
+
+	I_mkdir(va("%s"PATHSEP"luacache", srb2home), 0755);
+	if (!FIL_WriteFile(path, dump.data, dump.size))
+		CONS_Debug(DBG_LUA, "LUA_SaveCachedChunk: couldn't write %s\n", path);
+
+	Z_Free(dump.data);
+}
+
+// Pushes the compiled chunk for a lump, going through the bytecode cache when possible.
+static int LUA_LoadChunk(MYFILE *f, UINT16 lump, const char *chunkname)
+{
+	char path[1024];
+	boolean cached = cv_luacache.value && LUA_CachePath(path, sizeof path, f->wad, lump);
+	int status;
+
+	if (cached && LUA_LoadCachedChunk(f, path, chunkname))
+		return 0;
+
+	status = luaL_loadbuffer(gL, f->data, f->size, chunkname);
+	if (!status && cached)
+		LUA_SaveCachedChunk(f, path, chunkname);
+
+	return status;
+}
+
 // Load a script from a MYFILE
-static inline void LUA_LoadFile(MYFILE *f, char *name, boolean noresults)
+static inline void LUA_LoadFile(MYFILE *f, char *name, UINT16 lump, boolean noresults)
 {
 	int errorhandlerindex;
 
@@ -616,13 +1055,15 @@ static inline void LUA_LoadFile(MYFILE *f, char *name, boolean noresults)
 
 	lua_lumploading++; // turn on loading flag
 
+	// LUA_Step holds the collector back between frames; let it keep up while loading.
+	lua_gc(gL, LUA_GCRESTART, 0);
+
 	lua_pushcfunction(gL, LUA_GetErrorMessage);
 	errorhandlerindex = lua_gettop(gL);
-	if (luaL_loadbuffer(gL, f->data, f->size, va("@%s",name)) || lua_pcall(gL, 0, noresults ? 0 : LUA_MULTRET, lua_gettop(gL) - 1)) {
+	if (LUA_LoadChunk(f, lump, va("@%s",name)) || lua_pcall(gL, 0, noresults ? 0 : LUA_MULTRET, lua_gettop(gL) - 1)) {
 		CONS_Alert(CONS_WARNING,"%s\n",lua_tostring(gL,-1));
 		lua_pop(gL,1);
 	}
-	lua_gc(gL, LUA_GCCOLLECT, 0);
 	lua_remove(gL, errorhandlerindex);
 
 	lua_lumploading--; // turn off again
@@ -656,7 +1097,7 @@ void LUA_LoadLump(UINT16 wad, UINT16 lump, boolean noresults)
 		name[len] = '\0';
 	}
 
-	LUA_LoadFile(&f, name, noresults); // actually load file!
+	LUA_LoadFile(&f, name, lump, noresults); // actually load file!
 
 	free(name);
 	Z_Free(f.data);
@@ -727,11 +1168,81 @@ void LUA_DumpFile(const char *filename)
 		CONS_Printf("Successfully compiled %s into bytecode.\n", filename);
 	fclose(handle);
 	lua_pop(gL, 1); // function is still on stack after lua_dump
-	lua_gc(gL, LUA_GCCOLLECT, 0);
 	return;
 }
 #endif
 
+// What a typical addon does every tic: per-object state tables, string
+// building for HUD text and lots of short-lived closures and tables.
+static const char luaallocbenchscript[] =
+	"local objects = {}\n"
+	"for i = 1, 256 do\n"
+	"	objects[i] = {x = i, y = -i, z = 0, momx = 0, momy = 0, flags = {}, name = \"obj\"..i}\n"
+	"end\n"
+	"for tic = 1, 35 do\n"
+	"	local hud = {}\n"
+	"	for i, mo in ipairs(objects) do\n"
+	"		local v = {x = mo.momx + tic, y = mo.momy - tic}\n"
+	"		mo.x = mo.x + v.x\n"
+	"		mo.y = mo.y + v.y\n"
+	"		mo.flags[tic % 8] = (mo.flags[tic % 8] or 0) + 1\n"
+	"		local describe = function() return string.format(\"%s %d %d\", mo.name, mo.x, mo.y) end\n"
+	"		if i % 16 == 0 then\n"
+	"			table.insert(hud, describe())\n"
+	"		end\n"
+	"	end\n"
+	"	local text = table.concat(hud, \", \")\n"
+	"	objects[tic] = {x = tic, y = -tic, z = #text, momx = 0, momy = 0, flags = {}, name = \"respawn\"..tic}\n"
+	"end\n";
+
+static precise_t LUA_RunAllocBenchmark(lua_Alloc alloc, void *ud, size_t *peak)
+{
+	precise_t t = I_GetPreciseTime();
+	lua_State *L = lua_newstate(alloc, ud);
+
+	lua_atpanic(L, LUA_Panic);
+	luaL_openlibs(L);
+
+	if (luaL_loadbuffer(L, luaallocbenchscript, sizeof luaallocbenchscript - 1, "=luaallocbench") || lua_pcall(L, 0, 0, 0))
+	{
+		CONS_Alert(CONS_ERROR, "%s\n", lua_tostring(L, -1));
+		lua_pop(L, 1);
+	}
+
+	*peak = max(*peak, (size_t)lua_gc(L, LUA_GCCOUNT, 0));
+	lua_close(L);
+	return I_GetPreciseTime() - t;
+}
+
+// Runs the same script on throwaway states, once with plain zone blocks and once
+// with the pool, so the two allocators can be compared on the same machine.
+void LUA_AllocBenchmark(void)
+{
+	luapool_t pool;
+	INT32 iterations = 20, n;
+	size_t peak = 0, zonebefore = Z_TagUsage(PU_LUA);
+	precise_t zonetime = 0, pooltime = 0;
+	const double ms = 1000.0 / I_GetPrecisePrecision();
+
+	if (COM_Argc() > 1)
+		iterations = max(1, atoi(COM_Argv(1)));
+
+	memset(&pool, 0, sizeof (pool));
+
+	for (n = 0; n < iterations; n++)
+	{
+		zonetime += LUA_RunAllocBenchmark(LUA_ZoneAlloc, NULL, &peak);
+		pooltime += LUA_RunAllocBenchmark(LUA_Alloc, &pool, &peak);
+	}
+
+	CONS_Printf(M_GetText("Lua heap after a run: %s KB, pool slabs: %s KB\n"),
+		sizeu1(peak), sizeu2((Z_TagUsage(PU_LUA) - zonebefore)>>10));
+	LUA_PoolFree(&pool);
+
+	CONS_Printf(M_GetText("Zone allocator: %.2f ms per run\n"), zonetime * ms / iterations);
+	CONS_Printf(M_GetText("Pool allocator: %.2f ms per run\n"), pooltime * ms / iterations);
+}
+
 fixed_t LUA_EvalMath(const char *word)
 {
 	static lua_State *L = NULL;
@@ -743,7 +1254,9 @@ fixed_t LUA_EvalMath(const char *word)
 	{
 		// make a new state so SOC can't interefere with scripts
 		// allocate state
-		L = lua_newstate(LUA_Alloc, NULL);
+		// this state outlives gL, so it gets a pool of its own
+		static luapool_t evalpool;
+		L = lua_newstate(LUA_Alloc, &evalpool);
 		lua_atpanic(L, LUA_Panic);
 
 		// open only enum lib
@@ -796,36 +1309,43 @@ lpushed_t LUA_RawPushUserdata(lua_State *L, void *data)
 	lpushed_t status = LPUSHED_NIL;
 
 	void **userdata;
+	size_t i;
 
 	if (!data) { // push a NULL
 		lua_pushnil(L);
 		return status;
 	}
 
-	lua_getfield(L, LUA_REGISTRYINDEX, LREG_VALID);
-	I_Assert(lua_istable(L, -1));
+	if (udcachecount + 1 > udcachesize / 2)
+		UD_Grow();
+	i = UD_Find(data);
 
-	lua_pushlightuserdata(L, data);
-	lua_rawget(L, -2);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, udvalidref);
+	I_Assert(lua_istable(L, -1));
 
-	if (lua_isnil(L, -1)) { // no userdata? deary me, we'll have to make one.
-		lua_pop(L, 1); // pop the nil
+	if (udcache[i].slot)
+	{
+		lua_rawgeti(L, -1, udcache[i].slot);
+		status = LPUSHED_EXISTING;
+	}
+	else { // no userdata? deary me, we'll have to make one.
+		const INT32 slot = udnumfreeslots ? udfreeslots[--udnumfreeslots] : ++udnumslots;
 
 		// create the userdata
 		userdata = lua_newuserdata(L, sizeof(void *));
 		*userdata = data;
 
 		// Set it in the registry so we can find it again
-		lua_pushlightuserdata(L, data); // k (store the userdata via the data's pointer)
-		lua_pushvalue(L, -2); // v (copy of the userdata)
-		lua_rawset(L, -4);
+		lua_pushvalue(L, -1);
+		lua_rawseti(L, -3, slot);
+		udcache[i].data = data;
+		udcache[i].slot = slot;
+		udcachecount++;
 
 		// stack is left with the userdata on top, as if getting it had originally succeeded.
 
 		status = LPUSHED_NEW;
 	}
-	else
-		status = LPUSHED_EXISTING;
 
 	lua_remove(L, -2); // remove LREG_VALID
 
@@ -836,37 +1356,47 @@ lpushed_t LUA_RawPushUserdata(lua_State *L, void *data)
 void LUA_InvalidateUserdata(void *data)
 {
 	void **userdata;
-	if (!gL)
+	size_t i;
+	INT32 slot;
+
+	// Most of what gets here is zone memory Lua has never seen.
+	if (!gL || !udcachecount)
 		return;
 
-	// fetch the userdata
-	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_VALID);
+	i = UD_Find(data);
+	slot = udcache[i].slot;
+	if (!slot) // not found, not in lua
+		return;
+	UD_Remove(i);
+
+	// nullify any additional data
+	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
 	I_Assert(lua_istable(gL, -1));
 		lua_pushlightuserdata(gL, data);
-		lua_rawget(gL, -2);
-			if (lua_isnil(gL, -1)) { // not found, not in lua
-				lua_pop(gL, 2); // pop nil and LREG_VALID
-				return;
-			}
-
-			// nullify any additional data
-			lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
-			I_Assert(lua_istable(gL, -1));
-				lua_pushlightuserdata(gL, data);
-				lua_pushnil(gL);
-				lua_rawset(gL, -3);
-			lua_pop(gL, 1);
+		lua_pushnil(gL);
+		lua_rawset(gL, -3);
+	lua_pop(gL, 1);
 
+	// fetch the userdata
+	lua_rawgeti(gL, LUA_REGISTRYINDEX, udvalidref);
+	I_Assert(lua_istable(gL, -1));
+		lua_rawgeti(gL, -1, slot);
 			// invalidate the userdata
 			userdata = lua_touserdata(gL, -1);
 			*userdata = NULL;
 		lua_pop(gL, 1);
 
 		// remove it from the registry
-		lua_pushlightuserdata(gL, data);
 		lua_pushnil(gL);
-		lua_rawset(gL, -3);
+		lua_rawseti(gL, -2, slot);
 	lua_pop(gL, 1); // pop LREG_VALID
+
+	if (udnumfreeslots == udmaxfreeslots)
+	{
+		udmaxfreeslots = udmaxfreeslots ? udmaxfreeslots * 2 : 256;
+		udfreeslots = Z_Realloc(udfreeslots, udmaxfreeslots * sizeof (*udfreeslots), PU_STATIC, NULL);
+	}
+	udfreeslots[udnumfreeslots++] = slot;
 }
 
 // Invalidate level data arrays
@@ -957,6 +1487,107 @@ void LUA_InvalidatePlayer(player_t *player)
 	LUA_InvalidateUserdata(&player->cmd);
 }
 
+// Times what every mobj hook pays before the Lua function runs: pushing the
+// mobj, both the old registry way and through the userdata cache, and then a
+// full call into an empty Lua function. The last row is the cost Z_Free pays
+// for memory Lua never saw.
+void LUA_PushBenchmark(void)
+{
+	thinker_t *th;
+	INT32 iterations = 100, n;
+	size_t count = 0, unseen = 0;
+	precise_t registrytime = 0, cachetime = 0, calltime = 0, freetime = 0, t;
+	double ns;
+
+	if (!gL || gamestate != GS_LEVEL)
+	{
+		CONS_Printf(M_GetText("You must be in a level to use this.\n"));
+		return;
+	}
+
+	if (COM_Argc() > 1)
+		iterations = max(1, atoi(COM_Argv(1)));
+
+	lua_settop(gL, 0);
+
+	// Rebuild the old pointer-keyed table to time lookups in it.
+	lua_newtable(gL);
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+	{
+		if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+			continue;
+		lua_pushlightuserdata(gL, th);
+		LUA_PushUserdata(gL, th, META_MOBJ);
+		lua_rawset(gL, -3);
+		count++;
+	}
+	lua_setfield(gL, LUA_REGISTRYINDEX, "luapushbench");
+
+	if (!count)
+	{
+		CONS_Printf(M_GetText("There are no objects in this level.\n"));
+		return;
+	}
+
+	luaL_loadstring(gL, "return function(mo) end");
+	lua_call(gL, 0, 1);
+
+	for (n = 0; n < iterations; n++)
+	{
+		t = I_GetPreciseTime();
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		{
+			if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+				continue;
+			lua_getfield(gL, LUA_REGISTRYINDEX, "luapushbench");
+			lua_pushlightuserdata(gL, th);
+			lua_rawget(gL, -2);
+			lua_pop(gL, 2);
+		}
+		registrytime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		{
+			if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+				continue;
+			LUA_PushUserdata(gL, th, META_MOBJ);
+			lua_pop(gL, 1);
+		}
+		cachetime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		{
+			if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed)
+				continue;
+			lua_pushvalue(gL, 1);
+			LUA_PushUserdata(gL, th, META_MOBJ);
+			lua_pcall(gL, 1, 0, 0);
+		}
+		calltime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		{
+			LUA_InvalidateUserdata((UINT8 *)th + 1);
+			unseen++;
+		}
+		freetime += I_GetPreciseTime() - t;
+	}
+
+	lua_pushnil(gL);
+	lua_setfield(gL, LUA_REGISTRYINDEX, "luapushbench");
+	lua_settop(gL, 0);
+
+	ns = 1000000000.0 / I_GetPrecisePrecision() / (count * iterations);
+	CONS_Printf(M_GetText("%s mobjs, %d passes\n"), sizeu1(count), iterations);
+	CONS_Printf(M_GetText("Registry lookup: %.1f ns per mobj\n"), registrytime * ns);
+	CONS_Printf(M_GetText("Userdata cache: %.1f ns per mobj\n"), cachetime * ns);
+	CONS_Printf(M_GetText("Push + empty hook call: %.1f ns per mobj\n"), calltime * ns);
+	CONS_Printf(M_GetText("Invalidating unknown memory: %.1f ns per call\n"), freetime * 1000000000.0 / I_GetPrecisePrecision() / unseen);
+}
+
 enum
 {
 	ARCH_NULL=0,
@@ -967,7 +1598,9 @@ enum
 	ARCH_INT32,
 	ARCH_SMALLSTRING,
 	ARCH_LARGESTRING,
+	ARCH_STRINGREF,
 	ARCH_TABLE,
+	ARCH_REPEAT,
 
 	ARCH_MOBJINFO,
 	ARCH_STATE,
@@ -1042,6 +1675,94 @@ static UINT8 GetUserdataArchType(int index)
 	return ARCH_NULL;
 }
 
+//
+// The tables table doubles as the archive's lookup for everything written
+// more than once: tables[i] is table i and tables[table] is its ID, so
+// repeated tables are found without scanning. Strings of ARCHIVESTRINGMIN
+// characters or more are only written out the first time; later copies are
+// written as ARCH_STRINGREF, with tables[string] holding the string's ID
+// while archiving and tables[-ID] the string while unarchiving.
+//
+
+#define ARCHIVESTRINGMIN 3
+
+static UINT16 archivestrings; // strings numbered so far
+
+//
+// Archive size accounting, shown by luaarchivesize.
+// Every extvars field and the NetArchive hook are roots; tables are charged
+// to the root they were first reached from.
+//
+
+typedef struct
+{
+	const char *ptype; // "player", "mobj", or NULL for the NetArchive hook
+	char field[32];
+	UINT32 bytes;
+	UINT32 tables;
+} archiveroot_t;
+
+static archiveroot_t *archiveroots = NULL;
+static UINT16 numarchiveroots = 0, maxarchiveroots = 0;
+static UINT16 *archivetableroots = NULL; // root of every archived table, by table ID
+static size_t maxarchivetableroots = 0;
+static UINT16 archiveroot; // root being written
+static UINT32 archivetotal; // size of the last archive
+static precise_t archivetime; // time taken by the last archive
+
+static UINT16 GetArchiveRoot(const char *ptype, const char *field)
+{
+	UINT16 i;
+
+	for (i = 0; i < numarchiveroots; i++)
+		if (archiveroots[i].ptype == ptype && !strcmp(archiveroots[i].field, field))
+			return i;
+
+	if (numarchiveroots == maxarchiveroots)
+	{
+		maxarchiveroots = maxarchiveroots ? maxarchiveroots * 2 : 16;
+		archiveroots = Z_Realloc(archiveroots, maxarchiveroots * sizeof (*archiveroots), PU_STATIC, NULL);
+	}
+
+	archiveroots[i].ptype = ptype;
+	strlcpy(archiveroots[i].field, field, sizeof archiveroots[i].field);
+	archiveroots[i].bytes = archiveroots[i].tables = 0;
+	return numarchiveroots++;
+}
+
+static void SetArchiveTableRoot(UINT16 t)
+{
+	if (t >= maxarchivetableroots)
+	{
+		size_t newsize = max(maxarchivetableroots * 2, 256);
+		while (t >= newsize)
+			newsize *= 2;
+		archivetableroots = Z_Realloc(archivetableroots, newsize * sizeof (*archivetableroots), PU_STATIC, NULL);
+		maxarchivetableroots = newsize;
+	}
+
+	archivetableroots[t] = archiveroot;
+	archiveroots[archiveroot].tables++;
+}
+
+// Counts of array elements and runs; one byte when small.
+static void WriteArchiveCount(UINT32 count)
+{
+	if (count < 0xFF)
+		WRITEUINT8(save_p, count);
+	else
+	{
+		WRITEUINT8(save_p, 0xFF);
+		WRITEUINT32(save_p, count);
+	}
+}
+
+static UINT32 ReadArchiveCount(void)
+{
+	UINT8 count = READUINT8(save_p);
+	return (count < 0xFF) ? count : READUINT32(save_p);
+}
+
 static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 {
 	if (myindex < 0)
@@ -1085,7 +1806,28 @@ static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 	{
 		UINT32 len = (UINT32)lua_objlen(gL, myindex); // get length of string, including embedded zeros
 		const char *s = lua_tostring(gL, myindex);
-		UINT32 i = 0;
+
+		if (len >= ARCHIVESTRINGMIN)
+		{
+			lua_pushvalue(gL, myindex);
+			lua_rawget(gL, TABLESINDEX);
+			if (!lua_isnil(gL, -1))
+			{
+				WRITEUINT8(save_p, ARCH_STRINGREF);
+				WRITEUINT16(save_p, (UINT16)lua_tointeger(gL, -1));
+				lua_pop(gL, 1);
+				break;
+			}
+			lua_pop(gL, 1);
+
+			if (archivestrings < UINT16_MAX)
+			{
+				lua_pushvalue(gL, myindex);
+				lua_pushinteger(gL, ++archivestrings);
+				lua_rawset(gL, TABLESINDEX);
+			}
+		}
+
 		// if you're wondering why we're writing a string to save_p this way,
 		// it turns out that Lua can have embedded zeros ('\0') in the strings,
 		// so we can't use WRITESTRING as that cuts off when it finds a '\0'.
@@ -1103,48 +1845,43 @@ static UINT8 ArchiveValue(int TABLESINDEX, int myindex)
 			WRITEUINT8(save_p, ARCH_LARGESTRING);
 			WRITEUINT32(save_p, len); // save size of string
 		}
-		while (i < len)
-			WRITECHAR(save_p, s[i++]); // write chars individually, including the embedded zeros
+		WRITEMEM(save_p, s, len); // including the embedded zeros
 		break;
 	}
 	case LUA_TTABLE:
 	{
-		boolean found = false;
-		INT32 i;
-		UINT16 t = (UINT16)lua_objlen(gL, TABLESINDEX);
+		UINT16 t;
 
-		for (i = 1; i <= t && !found; i++)
+		lua_pushvalue(gL, myindex);
+		lua_rawget(gL, TABLESINDEX);
+		t = (UINT16)lua_tointeger(gL, -1); // 0 if it wasn't archived yet
+		lua_pop(gL, 1);
+
+		if (t)
 		{
-			lua_rawgeti(gL, TABLESINDEX, i);
-			if (lua_rawequal(gL, myindex, -1))
-			{
-				t = i;
-				found = true;
-			}
-			lua_pop(gL, 1);
+			WRITEUINT8(save_p, ARCH_TABLE);
+			WRITEUINT16(save_p, t);
+			break;
 		}
-		if (!found)
-		{
-			t++;
 
-			if (t == 0)
-			{
-				CONS_Alert(CONS_ERROR, "Too many tables to archive!\n");
-				WRITEUINT8(save_p, ARCH_NULL);
-				return 0;
-			}
+		t = (UINT16)(lua_objlen(gL, TABLESINDEX) + 1);
+		if (t == 0)
+		{
+			CONS_Alert(CONS_ERROR, "Too many tables to archive!\n");
+			WRITEUINT8(save_p, ARCH_NULL);
+			return 0;
 		}
 
 		WRITEUINT8(save_p, ARCH_TABLE);
 		WRITEUINT16(save_p, t);
 
-		if (!found)
-		{
-			lua_pushvalue(gL, myindex);
-			lua_rawseti(gL, TABLESINDEX, t);
-			return 1;
-		}
-		break;
+		lua_pushvalue(gL, myindex);
+		lua_rawseti(gL, TABLESINDEX, t);
+		lua_pushvalue(gL, myindex);
+		lua_pushinteger(gL, t);
+		lua_rawset(gL, TABLESINDEX);
+		SetArchiveTableRoot(t);
+		return 1;
 	}
 	case LUA_TUSERDATA:
 		switch (GetUserdataArchType(myindex))
@@ -1402,10 +2139,13 @@ static void ArchiveExtVars(void *pointer, const char *ptype)
 	lua_pushnil(gL);
 	while (lua_next(gL, -2))
 	{
+		UINT8 *start = save_p;
 		I_Assert(lua_type(gL, -2) == LUA_TSTRING);
-		WRITESTRING(save_p, lua_tostring(gL, -2));
+		archiveroot = GetArchiveRoot(ptype, lua_tostring(gL, -2));
+		ArchiveValue(TABLESINDEX, -2); // field names repeat across objects, so they go through the string table too
 		if (ArchiveValue(TABLESINDEX, -1) == 2)
 			CONS_Alert(CONS_ERROR, "Type of value for %s entry '%s' (%s) could not be archived!\n", ptype, lua_tostring(gL, -2), luaL_typename(gL, -1));
+		archiveroots[archiveroot].bytes += save_p - start;
 		lua_pop(gL, 1);
 	}
 
@@ -1416,8 +2156,11 @@ static int NetArchive(lua_State *L)
 {
 	int TABLESINDEX = lua_upvalueindex(1);
 	int i, n = lua_gettop(L);
+	UINT8 *start = save_p;
+	archiveroot = GetArchiveRoot(NULL, "NetArchive");
 	for (i = 1; i <= n; i++)
 		ArchiveValue(TABLESINDEX, i);
+	archiveroots[archiveroot].bytes += save_p - start;
 	return n;
 }
 
@@ -1435,10 +2178,56 @@ static void ArchiveTables(void)
 	n = (UINT16)lua_objlen(gL, TABLESINDEX);
 	for (i = 1; i <= n; i++)
 	{
+		UINT8 *start = save_p;
+		UINT32 arraylen, j, run;
+
+		archiveroot = archivetableroots[i];
 		lua_rawgeti(gL, TABLESINDEX, i);
+
+		// Write the array part first, as runs of equal values.
+		arraylen = (UINT32)lua_objlen(gL, -1);
+		WriteArchiveCount(arraylen);
+		for (j = 1; j <= arraylen; j += run)
+		{
+			lua_rawgeti(gL, -1, j);
+			for (run = 1; j + run <= arraylen; run++)
+			{
+				boolean same;
+				lua_rawgeti(gL, -2, j + run);
+				same = lua_rawequal(gL, -1, -2);
+				lua_pop(gL, 1);
+				if (!same)
+					break;
+			}
+
+			if (run > 1)
+			{
+				WRITEUINT8(save_p, ARCH_REPEAT);
+				WriteArchiveCount(run);
+			}
+
+			e = ArchiveValue(TABLESINDEX, -1);
+			if (e == 1)
+				n++;
+			else if (e == 2)
+				CONS_Alert(CONS_ERROR, "Type of value for table %d entry '%u' (%s) could not be archived!\n", i, j, luaL_typename(gL, -1));
+
+			lua_pop(gL, 1);
+		}
+
 		lua_pushnil(gL);
 		while (lua_next(gL, -2))
 		{
+			if (lua_type(gL, -2) == LUA_TNUMBER)
+			{
+				lua_Integer key = lua_tointeger(gL, -2);
+				if (key >= 1 && (UINT32)key <= arraylen) // already written
+				{
+					lua_pop(gL, 1);
+					continue;
+				}
+			}
+
 			// Write key
 			e = ArchiveValue(TABLESINDEX, -2); // key should be either a number or a string, ArchiveValue can handle this.
 			if (e == 2) // invalid key type (function, thread, lightuserdata, or anything we don't recognise)
@@ -1468,6 +2257,7 @@ static void ArchiveTables(void)
 			WRITEUINT16(save_p, 0);
 
 		lua_pop(gL, 1);
+		archiveroots[archiveroot].bytes += save_p - start;
 	}
 }
 
@@ -1498,8 +2288,6 @@ static UINT8 UnArchiveValue(int TABLESINDEX)
 	case ARCH_LARGESTRING:
 	{
 		UINT32 len;
-		char *value;
-		UINT32 i = 0;
 
 		// See my comments in the ArchiveValue function;
 		// it's much the same for reading strings as writing them!
@@ -1509,14 +2297,19 @@ static UINT8 UnArchiveValue(int TABLESINDEX)
 			len = READUINT8(save_p); // length of string, including embedded zeros
 		else
 			len = READUINT32(save_p); // length of string, including embedded zeros
-		value = malloc(len); // make temp buffer of size len
-		// now read the actual string
-		while (i < len)
-			value[i++] = READCHAR(save_p); // read chars individually, including the embedded zeros
-		lua_pushlstring(gL, value, len); // push the string (note: this function supports embedded zeros)
-		free(value); // free the buffer
+		lua_pushlstring(gL, (const char *)save_p, len); // push the string (note: this function supports embedded zeros)
+		save_p += len;
+
+		if (len >= ARCHIVESTRINGMIN && archivestrings < UINT16_MAX)
+		{
+			lua_pushvalue(gL, -1);
+			lua_rawseti(gL, TABLESINDEX, -(++archivestrings));
+		}
 		break;
 	}
+	case ARCH_STRINGREF:
+		lua_rawgeti(gL, TABLESINDEX, -READUINT16(save_p));
+		break;
 	case ARCH_TABLE:
 	{
 		UINT16 tid = READUINT16(save_p);
@@ -1607,7 +2400,6 @@ static void UnArchiveExtVars(void *pointer)
 	int TABLESINDEX;
 	UINT16 field_count = READUINT16(save_p);
 	UINT16 i;
-	char field[1024];
 
 	if (field_count == 0)
 		return;
@@ -1618,9 +2410,9 @@ static void UnArchiveExtVars(void *pointer)
 
 	for (i = 0; i < field_count; i++)
 	{
-		READSTRING(save_p, field);
+		UnArchiveValue(TABLESINDEX); // field name
 		UnArchiveValue(TABLESINDEX);
-		lua_setfield(gL, -2, field);
+		lua_rawset(gL, -3);
 	}
 
 	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
@@ -1654,7 +2446,30 @@ static void UnArchiveTables(void)
 	n = (UINT16)lua_objlen(gL, TABLESINDEX);
 	for (i = 1; i <= n; i++)
 	{
+		UINT32 arraylen, j, run;
+
 		lua_rawgeti(gL, TABLESINDEX, i);
+
+		arraylen = ReadArchiveCount();
+		for (j = 1; j <= arraylen;)
+		{
+			run = 1;
+			if (*save_p == ARCH_REPEAT)
+			{
+				save_p++;
+				run = ReadArchiveCount();
+			}
+
+			if (UnArchiveValue(TABLESINDEX) == 2)
+				n++;
+			for (; run && j <= arraylen; run--)
+			{
+				lua_pushvalue(gL, -1);
+				lua_rawseti(gL, -3, j++);
+			}
+			lua_pop(gL, 1);
+		}
+
 		while (true)
 		{
 			if (UnArchiveValue(TABLESINDEX) == 1) // read key
@@ -1686,22 +2501,80 @@ static void UnArchiveTables(void)
 	}
 }
 
-void LUA_Step(void)
+// Runs the garbage collector for up to luagcbudget microseconds between frames,
+// so it doesn't pause the game in the middle of a tic. idle is how long the main
+// loop would sleep after this; the budget grows into it when the game makes
+// garbage faster than the collector keeps up with.
+void LUA_Step(precise_t idle)
 {
+	const precise_t start = I_GetPreciseTime();
+	INT32 heap;
+
 	if (!gL)
 		return;
 	lua_settop(gL, 0);
-	lua_gc(gL, LUA_GCSTEP, 1);
+
+	heap = lua_gc(gL, LUA_GCCOUNT, 0);
+
+	if (!cv_luagcbudget.value)
+	{
+		// Collect during allocations like stock Lua does, with a small step here.
+		lua_gc(gL, LUA_GCRESTART, 0);
+		lua_gc(gL, LUA_GCSTEP, 1);
+		LUA_ResetGCSchedule();
+	}
+	else
+	{
+		// Like the collector's own pause, wait for the heap to double before starting over.
+		if (!gcwaiting || heap >= gccycleheap * 2)
+		{
+			precise_t budget = cv_luagcbudget.value * (I_GetPrecisePrecision() / 1000000);
+			budget = max(budget, min(budget * gcscale, idle));
+
+			gcwaiting = false;
+			do
+			{
+				if (lua_gc(gL, LUA_GCSTEP, 0)) // finished a cycle
+				{
+					gcwaiting = true;
+					break;
+				}
+			} while (I_GetPreciseTime() - start < budget);
+
+			heap = lua_gc(gL, LUA_GCCOUNT, 0);
+			if (gcwaiting)
+			{
+				gccycleheap = heap;
+				gcscale = max(gcscale - 1, 1);
+			}
+			else if (heap >= gccycleheap * 2)
+				gcscale = min(gcscale * 2, 16); // the next cycle is due before this one is done
+		}
+
+		// Past twice the pause, stop holding the collector back and let tics pay for it.
+		if (heap >= max(gccycleheap, 1024) * 4)
+			lua_gc(gL, LUA_GCRESTART, 0);
+		else
+			lua_gc(gL, LUA_GCSTOP, 0);
+	}
+
+	ps_lua_gctime.value.p = I_GetPreciseTime() - start;
+	ps_lua_heapsize.value.i = heap;
 }
 
 void LUA_Archive(void)
 {
 	INT32 i;
 	thinker_t *th;
+	const UINT8 *start = save_p;
+	precise_t time = I_GetPreciseTime();
 
 	if (gL)
 		lua_newtable(gL); // tables to be archived.
 
+	archivestrings = 0;
+	numarchiveroots = 0;
+
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
 		if (!playeringame[i] && i > 0) // dedicated servers...
@@ -1727,6 +2600,44 @@ void LUA_Archive(void)
 
 	if (gL)
 		lua_pop(gL, 1); // pop tables
+
+	archivetotal = (UINT32)(save_p - start);
+	archivetime = I_GetPreciseTime() - time;
+}
+
+static int CompareArchiveRoots(const void *a, const void *b)
+{
+	UINT32 x = ((const archiveroot_t *)a)->bytes;
+	UINT32 y = ((const archiveroot_t *)b)->bytes;
+	return (x < y) - (x > y);
+}
+
+// Shows where the bytes of the last Lua archive went.
+void LUA_ArchiveSizes(void)
+{
+	UINT32 attributed = 0;
+	UINT16 i;
+
+	if (!archivetotal)
+	{
+		CONS_Printf(M_GetText("Nothing has been archived yet.\n"));
+		return;
+	}
+
+	qsort(archiveroots, numarchiveroots, sizeof (*archiveroots), CompareArchiveRoots);
+
+	CONS_Printf(M_GetText("Last Lua archive: %s bytes in %.2f ms\n"), sizeu1(archivetotal),
+		archivetime * 1000.0 / I_GetPrecisePrecision());
+	for (i = 0; i < numarchiveroots; i++)
+	{
+		const archiveroot_t *root = &archiveroots[i];
+		if (root->ptype)
+			CONS_Printf("%8s  %s.%s (%s tables)\n", sizeu1(root->bytes), root->ptype, root->field, sizeu2(root->tables));
+		else
+			CONS_Printf("%8s  %s (%s tables)\n", sizeu1(root->bytes), root->field, sizeu2(root->tables));
+		attributed += root->bytes;
+	}
+	CONS_Printf("%8s  headers\n", sizeu1(archivetotal - attributed));
 }
 
 void LUA_UnArchive(void)
@@ -1738,6 +2649,8 @@ void LUA_UnArchive(void)
 	if (gL)
 		lua_newtable(gL); // tables to be read
 
+	archivestrings = 0;
+
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
 		if (!playeringame[i] && i > 0) // dedicated servers...
@@ -1765,13 +2678,106 @@ void LUA_UnArchive(void)
 }
 
 // For mobj_t, player_t, etc. to take custom variables.
+// Field names stay alive as keys of their field table, and Lua interns every
+// string, so any Lua string equal to a field name is that very string. This
+// lets Lua_optoption find a field by pointer alone, in a collision-free hash
+// built once per field table.
+typedef struct
+{
+	const char *key;
+	INT32 value;
+} fieldslot_t;
+
+typedef struct
+{
+	fieldslot_t *slots; // NULL if no hash was built
+	UINT32 seed;
+	UINT8 bits;
+} fieldhash_t;
+
+static fieldhash_t *fieldhashes = NULL; // indexed by field table ref
+static int numfieldhashes = 0;
+
+static UINT32 FieldHash(const char *key, UINT32 seed, UINT8 bits)
+{
+	const UINT32 h = (UINT32)((size_t)key >> 2) ^ (UINT32)((UINT64)(size_t)key >> 32);
+	return (h * seed) >> (32 - bits);
+}
+
+static void BuildFieldHash(fieldhash_t *hash, const char *const keys[], int count)
+{
+	UINT32 seed = 0x9E3779B9;
+	UINT8 bits;
+	int i, tries;
+
+	for (bits = 4; (1 << bits) < count * 8; bits++)
+		;
+
+	// Pointers are random enough that a few hundred odd multipliers find a
+	// perfect hash quickly; give up and use the table if they don't.
+	for (; bits <= 14; bits++)
+	{
+		hash->slots = Z_Realloc(hash->slots, sizeof (fieldslot_t) << bits, PU_STATIC, NULL);
+
+		for (tries = 0; tries < 256; tries++, seed = seed * 1664525 + 1013904223)
+		{
+			memset(hash->slots, 0, sizeof (fieldslot_t) << bits);
+			seed |= 1;
+
+			for (i = 0; i < count; i++)
+			{
+				fieldslot_t *slot = &hash->slots[FieldHash(keys[i], seed, bits)];
+				if (slot->key)
+					break;
+				slot->key = keys[i];
+				slot->value = i;
+			}
+
+			if (i == count)
+			{
+				hash->seed = seed;
+				hash->bits = bits;
+				return;
+			}
+		}
+	}
+
+	Z_Free(hash->slots);
+	hash->slots = NULL;
+}
+
+static void LUA_FreeFieldHashes(void)
+{
+	fieldhash_t *hashes = fieldhashes;
+	int i;
+
+	fieldhashes = NULL;
+	for (i = 0; i < numfieldhashes; i++)
+		if (hashes[i].slots)
+			Z_Free(hashes[i].slots);
+	numfieldhashes = 0;
+
+	if (hashes)
+		Z_Free(hashes);
+}
+
 int Lua_optoption(lua_State *L, int narg, int def, int list_ref)
 {
+	const char *name;
+
 	if (lua_isnoneornil(L, narg))
 		return def;
 
+	name = luaL_checkstring(L, narg);
+
+	if (list_ref >= 0 && list_ref < numfieldhashes && fieldhashes[list_ref].slots)
+	{
+		const fieldhash_t *hash = &fieldhashes[list_ref];
+		const fieldslot_t *slot = &hash->slots[FieldHash(name, hash->seed, hash->bits)];
+		return slot->key == name ? slot->value : -1;
+	}
+
 	I_Assert(lua_checkstack(L, 2));
-	luaL_checkstring(L, narg);
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, list_ref);
 	I_Assert(lua_istable(L, -1));
@@ -1785,17 +2791,34 @@ int Lua_optoption(lua_State *L, int narg, int def, int list_ref)
 
 int Lua_CreateFieldTable(lua_State *L, const char *const lst[])
 {
-	int i;
+	const char **keys;
+	int i, ref;
+
+	for (i = 0; lst[i] != NULL; i++)
+		;
+	keys = Z_Malloc(max(i, 1) * sizeof (*keys), PU_STATIC, NULL);
 
 	lua_newtable(L);
 	for (i = 0; lst[i] != NULL; i++)
 	{
 		lua_pushstring(L, lst[i]);
+		keys[i] = lua_tostring(L, -1); // the interned copy, kept alive by the table
 		lua_pushinteger(L, i);
 		lua_settable(L, -3);
 	}
 
-	return luaL_ref(L, LUA_REGISTRYINDEX);
+	ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	if (ref >= numfieldhashes)
+	{
+		fieldhashes = Z_Realloc(fieldhashes, (ref + 1) * sizeof (*fieldhashes), PU_STATIC, NULL);
+		memset(&fieldhashes[numfieldhashes], 0, (ref + 1 - numfieldhashes) * sizeof (*fieldhashes));
+		numfieldhashes = ref + 1;
+	}
+	BuildFieldHash(&fieldhashes[ref], keys, i);
+
+	Z_Free(keys);
+	return ref;
 }
 
 void LUA_PushTaggableObjectArray
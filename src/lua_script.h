@@ -18,6 +18,7 @@
 #include "d_player.h"
 #include "g_state.h"
 #include "taglist.h"
+#include "command.h"
 
 #include "blua/lua.h"
 #include "blua/lualib.h"
@@ -41,6 +42,9 @@
 void LUA_ClearExtVars(void);
 #endif
 
+extern consvar_t cv_luagcbudget;
+extern consvar_t cv_luacache;
+
 extern INT32 lua_lumploading; // is LUA_LoadLump being called?
 
 int LUA_GetErrorMessage(lua_State *L);
@@ -49,10 +53,12 @@ void LUA_LoadLump(UINT16 wad, UINT16 lump, boolean noresults);
 #ifdef LUA_ALLOW_BYTECODE
 void LUA_DumpFile(const char *filename);
 #endif
+void LUA_AllocBenchmark(void);
 fixed_t LUA_EvalMath(const char *word);
-void LUA_Step(void);
+void LUA_Step(precise_t idle);
 void LUA_Archive(void);
 void LUA_UnArchive(void);
+void LUA_ArchiveSizes(void);
 int LUA_PushGlobals(lua_State *L, const char *word);
 int LUA_CheckGlobals(lua_State *L, const char *word);
 void Got_Luacmd(UINT8 **cp, INT32 playernum); // lua_consolelib.c
@@ -95,6 +101,7 @@ void LUA_InvalidateUserdata(void *data);
 void LUA_InvalidateLevel(void);
 void LUA_InvalidateMapthings(void);
 void LUA_InvalidatePlayer(player_t *player);
+void LUA_PushBenchmark(void);
 
 // Console wrapper
 void COM_Lua_f(void);
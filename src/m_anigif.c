@@ -22,6 +22,10 @@
 #include "m_misc.h"
 #include "st_stuff.h" // st_palette
 
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
+
 #ifdef HWRENDER
 #include "hardware/hw_main.h"
 #endif
@@ -48,22 +52,21 @@ static UINT8 gif_dynamicdelay = (UINT8)0; // and messing something up
 // Palette handling
 static boolean gif_localcolortable = false;
 static boolean gif_colorprofile = false;
+static RGBA_t gif_headerpalettebuf[256];
 static RGBA_t *gif_headerpalette = NULL;
 static RGBA_t *gif_framepalette = NULL;
 
-typedef struct
-{
-	void *pixels;
-	size_t size;
-	boolean owns_pixels;
-} gif_screen_t;
-static gif_screen_t gif_screens[2];
+// Frames are handed in by the movie queue and may be encoded on another
+// thread, so the encoder keeps its own copies instead of using screens[].
+static UINT8 *gif_prevscreen = NULL; // last encoded frame, for GIF_optimizeregion
+static UINT8 *gif_convscreen = NULL; // paletted conversion of an RGB frame
+static size_t gif_screensize = 0;
 
 static FILE *gif_out = NULL;
 static INT32 gif_frames = 0;
+static boolean gif_outofmemory = false; // gif_out was ended early, see GIF_endearly
 static precise_t gif_prevframetime = 0;
 static UINT32 gif_delayus = 0; // "us" is microseconds
-static UINT8 gif_writeover = 0;
 
 
 
@@ -197,126 +200,126 @@ static void GIF_optimizeregion(const UINT8 *dst, const UINT8 *src,
 
 
 
-// GIF Bit WRiter
-// ---
-static UINT8 *gifbwr_buf = NULL;
-static UINT8 *gifbwr_cur;
-static UINT8 gifbwr_bufsize = 0;
-
-static UINT32 gifbwr_bits_buf = 0;
-static INT32 gifbwr_bits_num = 0;
-static UINT8 gifbwr_bits_min = 9;
-
-//
-// GIF_bwr_flush
-// flushes any bits remaining in the buffer.
-//
-static void GIF_bwrflush(void)
-{
-	if (gifbwr_bits_num > 0) // will be between 1 and 7
-	{
-		WRITEUINT8(gifbwr_cur, (UINT8)(gifbwr_bits_buf&0xFF));
-		++gifbwr_bufsize;
-	}
-	gifbwr_bits_buf = gifbwr_bits_num = 0;
-}
-
-//
-// GIF_bwr_write
-// writes bits into bit buffer,
-// writes into buffer when whole bytes obtained
-//
-static void GIF_bwrwrite(UINT32 idata)
-{
-	gifbwr_bits_buf |= (idata << gifbwr_bits_num);
-	gifbwr_bits_num += gifbwr_bits_min;
-	while (gifbwr_bits_num >= 8)
-	{
-		WRITEUINT8(gifbwr_cur, (UINT8)(gifbwr_bits_buf&0xFF));
-		gifbwr_bits_buf >>= 8;
-		gifbwr_bits_num -= 8;
-		++gifbwr_bufsize;
-	}
-}
-
-
-
 // SCReen BUFfer (obviously)
 // ---
-static UINT8 *scrbuf_pos;
-static UINT8 *scrbuf_linebegin;
-static UINT8 *scrbuf_lineend;
-static UINT8 *scrbuf_writeend;
 static INT16 scrbuf_downscaleamt = 1;
 
 
 
 // GIF LZW algorithm
 // ---
+// A frame is split into horizontal bands that are each packed with a fresh
+// code table, so they can be encoded on separate threads. Every band but
+// the last ends with a table clear instead of the data end code, so the
+// packed bands can be joined bit for bit into a single image.
 #define GIFLZW_TABLECLR  0x100
 #define GIFLZW_DATAEND   0x101
 #define GIFLZW_DICTSTART 0x102
 #define GIFLZW_MAXCODE 4096
+#define GIFLZW_HASHSIZE 16384 // at most 4096 codes, so never more than 1/4 full
+
+typedef struct
+{
+	// band to pack, in full resolution pixels
+	const UINT8 *screen;
+	INT32 x, y, w, h;
+	boolean first, last;
+
+	// packed codes
+	UINT8 *data;
+	size_t size, capacity; // whole bytes written, bytes allocated
+	boolean outofmemory; // data couldn't grow, the band is incomplete
+	UINT32 bits_buf;
+	INT32 bits_num; // bits left in bits_buf after the band is done
+	UINT8 bits_min;
+
+	UINT16 workingCode;
+	UINT16 nextCodeToAssign;
+	UINT32 hashTable[GIFLZW_HASHSIZE];
+} giflzw_t;
 
-static UINT16 giflzw_workingCode;
-static UINT16 giflzw_nextCodeToAssign;
-static UINT32 *giflzw_hashTable = NULL; // 16384 required
+static giflzw_t *gif_lzwbands = NULL;
+static INT32 gif_numlzwbands = 0;
 
 //
-// GIF_prepareLZW
-// prepatres the LZW hash table for use
+// GIF_bwrwrite
+// writes bits into the band's bit buffer,
+// writes into the band's data when whole bytes are obtained
 //
-static void GIF_prepareLZW(void)
+static void GIF_bwrwrite(giflzw_t *lzw, UINT32 idata)
 {
-	gifbwr_bits_min = 9;
-	giflzw_nextCodeToAssign = GIFLZW_DICTSTART;
+	lzw->bits_buf |= (idata << lzw->bits_num);
+	lzw->bits_num += lzw->bits_min;
+	while (lzw->bits_num >= 8)
+	{
+		if (lzw->size == lzw->capacity && !lzw->outofmemory)
+		{
+			size_t capacity = max(lzw->capacity * 2, 4096);
+			UINT8 *data = realloc(lzw->data, capacity);
 
-	if (!giflzw_hashTable)
-		giflzw_hashTable = Z_Malloc(16384*sizeof(UINT32), PU_STATIC, NULL);
-	memset(giflzw_hashTable, 0, 16384*sizeof(UINT32));
+			if (data)
+			{
+				lzw->data = data;
+				lzw->capacity = capacity;
+			}
+			else
+				lzw->outofmemory = true; // GIF_framewrite stops recording
+		}
+		if (!lzw->outofmemory)
+			lzw->data[lzw->size++] = (UINT8)(lzw->bits_buf & 0xFF);
+		lzw->bits_buf >>= 8;
+		lzw->bits_num -= 8;
+	}
 }
 
+//
+// GIF_prepareLZW
+// prepares the LZW hash table for use
+//
+static void GIF_prepareLZW(giflzw_t *lzw)
+{
+	lzw->bits_min = 9;
+	lzw->nextCodeToAssign = GIFLZW_DICTSTART;
+	memset(lzw->hashTable, 0, sizeof(lzw->hashTable));
+}
+
+// Fibonacci hashing spreads the 20-bit prefix/byte keys across the table
+#define GIF_hashKey(key) ((UINT32)((key) * 2654435761u) >> (32 - 14))
+
 //
 // GIF_searchHash
 // searches the LZW hash table for a match
 //
-static char GIF_searchHash(UINT32 key, UINT32 *pOutput)
+static boolean GIF_searchHash(giflzw_t *lzw, UINT32 key, UINT32 *pOutput)
 {
-	UINT32 entry, position = (key >> 6) & 0x3FFF;
+	UINT32 entry, position = GIF_hashKey(key);
 
-	while (giflzw_hashTable[position] != 0)
+	while ((entry = lzw->hashTable[position]) != 0)
 	{
-		entry = giflzw_hashTable[position];
 		if ((entry >> 12) == key)
 		{
 			*pOutput = (entry & 0xFFF);
-			return 1;
+			return true;
 		}
 
-		position = (position + 1) & 0x3FFF;
+		position = (position + 1) & (GIFLZW_HASHSIZE - 1);
 	}
 
-	return 0;
+	return false;
 }
 
 //
 // GIF_addHash
 // stores a hash in the hash table
 //
-static void GIF_addHash(UINT32 key, UINT32 value)
+static void GIF_addHash(giflzw_t *lzw, UINT32 key, UINT32 value)
 {
-	UINT32 position = (key >> 6) & 0x3FFF;
+	UINT32 position = GIF_hashKey(key);
 
-	for (;;)
-	{
-		if (giflzw_hashTable[position] == 0)
-		{
-			giflzw_hashTable[position] = (key << 12) | (value & 0xFFF);
-			return;
-		}
+	while (lzw->hashTable[position] != 0)
+		position = (position + 1) & (GIFLZW_HASHSIZE - 1);
 
-		position = (position + 1) & 0x3FFF;
-	}
+	lzw->hashTable[position] = (key << 12) | (value & 0xFFF);
 }
 
 //
@@ -324,90 +327,159 @@ static void GIF_addHash(UINT32 key, UINT32 value)
 // feeds bytes into the working code,
 // and to the hash table or output from there.
 //
-static void GIF_feedByte(UINT8 pbyte)
+static void GIF_feedByte(giflzw_t *lzw, UINT8 pbyte)
 {
 	UINT32 key, hashOutput = 0;
 
 	// Prepare a code with this byte if we have none
-	if (giflzw_workingCode == UINT16_MAX)
+	if (lzw->workingCode == UINT16_MAX)
 	{
-		giflzw_workingCode = pbyte;
+		lzw->workingCode = pbyte;
 		return;
 	}
 
 	// If we're here, this means we have a code in progress
 	// Is this string already in the dictionary?
-	key = (giflzw_workingCode << 8) | pbyte;
+	key = (lzw->workingCode << 8) | pbyte;
 
-	if (0 == GIF_searchHash(key, &hashOutput))
+	if (!GIF_searchHash(lzw, key, &hashOutput))
 	{
 		// It wasn't found.
 		// That means we can output what we already had, and
 		// create a new dictionary entry containing that
 		// plus our new byte.
-		if (giflzw_nextCodeToAssign > (1 << gifbwr_bits_min))
-			++gifbwr_bits_min; // out of room, extend minbits
+		if (lzw->nextCodeToAssign > (1 << lzw->bits_min))
+			++lzw->bits_min; // out of room, extend minbits
 
-		GIF_bwrwrite(giflzw_workingCode);
-		GIF_addHash(key, giflzw_nextCodeToAssign);
-		++giflzw_nextCodeToAssign;
+		GIF_bwrwrite(lzw, lzw->workingCode);
+		GIF_addHash(lzw, key, lzw->nextCodeToAssign);
+		++lzw->nextCodeToAssign;
 
 		// Seed the working code with this byte, for the next
 		// round
-		giflzw_workingCode = pbyte;
+		lzw->workingCode = pbyte;
 		return;
 	}
 
 	// This string is in there, so update our working code!
-	giflzw_workingCode = hashOutput;
+	lzw->workingCode = hashOutput;
 }
 
 //
 // GIF_lzw
-// polls the hashtable, does writing, etc
+// packs one band of the frame.
+// safe to run on several bands at once.
 //
-static void GIF_lzw(void)
+static void GIF_lzw(void *userdata, size_t index)
 {
-	while (scrbuf_pos <= scrbuf_writeend)
+	giflzw_t *lzw = &((giflzw_t *)userdata)[index];
+	const INT32 step = scrbuf_downscaleamt;
+	INT32 row;
+
+	lzw->size = 0;
+	lzw->outofmemory = false;
+	lzw->bits_buf = 0;
+	lzw->bits_num = 0;
+	lzw->workingCode = UINT16_MAX;
+	GIF_prepareLZW(lzw);
+
+	//prewrite a table clear
+	if (lzw->first)
+		GIF_bwrwrite(lzw, GIFLZW_TABLECLR);
+
+	for (row = lzw->y; row < lzw->y + lzw->h; row += step)
 	{
-		GIF_feedByte(*scrbuf_pos);
-		if (giflzw_nextCodeToAssign >= GIFLZW_MAXCODE)
-		{
-			GIF_bwrwrite(GIFLZW_TABLECLR);
-			GIF_prepareLZW();
-		}
-		if ((scrbuf_pos += scrbuf_downscaleamt) >= scrbuf_lineend)
+		const UINT8 *pos = lzw->screen + (row * vid.width) + lzw->x;
+		const UINT8 *lineend = pos + lzw->w;
+
+		for (; pos < lineend; pos += step)
 		{
-			scrbuf_lineend += (vid.width * scrbuf_downscaleamt);
-			scrbuf_linebegin += (vid.width * scrbuf_downscaleamt);
-			scrbuf_pos = scrbuf_linebegin;
+			GIF_feedByte(lzw, *pos);
+			if (lzw->nextCodeToAssign >= GIFLZW_MAXCODE)
+			{
+				GIF_bwrwrite(lzw, GIFLZW_TABLECLR);
+				GIF_prepareLZW(lzw);
+			}
 		}
-		// Just a bit of overflow prevention
-		if (gifbwr_bufsize >= 248)
-			break;
 	}
-	if (scrbuf_pos > scrbuf_writeend)
+
+	// 4.15.14 - I failed to account for the possibility that
+	// these two writes could possibly cause minbits increases.
+	// Luckily, we have a guarantee that the first byte CANNOT exceed
+	// the maximum possible code.  So, we do a minbits check here...
+	if (lzw->nextCodeToAssign++ > (1 << lzw->bits_min))
+		++lzw->bits_min; // out of room, extend minbits
+	GIF_bwrwrite(lzw, lzw->workingCode);
+
+	// And luckily once more, if the data marker somehow IS at
+	// MAXCODE it doesn't matter, because it still marks the
+	// end of the stream and thus no extending will happen!
+	// But still, we need to check minbits again...
+	// Bands that are followed by another one clear the table
+	// instead, so the next band starts with fresh codes.
+	if (lzw->nextCodeToAssign++ > (1 << lzw->bits_min))
+		++lzw->bits_min; // out of room, extend minbits
+	GIF_bwrwrite(lzw, lzw->last ? GIFLZW_DATAEND : GIFLZW_TABLECLR);
+}
+
+//
+// GIF_lzwjoin
+// joins the packed bands bit for bit into image data sub-blocks.
+//
+static UINT8 *GIF_lzwjoin(UINT8 *p, const giflzw_t *bands, INT32 numbands)
+{
+	UINT8 *blocksize = NULL;
+	UINT32 acc = 0;
+	INT32 accbits = 0;
+	INT32 i;
+	size_t b;
+
+#define GIF_joinbyte(byte) \
+	{ \
+		if (!blocksize || *blocksize == 255) \
+		{ \
+			blocksize = p++; \
+			*blocksize = 0; \
+		} \
+		*p++ = (byte); \
+		++*blocksize; \
+	}
+
+	for (i = 0; i < numbands; i++)
 	{
-		// 4.15.14 - I failed to account for the possibility that
-		// these two writes could possibly cause minbits increases.
-		// Luckily, we have a guarantee that the first byte CANNOT exceed
-		// the maximum possible code.  So, we do a minbits check here...
-		if (giflzw_nextCodeToAssign++ > (1 << gifbwr_bits_min))
-			++gifbwr_bits_min; // out of room, extend minbits
-		GIF_bwrwrite(giflzw_workingCode);
-
-		// And luckily once more, if the data marker somehow IS at
-		// MAXCODE it doesn't matter, because it still marks the
-		// end of the stream and thus no extending will happen!
-		// But still, we need to check minbits again...
-		if (giflzw_nextCodeToAssign++ > (1 << gifbwr_bits_min))
-			++gifbwr_bits_min; // out of room, extend minbits
-		GIF_bwrwrite(GIFLZW_DATAEND);
-
-		// Okay, the flush is safe at least.
-		GIF_bwrflush();
-		gif_writeover = 1;
+		const giflzw_t *lzw = &bands[i];
+
+		if (accbits == 0)
+		{
+			for (b = 0; b < lzw->size; b++)
+				GIF_joinbyte(lzw->data[b])
+		}
+		else
+		{
+			for (b = 0; b < lzw->size; b++)
+			{
+				acc |= (UINT32)lzw->data[b] << accbits;
+				GIF_joinbyte((UINT8)(acc & 0xFF))
+				acc >>= 8;
+			}
+		}
+
+		acc |= (lzw->bits_buf & ((1 << lzw->bits_num) - 1)) << accbits;
+		accbits += lzw->bits_num;
+		if (accbits >= 8)
+		{
+			GIF_joinbyte((UINT8)(acc & 0xFF))
+			acc >>= 8;
+			accbits -= 8;
+		}
 	}
+
+	// flush any bits remaining
+	if (accbits > 0)
+		GIF_joinbyte((UINT8)(acc & 0xFF))
+
+#undef GIF_joinbyte
+	return p;
 }
 
 
@@ -536,88 +608,84 @@ static void GIF_rgbconvert(UINT8 *linear, UINT8 *scr)
 }
 #endif
 
+//
+// GIF_endearly
+// ends the file after the last whole frame when a frame can't be packed,
+// so nothing more is recorded. GIF_close reports it and frees the rest.
+//
+static void GIF_endearly(void)
+{
+	fwrite(";", 1, 1, gif_out);
+	fclose(gif_out);
+	gif_out = NULL;
+	gif_outofmemory = true;
+}
+
 //
 // GIF_framewrite
 // writes a frame into the file.
 //
-static void GIF_framewrite(void)
+static void GIF_framewrite(UINT8 *frame, boolean rgb, RGBA_t *palette, precise_t frametime)
 {
 	UINT8 *p;
-	UINT8 *base_screen = gif_screens[0].pixels;
-	UINT8 *movie_screen = gif_screens[1].pixels;
+	UINT8 *movie_screen = frame;
 	INT32 blitx, blity, blitw, blith;
 	boolean palchanged;
 
-	if (!gifframe_data)
-		gifframe_data = Z_Malloc(gifframe_size, PU_STATIC, NULL);
-	p = gifframe_data;
-
 	if (!gif_out)
 		return;
 
+	if (!gifframe_data && !(gifframe_data = malloc(gifframe_size)))
+	{
+		GIF_endearly();
+		return;
+	}
+	p = gifframe_data;
+
 	// Lactozilla: Compare the header's palette with the current frame's palette and see if it changed.
 	if (gif_localcolortable)
 	{
-		gif_framepalette = GIF_getpalette(max(st_palette, 0));
+		gif_framepalette = palette;
 		palchanged = memcmp(gif_headerpalette, gif_framepalette, sizeof(RGBA_t) * 256);
 	}
 	else
 		palchanged = false;
 
+#ifdef HWRENDER
+	// Convert the OpenGL frame into a paletted one
+	if (rgb)
+	{
+		GIF_rgbconvert(frame, gif_convscreen);
+		movie_screen = gif_convscreen;
+	}
+#else
+	(void)rgb;
+#endif
+
 	// Compare image data (for optimizing GIF)
 	// If the palette has changed, the entire frame is considered to be different.
 	if (gif_optimize && gif_frames > 0 && (!palchanged))
-	{
-		// before blit movie_screen points to last frame, cur_screen points to this frame
-		UINT8 *cur_screen = base_screen;
-		GIF_optimizeregion(cur_screen, movie_screen, &blitx, &blity, &blitw, &blith);
-
-		// blit to temp screen
-		if (rendermode == render_soft)
-			I_ReadScreen(movie_screen);
-#ifdef HWRENDER
-		else if (rendermode == render_opengl)
-		{
-			UINT8 *linear = HWR_GetScreenshot();
-			GIF_rgbconvert(linear, movie_screen);
-			free(linear);
-		}
-#endif
-	}
+		GIF_optimizeregion(movie_screen, gif_prevscreen, &blitx, &blity, &blitw, &blith);
 	else
 	{
 		blitx = blity = 0;
 		blitw = vid.width;
 		blith = vid.height;
-
-#ifdef HWRENDER
-		// Copy the current OpenGL frame into the base screen
-		if (rendermode == render_opengl)
-		{
-			UINT8 *linear = HWR_GetScreenshot();
-			GIF_rgbconvert(linear, base_screen);
-			free(linear);
-		}
-#endif
-
-		// Copy the first frame into the movie screen
-		// OpenGL already does the same above.
-		if (gif_frames == 0 && rendermode == render_soft)
-			I_ReadScreen(movie_screen);
-
-		movie_screen = base_screen;
 	}
 
+	// Keep this frame around to compare the next one against
+	if (gif_optimize)
+		M_Memcpy(gif_prevscreen, movie_screen, gif_screensize);
+
 	// screen regions are handled in GIF_lzw
 	{
 		UINT16 delay = 0;
-		INT32 startline;
 
 		if (gif_dynamicdelay ==(UINT8) 2)
 		{
 			// golden's attempt at creating a "dynamic delay"
 			UINT16 mingifdelay = 10; // minimum gif delay in milliseconds (keep at 10 because gifs can't get more precise).
-			gif_delayus += (I_GetPreciseTime() - gif_prevframetime) / (I_GetPrecisePrecision() / 1000000); // increase delay by how much time was spent between last measurement
+			gif_delayus += (frametime - gif_prevframetime) / (I_GetPrecisePrecision() / 1000000); // increase delay by how much time was spent between last measurement
 
 			if (gif_delayus/1000 >= mingifdelay) // delay is big enough to be able to effect gif frame delay?
 			{
@@ -630,7 +698,7 @@ static void GIF_framewrite(void)
 		{
 			float delayf = ceil(100.0f/NEWTICRATE);
 
-			delay = (UINT16)((I_GetPreciseTime() - gif_prevframetime)) / (I_GetPrecisePrecision() / 1000000) /10/1000;
+			delay = (UINT16)((frametime - gif_prevframetime)) / (I_GetPrecisePrecision() / 1000000) /10/1000;
 
 			if (delay < (UINT16)(delayf))
 				delay = (UINT16)(delayf);
@@ -678,49 +746,85 @@ static void GIF_framewrite(void)
 				WRITEUINT8(p, 0); // They are equal, no Local Color Table needed.
 		}
 
-		scrbuf_pos = movie_screen + blitx + (blity * vid.width);
-		scrbuf_writeend = scrbuf_pos + (blitw - 1) + ((blith - 1) * vid.width);
+		{
+			const INT32 rows = blith / scrbuf_downscaleamt;
+			INT32 numbands = M_EncodeBands((size_t)(blitw / scrbuf_downscaleamt) * rows);
+			size_t packed = 0;
+			INT32 i;
 
-		if (!gifbwr_buf)
-			gifbwr_buf = Z_Malloc(256, PU_STATIC, NULL);
-		gifbwr_cur = gifbwr_buf;
+			numbands = max(1, min(numbands, rows));
 
-		GIF_prepareLZW();
-		giflzw_workingCode = UINT16_MAX;
-		WRITEUINT8(p, gifbwr_bits_min - 1);
+			if (numbands > gif_numlzwbands)
+			{
+				giflzw_t *bands = realloc(gif_lzwbands, numbands * sizeof (giflzw_t));
+
+				if (!bands)
+				{
+					GIF_endearly();
+					return;
+				}
+				gif_lzwbands = bands;
+				memset(&gif_lzwbands[gif_numlzwbands], 0, (numbands - gif_numlzwbands) * sizeof (giflzw_t));
+				gif_numlzwbands = numbands;
+			}
 
-		startline = (scrbuf_pos - movie_screen) / vid.width;
-		scrbuf_linebegin = movie_screen + (startline * vid.width) + blitx;
-		scrbuf_lineend = scrbuf_linebegin + blitw;
+			for (i = 0; i < numbands; i++)
+			{
+				giflzw_t *lzw = &gif_lzwbands[i];
+				lzw->screen = movie_screen;
+				lzw->x = blitx;
+				lzw->w = blitw;
+				lzw->y = blity + (rows * i / numbands) * scrbuf_downscaleamt;
+				lzw->h = blity + (rows * (i + 1) / numbands) * scrbuf_downscaleamt - lzw->y;
+				lzw->first = (i == 0);
+				lzw->last = (i == numbands - 1);
+			}
 
-		//prewrite a table clear
-		GIF_bwrwrite(GIFLZW_TABLECLR);
+#ifdef HAVE_THREADS
+			if (numbands > 1)
+				I_parallel_jobs(numbands, GIF_lzw, gif_lzwbands);
+			else
+#endif
+				GIF_lzw(gif_lzwbands, 0);
 
-		gif_writeover = 0;
-		while (!gif_writeover)
-		{
-			GIF_lzw(); // main lzw packing loop
+			for (i = 0; i < numbands; i++)
+			{
+				if (gif_lzwbands[i].outofmemory)
+				{
+					GIF_endearly();
+					return;
+				}
+				packed += gif_lzwbands[i].size + 1;
+			}
 
-			if ((size_t)(p - gifframe_data) + gifbwr_bufsize + 1 >= gifframe_size)
+			// code size, sub-block lengths and the terminator
+			packed += 1 + (packed / 255) + 2;
+			if ((size_t)(p - gifframe_data) + packed >= gifframe_size)
 			{
 				INT32 temppos = p - gifframe_data;
-				gifframe_data = Z_Realloc(gifframe_data, (gifframe_size *= 2), PU_STATIC, NULL);
+				size_t size = gifframe_size;
+				UINT8 *data;
+
+				while (temppos + packed >= size)
+					size *= 2;
+				if (!(data = realloc(gifframe_data, size)))
+				{
+					GIF_endearly();
+					return;
+				}
+				gifframe_data = data;
+				gifframe_size = size;
 				p = gifframe_data + temppos; // realloc moves gifframe_data, so p is now invalid
 			}
 
-			// reset after writing to read
-			gifbwr_cur = gifbwr_buf;
-			WRITEUINT8(p, gifbwr_bufsize);
-			WRITEMEM(p, gifbwr_cur, gifbwr_bufsize);
-
-			gifbwr_bufsize = 0;
-			gifbwr_cur = gifbwr_buf;
+			WRITEUINT8(p, 8); // LZW minimum code size
+			p = GIF_lzwjoin(p, gif_lzwbands, numbands);
 		}
 		WRITEUINT8(p, 0); //terminator
 	}
 	fwrite(gifframe_data, 1, (p - gifframe_data), gif_out);
 	++gif_frames;
-	gif_prevframetime = I_GetPreciseTime();
+	gif_prevframetime = frametime;
 }
 
 
@@ -744,7 +848,9 @@ INT32 GIF_open(const char *filename)
 	gif_dynamicdelay = (UINT8)cv_gif_dynamicdelay.value;
 	gif_localcolortable = (!!cv_gif_localcolortable.value);
 	gif_colorprofile = (!!cv_screenshot_colorprofile.value);
-	gif_headerpalette = GIF_getpalette(0);
+	// Palettes can be reallocated while recording, so keep a copy
+	M_Memcpy(gif_headerpalettebuf, GIF_getpalette(0), sizeof(gif_headerpalettebuf));
+	gif_headerpalette = gif_headerpalettebuf;
 
 	GIF_headwrite();
 	gif_frames = 0;
@@ -756,65 +862,45 @@ INT32 GIF_open(const char *filename)
 
 static void GIF_checkscreens(void)
 {
-	for (size_t i = 0; i < sizeof(gif_screens) / sizeof(gif_screens[0]); i++)
-	{
-		if (rendermode == render_soft)
-		{
-			if (gif_screens[i].owns_pixels)
-			{
-				Z_Free(gif_screens[i].pixels);
-				gif_screens[i].owns_pixels = false;
-			}
+	size_t sz = vid.width * vid.height;
 
-			gif_screens[i].size = 0;
-
-			if (i == 1)
-				gif_screens[i].pixels = screens[2];
-			else
-				gif_screens[i].pixels = screens[0];
-		}
-		else
-		{
-			size_t sz = vid.width * vid.height * vid.bpp;
+	if (gif_screensize == sz)
+		return;
 
-			if (!gif_screens[i].owns_pixels)
-			{
-				gif_screens[i].size = sz;
-				gif_screens[i].pixels = Z_Malloc(gif_screens[i].size, PU_STATIC, NULL);
-				gif_screens[i].owns_pixels = true;
-			}
-			else if (gif_screens[i].size != sz)
-			{
-				gif_screens[i].size = sz;
-				gif_screens[i].pixels = Z_Realloc(gif_screens[i].pixels, gif_screens[i].size, PU_STATIC, NULL);
-			}
-		}
-	}
+	free(gif_prevscreen);
+	free(gif_convscreen);
+	gif_screensize = sz;
+	gif_prevscreen = calloc(1, sz);
+	gif_convscreen = calloc(1, sz);
 }
 
 static void GIF_freescreens(void)
 {
-	for (size_t i = 0; i < sizeof(gif_screens) / sizeof(gif_screens[0]); i++)
-	{
-		if (gif_screens[i].owns_pixels)
-		{
-			Z_Free(gif_screens[i].pixels);
-			gif_screens[i].owns_pixels = false;
-		}
+	free(gif_prevscreen);
+	free(gif_convscreen);
+	gif_prevscreen = gif_convscreen = NULL;
+	gif_screensize = 0;
+}
 
-		gif_screens[i].size = 0;
-		gif_screens[i].pixels = NULL;
-	}
+//
+// GIF_getframepalette
+// returns the palette the current frame should be encoded with.
+//
+RGBA_t *GIF_getframepalette(void)
+{
+	return GIF_getpalette(max(st_palette, 0));
 }
 
 //
 // GIF_frame
-// writes a frame into the output gif
+// writes a frame into the output gif.
+// the frame is paletted, or RGB if captured from OpenGL.
+// safe to call from the movie encoder thread.
 //
-void GIF_frame(void)
+void GIF_frame(UINT8 *frame, boolean rgb, RGBA_t *palette, precise_t frametime)
 {
 	GIF_checkscreens();
-	GIF_framewrite();
+	GIF_framewrite(frame, rgb, palette, frametime);
 }
 
 //
@@ -823,29 +909,33 @@ void GIF_frame(void)
 //
 INT32 GIF_close(void)
 {
-	if (!gif_out)
+	if (!gif_out && !gif_outofmemory)
 		return 0;
 
-	// final terminator.
-	fwrite(";", 1, 1, gif_out);
-	fclose(gif_out);
-	gif_out = NULL;
-
-	if (gifbwr_buf)
-		Z_Free(gifbwr_buf);
-	gifbwr_buf = gifbwr_cur = NULL;
+	if (gif_out)
+	{
+		// final terminator.
+		fwrite(";", 1, 1, gif_out);
+		fclose(gif_out);
+		gif_out = NULL;
+	}
 
-	if (gifframe_data)
-		Z_Free(gifframe_data);
+	free(gifframe_data);
 	gifframe_data = NULL;
 
-	if (giflzw_hashTable)
-		Z_Free(giflzw_hashTable);
-	giflzw_hashTable = NULL;
+	for (INT32 i = 0; i < gif_numlzwbands; i++)
+		free(gif_lzwbands[i].data);
+	free(gif_lzwbands);
+	gif_lzwbands = NULL;
+	gif_numlzwbands = 0;
 
 	GIF_freescreens();
 
-	CONS_Printf(M_GetText("Animated gif closed; wrote %d frames\n"), gif_frames);
+	if (gif_outofmemory)
+		CONS_Alert(CONS_WARNING, M_GetText("Ran out of memory while recording; the animated gif stops after %d frames\n"), gif_frames);
+	else
+		CONS_Printf(M_GetText("Animated gif closed; wrote %d frames\n"), gif_frames);
+	gif_outofmemory = false;
 	return 1;
 }
 #endif //ifdef HAVE_ANIGIF
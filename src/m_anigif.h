@@ -23,7 +23,8 @@
 
 #ifdef HAVE_ANIGIF
 INT32 GIF_open(const char *filename);
-void GIF_frame(void);
+RGBA_t *GIF_getframepalette(void);
+void GIF_frame(UINT8 *frame, boolean rgb, RGBA_t *palette, precise_t frametime);
 INT32 GIF_close(void);
 #endif
 
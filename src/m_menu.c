@@ -9014,6 +9014,9 @@ static void M_DrawAddons(void)
 	UINT8 hilicol;
 	boolean ontouchscreen = M_TouchInput();
 
+	if (filemenuupdated()) // an addons_md5 hash came in
+		refreshdirmenu |= REFRESHDIR_NORMAL;
+
 	// hack - need to refresh at end of frame to handle addfile...
 	if (refreshdirmenu & M_AddonsRefresh())
 	{
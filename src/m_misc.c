@@ -45,6 +45,10 @@
 
 #include "m_anigif.h"
 
+#ifdef HAVE_THREADS
+#include "i_threads.h"
+#endif
+
 // So that the screenshot menu auto-updates...
 #include "m_menu.h"
 
@@ -112,6 +116,9 @@ consvar_t cv_moviemode = CVAR_INIT ("moviemode_mode", "GIF", CV_SAVE|CV_CALL, mo
 consvar_t cv_movie_option = CVAR_INIT ("movie_option", "Default", CV_SAVE|CV_CALL, screenshot_cons_t, Moviemode_option_Onchange);
 consvar_t cv_movie_folder = CVAR_INIT ("movie_folder", "", CV_SAVE, NULL, NULL);
 
+static CV_PossibleValue_t movie_overflow_cons_t[] = {{0, "Drop"}, {1, "Wait"}, {0, NULL}};
+consvar_t cv_movie_overflow = CVAR_INIT ("movie_overflow", "Drop", CV_SAVE, movie_overflow_cons_t, NULL);
+
 static CV_PossibleValue_t zlib_mem_level_t[] = {
 	{1, "(Min Memory) 1"},
 	{2, "2"}, {3, "3"}, {4, "4"}, {5, "5"}, {6, "6"}, {7, "7"},
@@ -164,14 +171,34 @@ consvar_t cv_zlib_window_bitsa = CVAR_INIT ("apng_window_size", "32k", CV_SAVE,
 consvar_t cv_apng_delay = CVAR_INIT ("apng_speed", "1x", CV_SAVE, apng_delay_t, NULL);
 consvar_t cv_apng_downscale = CVAR_INIT ("apng_downscale", "On", CV_SAVE, CV_OnOff, NULL);
 
+static CV_PossibleValue_t encode_threads_cons_t[] = {{1, "MIN"}, {16, "MAX"}, {0, "Auto"}, {0, NULL}};
+consvar_t cv_encode_threads = CVAR_INIT ("encode_threads", "Auto", CV_SAVE, encode_threads_cons_t, NULL);
+
 #ifdef USE_APNG
 static boolean apng_downscale = false; // So nobody can do something dumb like changing cvars mid output
+static png_uint_16 apng_delay = 1;
 #endif
 
 boolean takescreenshot = false; // Take a screenshot this tic
 
 moviemode_t moviemode = MM_OFF;
 
+/** Returns how many bands an image should be split into so they can be
+  * compressed in parallel. Small images are not worth splitting.
+  *
+  * \param pixels Number of pixels to compress.
+  */
+INT32 M_EncodeBands(size_t pixels)
+{
+#ifdef HAVE_THREADS
+	INT32 bands = cv_encode_threads.value ? cv_encode_threads.value : I_job_threads();
+	return max(1, min(bands, (INT32)(pixels / (64*1024))));
+#else
+	(void)pixels;
+	return 1;
+#endif
+}
+
 /** Returns the map number for a map identified by the last two characters in
   * its name.
   *
@@ -937,6 +964,202 @@ static inline void M_PNGImage(png_structp png_ptr, png_infop png_info_ptr, PNG_C
 	png_free(png_ptr, (png_voidp)row_pointers);
 }
 
+#ifdef HAVE_THREADS
+// Parallel IDAT compression
+// Rows are filtered and deflated in bands on separate threads. Every band
+// but the last ends on a full flush, so the raw deflate streams can be
+// concatenated into one zlib stream, with the Adler-32 sums combined.
+typedef struct
+{
+	png_bytep out;
+	size_t size;
+	uLong adler, length;
+	boolean ok;
+} pngband_t;
+
+typedef struct
+{
+	png_bytep image;
+	png_uint_32 pitch, height;
+	png_byte filter;
+	int level, memlevel, strategy, windowbits;
+	INT32 numbands;
+	pngband_t *bands;
+} pngdeflate_t;
+
+static void M_PNGDeflateBand(void *userdata, size_t index)
+{
+	pngdeflate_t *job = userdata;
+	pngband_t *band = &job->bands[index];
+	const png_uint_32 y0 = (png_uint_32)((UINT64)job->height * index / job->numbands);
+	const png_uint_32 y1 = (png_uint_32)((UINT64)job->height * (index + 1) / job->numbands);
+	const boolean last = (index == (size_t)job->numbands - 1);
+	png_bytep row = malloc(job->pitch + 1);
+	size_t capacity;
+	png_uint_32 x, y;
+	z_stream zs;
+	int ret = Z_OK;
+
+	band->ok = false;
+	band->out = NULL;
+
+	memset(&zs, 0, sizeof (zs));
+	if (!row || deflateInit2(&zs, job->level, Z_DEFLATED, -job->windowbits, job->memlevel, job->strategy) != Z_OK)
+	{
+		free(row);
+		return;
+	}
+
+	capacity = deflateBound(&zs, (uLong)(job->pitch + 1) * (y1 - y0)) + 64;
+	band->out = malloc(capacity);
+	band->adler = adler32(0L, Z_NULL, 0);
+	band->length = 0;
+
+	zs.next_out = band->out;
+	zs.avail_out = (uInt)capacity;
+
+	for (y = y0; y < y1 && band->out; y++)
+	{
+		const png_bytep cur = job->image + (size_t)y * job->pitch;
+		const int flush = (y == y1 - 1) ? (last ? Z_FINISH : Z_FULL_FLUSH) : Z_NO_FLUSH;
+
+		// The Up filter only looks at the previous raw row,
+		// so it works across band boundaries.
+		row[0] = job->filter;
+		if (job->filter == PNG_FILTER_VALUE_UP && y > 0)
+		{
+			const png_bytep prev = cur - job->pitch;
+			for (x = 0; x < job->pitch; x++)
+				row[x+1] = (png_byte)(cur[x] - prev[x]);
+		}
+		else
+			M_Memcpy(row + 1, cur, job->pitch);
+
+		band->adler = adler32(band->adler, row, job->pitch + 1);
+		band->length += job->pitch + 1;
+
+		zs.next_in = row;
+		zs.avail_in = job->pitch + 1;
+
+		for (;;)
+		{
+			if (zs.avail_out == 0)
+			{
+				const size_t used = capacity - zs.avail_out;
+				png_bytep grown = realloc(band->out, capacity *= 2);
+				if (!grown)
+				{
+					free(band->out);
+					band->out = NULL;
+					break;
+				}
+				band->out = grown;
+				zs.next_out = band->out + used;
+				zs.avail_out = (uInt)(capacity - used);
+			}
+
+			ret = deflate(&zs, flush);
+
+			if (ret == Z_STREAM_ERROR)
+				break;
+			if (flush == Z_FINISH ? (ret == Z_STREAM_END) : (zs.avail_in == 0 && zs.avail_out != 0))
+				break;
+		}
+
+		if (ret == Z_STREAM_ERROR)
+			break;
+	}
+
+	band->size = zs.total_out;
+	band->ok = (band->out && y == y1 && ret != Z_STREAM_ERROR);
+
+	deflateEnd(&zs);
+	free(row);
+}
+
+/** Compresses the image into a single IDAT chunk using several threads
+  * and finishes the file with IEND. Returns false without writing
+  * anything if the image is too small to split or compression failed,
+  * in which case it should be written the usual way.
+  */
+static boolean M_PNGParallelImage(png_structp png_ptr, png_infop png_info_ptr, png_uint_32 height, png_bytep png_buf,
+	boolean paletted, int level, int memlevel, int strategy, int windowbits)
+{
+	png_byte png_IDAT[5] = { 73, 68, 65, 84, '\0'};
+	png_byte png_IEND[5] = { 73, 69, 78, 68, '\0'};
+	png_uint_32 pitch = png_get_rowbytes(png_ptr, png_info_ptr);
+	pngdeflate_t job;
+	png_bytep idat, p;
+	size_t total = 2 + 4;
+	uLong adler;
+	UINT8 cmf, flg;
+	INT32 i;
+	boolean ok = true;
+
+	job.numbands = min(M_EncodeBands((size_t)pitch * height), (INT32)height);
+	if (job.numbands < 2)
+		return false;
+
+	job.image = png_buf;
+	job.pitch = pitch;
+	job.height = height;
+	// Same choices libpng makes: no filtering for paletted images
+	job.filter = paletted ? PNG_FILTER_VALUE_NONE : PNG_FILTER_VALUE_UP;
+	job.level = level;
+	job.memlevel = memlevel;
+	job.strategy = paletted ? strategy : Z_FILTERED;
+	job.windowbits = max(windowbits, 9); // zlib doesn't do raw deflate with 256 byte windows
+	job.bands = calloc(job.numbands, sizeof (pngband_t));
+	if (!job.bands)
+		return false;
+
+	I_parallel_jobs(job.numbands, M_PNGDeflateBand, &job);
+
+	for (i = 0; i < job.numbands; i++)
+	{
+		ok = ok && job.bands[i].ok;
+		total += job.bands[i].size;
+	}
+
+	idat = ok ? malloc(total) : NULL;
+	if (idat)
+	{
+		// zlib header
+		cmf = (UINT8)(((job.windowbits - 8) << 4) | Z_DEFLATED);
+		flg = (UINT8)((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+		flg += 31 - ((cmf << 8) | flg) % 31;
+
+		p = idat;
+		*p++ = cmf;
+		*p++ = flg;
+
+		adler = job.bands[0].adler;
+		for (i = 0; i < job.numbands; i++)
+		{
+			M_Memcpy(p, job.bands[i].out, job.bands[i].size);
+			p += job.bands[i].size;
+			if (i > 0)
+				adler = adler32_combine(adler, job.bands[i].adler, job.bands[i].length);
+		}
+
+		*p++ = (png_byte)((adler >> 24) & 0xFF);
+		*p++ = (png_byte)((adler >> 16) & 0xFF);
+		*p++ = (png_byte)((adler >> 8) & 0xFF);
+		*p++ = (png_byte)(adler & 0xFF);
+
+		png_write_chunk(png_ptr, png_IDAT, idat, total);
+		png_write_chunk(png_ptr, png_IEND, NULL, 0);
+		free(idat);
+	}
+
+	for (i = 0; i < job.numbands; i++)
+		free(job.bands[i].out);
+	free(job.bands);
+
+	return (idat != NULL);
+}
+#endif
+
 #ifdef USE_APNG
 static png_structp apng_ptr = NULL;
 static png_infop   apng_info_ptr = NULL;
@@ -1047,7 +1270,7 @@ static void M_PNGFrame(png_structp png_ptr, png_infop png_info_ptr, png_bytep pn
 	PNG_CONST png_uint_32 height = vid.height / downscale;
 	png_bytepp row_pointers = png_malloc(png_ptr, height * sizeof (png_bytep));
 	png_uint_32 x, y;
-	png_uint_16 framedelay = (png_uint_16)cv_apng_delay.value;
+	png_uint_16 framedelay = apng_delay;
 
 	apng_frames++;
 
@@ -1087,6 +1310,8 @@ static void M_PNGFrame(png_structp png_ptr, png_infop png_info_ptr, png_bytep pn
 #endif
 		aPNG_write_frame_tail(apng_ptr, apng_info_ptr);
 
+	for (y = 0; y < height; y++)
+		free(row_pointers[y]);
 	png_free(png_ptr, (png_voidp)row_pointers);
 }
 
@@ -1105,6 +1330,7 @@ static boolean M_SetupaPNG(png_const_charp filename, png_bytep pal)
 	png_uint_16 downscale;
 
 	apng_downscale = (!!cv_apng_downscale.value);
+	apng_delay = (png_uint_16)cv_apng_delay.value;
 
 	downscale = apng_downscale ? vid.dupx : 1;
 
@@ -1179,6 +1405,216 @@ static boolean M_SetupaPNG(png_const_charp filename, png_bytep pal)
 //                             MOVIE MODE
 // ==========================================================================
 #if NUMSCREENS > 2
+// The game thread only copies the screen and its palette into a ring of
+// preallocated frames; the encoder thread does the GIF diffing, LZW and
+// zlib work and the file writes. When the ring is full, movie_overflow
+// decides whether the frame is dropped or the game thread waits.
+#define MOVIE_QUEUE_FRAMES 8
+
+typedef struct
+{
+	UINT8 *buffer; // preallocated copy of the software screen
+	UINT8 *pixels; // the frame to encode: buffer, or an OpenGL capture
+	boolean rgb; // pixels are RGB rather than paletted
+	RGBA_t palette[256];
+	precise_t time;
+} movieframe_t;
+
+static movieframe_t movie_frames[MOVIE_QUEUE_FRAMES];
+static size_t movie_head = 0; // next frame the game thread fills
+static size_t movie_tail = 0; // next frame the encoder writes out
+static size_t movie_queued = 0;
+static UINT32 movie_captured = 0;
+static UINT32 movie_dropped = 0;
+
+#ifdef HAVE_THREADS
+static I_mutex movie_mutex;
+static I_cond  movie_cond;
+static boolean movie_encoding = false; // encoder thread is running
+
+#  define Lock_movie()   I_lock_mutex  (&movie_mutex)
+#  define Unlock_movie() I_unlock_mutex (movie_mutex)
+#else/*HAVE_THREADS*/
+#  define Lock_movie()
+#  define Unlock_movie()
+#endif/*HAVE_THREADS*/
+
+static void M_EncodeMovieFrame(movieframe_t *frame)
+{
+	switch (moviemode)
+	{
+#ifdef HAVE_ANIGIF
+		case MM_GIF:
+			GIF_frame(frame->pixels, frame->rgb, frame->palette, frame->time);
+			break;
+#endif
+#ifdef USE_APNG
+		case MM_APNG:
+			if (apng_FILE)
+				M_PNGFrame(apng_ptr, apng_info_ptr, (png_bytep)frame->pixels);
+			break;
+#endif
+		default:
+			break;
+	}
+
+	if (frame->pixels != frame->buffer)
+		free(frame->pixels);
+	frame->pixels = NULL;
+}
+
+#ifdef HAVE_THREADS
+// Runs only while there are frames queued, so it never outlives the
+// recording or holds up I_stop_threads at exit.
+static void M_MovieEncoderThread(void *userdata)
+{
+	movieframe_t *frame;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		Lock_movie();
+		{
+			if (movie_queued == 0)
+			{
+				movie_encoding = false;
+				I_wake_all_cond(&movie_cond);
+				Unlock_movie();
+				return;
+			}
+			frame = &movie_frames[movie_tail];
+		}
+		Unlock_movie();
+
+		M_EncodeMovieFrame(frame);
+
+		Lock_movie();
+		{
+			movie_tail = (movie_tail + 1) % MOVIE_QUEUE_FRAMES;
+			movie_queued--;
+			I_wake_all_cond(&movie_cond);
+		}
+		Unlock_movie();
+	}
+}
+#endif
+
+static void M_StartMovieQueue(void)
+{
+	size_t i;
+
+	for (i = 0; i < MOVIE_QUEUE_FRAMES; i++)
+	{
+		movie_frames[i].buffer = (rendermode == render_soft) ? malloc(vid.width * vid.height * vid.bpp) : NULL;
+		movie_frames[i].pixels = NULL;
+	}
+
+	movie_head = movie_tail = movie_queued = 0;
+	movie_captured = movie_dropped = 0;
+}
+
+// Waits for every queued frame to be written, then frees the ring
+static void M_StopMovieQueue(void)
+{
+	size_t i;
+
+#ifdef HAVE_THREADS
+	Lock_movie();
+	{
+		while (movie_encoding)
+			I_hold_cond(&movie_cond, movie_mutex);
+	}
+	Unlock_movie();
+#endif
+
+	for (i = 0; i < MOVIE_QUEUE_FRAMES; i++)
+	{
+		free(movie_frames[i].buffer);
+		movie_frames[i].buffer = NULL;
+	}
+
+	if (movie_dropped)
+		CONS_Printf(M_GetText("Movie encoder fell behind; dropped %u of %u frames\n"), movie_dropped, movie_captured);
+}
+
+static void M_QueueMovieFrame(void)
+{
+	movieframe_t *frame;
+	size_t queued;
+
+	movie_captured++;
+
+	Lock_movie();
+	{
+#ifdef HAVE_THREADS
+		if (cv_movie_overflow.value)
+		{
+			while (movie_queued == MOVIE_QUEUE_FRAMES)
+				I_hold_cond(&movie_cond, movie_mutex);
+		}
+#endif
+		queued = movie_queued;
+	}
+	Unlock_movie();
+
+	if (queued == MOVIE_QUEUE_FRAMES)
+	{
+		movie_dropped++;
+		return;
+	}
+
+	// This slot is not touched by the encoder until it's queued below
+	frame = &movie_frames[movie_head];
+	frame->time = I_GetPreciseTime();
+
+	if (rendermode == render_soft)
+	{
+		// munge planar buffer to linear
+		if (!frame->buffer)
+			frame->buffer = malloc(vid.width * vid.height * vid.bpp);
+		frame->pixels = frame->buffer;
+		frame->rgb = false;
+		if (frame->pixels)
+			I_ReadScreen(frame->pixels);
+	}
+#ifdef HWRENDER
+	else
+	{
+		frame->pixels = HWR_GetScreenshot();
+		frame->rgb = true;
+	}
+#endif
+
+	if (!frame->pixels)
+	{
+		movie_dropped++;
+		return;
+	}
+
+#ifdef HAVE_ANIGIF
+	if (moviemode == MM_GIF)
+		M_Memcpy(frame->palette, GIF_getframepalette(), sizeof(frame->palette));
+#endif
+
+#ifdef HAVE_THREADS
+	Lock_movie();
+	{
+		movie_head = (movie_head + 1) % MOVIE_QUEUE_FRAMES;
+		movie_queued++;
+
+		if (!movie_encoding)
+		{
+			movie_encoding = true;
+			I_spawn_thread("movie-encoder", (I_thread_fn)M_MovieEncoderThread, NULL);
+		}
+	}
+	Unlock_movie();
+#else
+	M_EncodeMovieFrame(frame);
+#endif
+}
+
 static inline moviemode_t M_StartMovieAPNG(const char *pathname)
 {
 #ifdef USE_APNG
@@ -1287,6 +1723,9 @@ void M_StartMovie(void)
 			return;
 	}
 
+	if (moviemode == MM_APNG || moviemode == MM_GIF)
+		M_StartMovieQueue();
+
 	if (moviemode == MM_APNG)
 		CONS_Printf(M_GetText("Movie mode enabled (%s).\n"), "aPNG");
 	else if (moviemode == MM_GIF)
@@ -1315,39 +1754,26 @@ void M_SaveFrame(void)
 			takescreenshot = true;
 			return;
 		case MM_GIF:
-			GIF_frame();
+#ifdef HAVE_ANIGIF
+			M_QueueMovieFrame();
+#else
+			moviemode = MM_OFF;
+#endif
 			return;
 		case MM_APNG:
 #ifdef USE_APNG
+			if (!apng_FILE) // should not happen!!
 			{
-				UINT8 *linear = NULL;
-				if (!apng_FILE) // should not happen!!
-				{
-					moviemode = MM_OFF;
-					return;
-				}
+				moviemode = MM_OFF;
+				return;
+			}
 
-				if (rendermode == render_soft)
-				{
-					// munge planar buffer to linear
-					linear = screens[2];
-					I_ReadScreen(linear);
-				}
-#ifdef HWRENDER
-				else
-					linear = HWR_GetScreenshot();
-#endif
-				M_PNGFrame(apng_ptr, apng_info_ptr, (png_bytep)linear);
-#ifdef HWRENDER
-				if (rendermode != render_soft && linear)
-					free(linear);
-#endif
+			M_QueueMovieFrame();
 
-				if (apng_frames == PNG_UINT_31_MAX)
-				{
-					CONS_Alert(CONS_NOTICE, M_GetText("Max movie size reached\n"));
-					M_StopMovie();
-				}
+			if (movie_captured == PNG_UINT_31_MAX)
+			{
+				CONS_Alert(CONS_NOTICE, M_GetText("Max movie size reached\n"));
+				M_StopMovie();
 			}
 #else
 			moviemode = MM_OFF;
@@ -1362,6 +1788,9 @@ void M_SaveFrame(void)
 void M_StopMovie(void)
 {
 #if NUMSCREENS > 2
+	if (moviemode == MM_APNG || moviemode == MM_GIF)
+		M_StopMovieQueue();
+
 	switch (moviemode)
 	{
 		case MM_GIF:
@@ -1484,9 +1913,15 @@ boolean M_SavePNG(const char *filename, void *data, int width, int height, const
 
 	png_write_info(png_ptr, png_info_ptr);
 
-	M_PNGImage(png_ptr, png_info_ptr, height, data);
+#ifdef HAVE_THREADS
+	if (!M_PNGParallelImage(png_ptr, png_info_ptr, height, data, (palette != NULL),
+		cv_zlib_level.value, cv_zlib_memory.value, cv_zlib_strategy.value, cv_zlib_window_bits.value))
+#endif
+	{
+		M_PNGImage(png_ptr, png_info_ptr, height, data);
+		png_write_end(png_ptr, png_info_ptr);
+	}
 
-	png_write_end(png_ptr, png_info_ptr);
 	png_destroy_write_struct(&png_ptr, &png_info_ptr);
 
 	fclose(png_FILE);
@@ -1592,6 +2027,91 @@ void M_ScreenShot(void)
 	takescreenshot = true;
 }
 
+/** Times PNG and GIF encoding of the current frame, single-threaded and
+  * with the bands split across encode_threads. Run it at 1920x1080 for
+  * per-1080p-frame numbers.
+  */
+void M_EncodeBenchmark(void)
+{
+#if NUMSCREENS > 2
+	const INT32 iterations = (COM_Argc() > 1) ? max(1, atoi(COM_Argv(1))) : 5;
+	char filename[MAX_WADPATH];
+	char oldthreads[32];
+	double pngms[2] = {0, 0}, gifms[2] = {0, 0};
+	double mspertick = 1000.0 / I_GetPrecisePrecision();
+	precise_t start;
+	UINT8 *linear;
+	INT32 pass, i;
+
+	if (rendermode != render_soft)
+	{
+		CONS_Printf(M_GetText("encodebench is only available in Software mode\n"));
+		return;
+	}
+
+	if (moviemode != MM_OFF)
+	{
+		CONS_Printf(M_GetText("You can't use encodebench while recording a movie.\n"));
+		return;
+	}
+
+	linear = malloc(vid.width * vid.height);
+	if (!linear)
+		return;
+	I_ReadScreen(linear);
+	M_CreateScreenShotPalette();
+
+	// not va(), the PNG text chunks use it too
+	snprintf(filename, sizeof filename, pandf, srb2home, "encodebench.tmp");
+	strlcpy(oldthreads, cv_encode_threads.string, sizeof oldthreads);
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		// single-threaded first, then with the configured thread count
+		if (pass)
+			CV_StealthSet(&cv_encode_threads, oldthreads);
+		else
+			CV_StealthSetValue(&cv_encode_threads, 1);
+
+#ifdef USE_PNG
+		start = I_GetPreciseTime();
+		for (i = 0; i < iterations; i++)
+			M_SavePNG(filename, linear, vid.width, vid.height, screenshot_palette);
+		pngms[pass] = (double)(I_GetPreciseTime() - start) * mspertick / iterations;
+#endif
+
+#ifdef HAVE_ANIGIF
+		{
+			// every frame gets encoded in full
+			const INT32 oldoptimize = cv_gif_optimize.value;
+			CV_StealthSetValue(&cv_gif_optimize, 0);
+
+			if (GIF_open(filename))
+			{
+				RGBA_t *palette = GIF_getframepalette();
+
+				start = I_GetPreciseTime();
+				for (i = 0; i < iterations; i++)
+					GIF_frame(linear, false, palette, I_GetPreciseTime());
+				gifms[pass] = (double)(I_GetPreciseTime() - start) * mspertick / iterations;
+
+				GIF_close();
+			}
+
+			CV_StealthSetValue(&cv_gif_optimize, oldoptimize);
+		}
+#endif
+	}
+
+	remove(filename);
+	free(linear);
+
+	CONS_Printf(M_GetText("Encoding a %dx%d frame, average of %d:\n"), vid.width, vid.height, iterations);
+	CONS_Printf(M_GetText("PNG: %.2f ms with 1 thread, %.2f ms with %d bands\n"), pngms[0], pngms[1], M_EncodeBands(vid.width * vid.height));
+	CONS_Printf(M_GetText("GIF: %.2f ms with 1 thread, %.2f ms with %d bands\n"), gifms[0], gifms[1], M_EncodeBands(vid.width * vid.height));
+#endif
+}
+
 /** Takes a screenshot.
   * The screenshot is saved as "srb2xxxx.png" where xxxx is the lowest
   * four-digit number for which a file does not already exist.
@@ -2085,6 +2605,7 @@ static void M_ReadTokenString(UINT32 i)
 	if (tokenLength + 1 > tokenCapacity[i])
 	{
 		tokenCapacity[i] = tokenLength + 1;
+		Z_Free(tokenizerToken[i]);
 		// Assign the memory. Don't forget an extra byte for the end of the string!
 		tokenizerToken[i] = (char *)Z_Malloc(tokenCapacity[i] * sizeof(char), PU_STATIC, NULL);
 	}
@@ -2190,6 +2711,108 @@ void M_TokenizerSetEndPos(UINT32 newPos)
 	tokenizerEndPos = newPos;
 }
 
+/** Starts scanning a text buffer with M_ScannerRead.
+  * The input doesn't have to be NUL-terminated, and it isn't copied:
+  * it must stay alive for as long as the scanner and its tokens are used.
+  */
+void M_ScannerOpen(textscanner_t *scanner, const char *input, size_t length)
+{
+	scanner->input = input;
+	scanner->length = (UINT32)length;
+	scanner->pos = 0;
+}
+
+// Skipped between tokens. '=' and ';' are there for UDMF TEXTMAP.
+#define M_IsScannerSpace(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n' \
+	|| (c) == '\0' || (c) == '=' || (c) == ';')
+
+/** Reads the next token as a view into the input, without copying it.
+  * Splits tokens the same way M_TokenizerRead does, in a single pass.
+  *
+  * \param scanner Scanner opened with M_ScannerOpen.
+  * \param tkn Receives the token. Quoted strings exclude their quotes.
+  * \return false once the end of the input is reached.
+  */
+boolean M_ScannerRead(textscanner_t *scanner, tokenview_t *tkn)
+{
+	const char *in = scanner->input;
+	const UINT32 length = scanner->length;
+	UINT32 pos = scanner->pos;
+	UINT32 end;
+
+	// Skip whitespace and comments.
+	while (pos < length)
+	{
+		if (M_IsScannerSpace(in[pos]))
+			pos++;
+		else if (in[pos] == '/' && pos + 1 < length && in[pos+1] == '/')
+		{
+			for (pos += 2; pos < length && in[pos] != '\n'; pos++)
+				;
+		}
+		else if (in[pos] == '/' && pos + 1 < length && in[pos+1] == '*')
+		{
+			for (pos += 2; pos + 1 < length && !(in[pos] == '*' && in[pos+1] == '/'); pos++)
+				;
+			pos = min(pos + 2, length);
+		}
+		else
+			break;
+	}
+
+	if (pos >= length)
+	{
+		scanner->pos = length;
+		return false;
+	}
+
+	tkn->quoted = false;
+
+	if (in[pos] == ',' || in[pos] == '{' || in[pos] == '}')
+		end = pos + 1;
+	else if (in[pos] == '"')
+	{
+		for (end = ++pos; end < length && in[end] != '"'; end++)
+			;
+		tkn->quoted = true;
+	}
+	else
+	{
+		for (end = pos + 1; end < length; end++)
+		{
+			const char c = in[end];
+			if (M_IsScannerSpace(c) || c == ',' || c == '{' || c == '}')
+				break;
+			if (c == '/' && end + 1 < length && (in[end+1] == '/' || in[end+1] == '*'))
+				break;
+		}
+	}
+
+	tkn->text = in + pos;
+	tkn->start = pos;
+	tkn->length = end - pos;
+
+	// Step over the closing quote.
+	scanner->pos = (tkn->quoted && end < length) ? end + 1 : end;
+	return true;
+}
+
+#undef M_IsScannerSpace
+
+/** Compares a token to a NUL-terminated string, case-sensitively.
+  */
+boolean M_TokenIs(const tokenview_t *tkn, const char *str)
+{
+	return !strncmp(tkn->text, str, tkn->length) && str[tkn->length] == '\0';
+}
+
+/** Compares a token to a NUL-terminated string, case-insensitively.
+  */
+boolean M_TokenIsI(const tokenview_t *tkn, const char *str)
+{
+	return !strnicmp(tkn->text, str, tkn->length) && str[tkn->length] == '\0';
+}
+
 /** Count bits in a number.
   */
 UINT8 M_CountBits(UINT32 num, UINT8 size)
@@ -30,10 +30,13 @@ typedef enum {
 extern moviemode_t moviemode;
 
 extern consvar_t cv_screenshot_option, cv_screenshot_folder, cv_screenshot_colorprofile;
-extern consvar_t cv_moviemode, cv_movie_folder, cv_movie_option;
+extern consvar_t cv_moviemode, cv_movie_folder, cv_movie_option, cv_movie_overflow;
 extern consvar_t cv_zlib_memory, cv_zlib_level, cv_zlib_strategy, cv_zlib_window_bits;
 extern consvar_t cv_zlib_memorya, cv_zlib_levela, cv_zlib_strategya, cv_zlib_window_bitsa;
 extern consvar_t cv_apng_delay, cv_apng_downscale;
+extern consvar_t cv_encode_threads;
+
+INT32 M_EncodeBands(size_t pixels);
 
 void M_StartMovie(void);
 void M_SaveFrame(void);
@@ -75,6 +78,7 @@ boolean M_SavePNG(const char *filename, void *data, int width, int height, const
 extern boolean takescreenshot;
 void M_ScreenShot(void);
 void M_DoScreenShot(void);
+void M_EncodeBenchmark(void);
 boolean M_ScreenshotResponder(event_t *ev);
 
 void Command_SaveConfig_f(void);
@@ -67,6 +67,8 @@ ps_metric_t ps_checkposition_calls = {0};
 
 ps_metric_t ps_lua_thinkframe_time = {0};
 ps_metric_t ps_lua_mobjhooks = {0};
+ps_metric_t ps_lua_gctime = {0};
+ps_metric_t ps_lua_heapsize = {0};
 
 ps_metric_t ps_otherlogictime = {0};
 
@@ -115,6 +117,12 @@ perfstatrow_t gamelogicbrief_row[] = {
 	{0}
 };
 
+perfstatrow_t luagc_rows[] = {
+	{"luagc  ", "Lua GC:        ", &ps_lua_gctime, PS_TIME},
+	{"luaheap", "Lua heap (KB): ", &ps_lua_heapsize, 0},
+	{0}
+};
+
 perfstatrow_t commoncounter_rows[] = {
 	{"bspcall", "BSP calls:   ", &ps_numbspcalls, 0},
 	{"sprites", "Sprites:     ", &ps_numsprites, 0},
@@ -477,6 +485,7 @@ static void PS_UpdateFrameStats(void)
 	if (cv_ps_samplesize.value > 1)
 	{
 		PS_UpdateRowHistories(rendertime_rows, true);
+		PS_UpdateRowHistories(luagc_rows, true);
 		if (PS_IsLevelActive())
 			PS_UpdateRowHistories(commoncounter_rows, true);
 
@@ -650,7 +659,8 @@ static void PS_DrawRenderStats(void)
 
 	y = PS_DrawPerfRows(20, 10, V_YELLOWMAP, rendertime_rows);
 
-	PS_DrawPerfRows(20, y + half_row, V_GRAYMAP, gamelogicbrief_row);
+	y = PS_DrawPerfRows(20, y + half_row, V_GRAYMAP, gamelogicbrief_row);
+	PS_DrawPerfRows(20, y + half_row, V_GREENMAP, luagc_rows);
 
 	if (PS_IsLevelActive())
 	{
@@ -45,6 +45,8 @@ extern ps_metric_t ps_checkposition_calls;
 
 extern ps_metric_t ps_lua_thinkframe_time;
 extern ps_metric_t ps_lua_mobjhooks;
+extern ps_metric_t ps_lua_gctime;
+extern ps_metric_t ps_lua_heapsize;
 
 extern ps_metric_t ps_otherlogictime;
 
@@ -76,18 +76,23 @@ typedef u_int32_t md5_uint32;
  * The following three functions are build up the low level used in
  * the functions `md5_stream' and `md5_buffer'.
  */
-#if 0
+/* Structure to save state of computation between the single steps.  */
+struct md5_ctx
+{
+  md5_uint32 A;
+  md5_uint32 B;
+  md5_uint32 C;
+  md5_uint32 D;
+
+  md5_uint32 total[2];
+  md5_uint32 buflen;
+  char buffer[128];
+};
+
 /* Initialize structure containing state of computation.
    (RFC 1321, 3.3: Step 3)  */
 extern void md5_init_ctx __P ((struct md5_ctx *ctx));
 
-/* Starting with the result of former calls of this function (or the
-   initialization function update the context for the next LEN bytes
-   starting at BUFFER.
-   It is necessary that LEN is a multiple of 64!!! */
-extern void md5_process_block __P ((const void *buffer, size_t len,
-                                   struct md5_ctx *ctx));
-
 /* Starting with the result of former calls of this function (or the
    initialization function update the context for the next LEN bytes
    starting at BUFFER.
@@ -104,17 +109,6 @@ extern void md5_process_bytes __P ((const void *buffer, size_t len,
    aligned for a 32 bits value.  */
 extern void *md5_finish_ctx __P ((struct md5_ctx *ctx, void *resbuf));
 
-
-/* Put result from CTX in first 16 bytes following RESBUF.  The result is
-   always in little endian byte order, so that a byte-wise output yields
-   to the wanted ASCII representation of the message digest.
-
-   IMPORTANT: On some systems it is required that RESBUF is correctly
-   aligned for a 32 bits value.  */
-extern void *md5_read_ctx __P ((const struct md5_ctx *ctx, void *resbuf));
-
-#endif
-
 /* Compute MD5 message digest for bytes read from STREAM.  The
    resulting message digest number will be written into the 16 bytes
    beginning at RESBLOCK.  */
@@ -1534,18 +1534,275 @@ static void P_LoadThings(UINT8 *data)
 	}
 }
 
-// Stores positions for relevant map data spread through a TEXTMAP.
+// UDMF keywords. Field names are resolved to one of these as the TEXTMAP is
+// scanned, so the parameter parsers can switch on them.
+typedef enum
+{
+	UDMF_UNKNOWN = 0,
+
+	// Block types
+	UDMF_NAMESPACE, UDMF_THING, UDMF_LINEDEF, UDMF_SIDEDEF, UDMF_VERTEX, UDMF_SECTOR,
+
+	// Shared
+	UDMF_ID, UDMF_MOREIDS, UDMF_X, UDMF_Y,
+
+	// Vertices
+	UDMF_ZFLOOR, UDMF_ZCEILING,
+
+	// Sectors
+	UDMF_HEIGHTFLOOR, UDMF_HEIGHTCEILING, UDMF_TEXTUREFLOOR, UDMF_TEXTURECEILING, UDMF_LIGHTLEVEL,
+	UDMF_LIGHTFLOOR, UDMF_LIGHTFLOORABSOLUTE, UDMF_LIGHTCEILING, UDMF_LIGHTCEILINGABSOLUTE,
+	UDMF_XPANNINGFLOOR, UDMF_YPANNINGFLOOR, UDMF_XPANNINGCEILING, UDMF_YPANNINGCEILING,
+	UDMF_ROTATIONFLOOR, UDMF_ROTATIONCEILING, UDMF_FLOORPLANE_A, UDMF_FLOORPLANE_B,
+	UDMF_FLOORPLANE_C, UDMF_FLOORPLANE_D, UDMF_CEILINGPLANE_A, UDMF_CEILINGPLANE_B,
+	UDMF_CEILINGPLANE_C, UDMF_CEILINGPLANE_D, UDMF_LIGHTCOLOR, UDMF_LIGHTALPHA, UDMF_FADECOLOR,
+	UDMF_FADEALPHA, UDMF_FADESTART, UDMF_FADEEND, UDMF_COLORMAPFOG, UDMF_COLORMAPFADESPRITES,
+	UDMF_COLORMAPPROTECTED, UDMF_FLIPSPECIAL_NOFLOOR, UDMF_FLIPSPECIAL_CEILING,
+	UDMF_TRIGGERSPECIAL_TOUCH, UDMF_TRIGGERSPECIAL_HEADBUMP, UDMF_TRIGGERLINE_PLANE,
+	UDMF_TRIGGERLINE_MOBJ, UDMF_INVERTPRECIP, UDMF_GRAVITYFLIP, UDMF_HEATWAVE, UDMF_NOCLIPCAMERA,
+	UDMF_OUTERSPACE, UDMF_DOUBLESTEPUP, UDMF_NOSTEPDOWN, UDMF_SPEEDPAD, UDMF_STARPOSTACTIVATOR,
+	UDMF_EXIT, UDMF_SPECIALSTAGEPIT, UDMF_RETURNFLAG, UDMF_REDTEAMBASE, UDMF_BLUETEAMBASE,
+	UDMF_FAN, UDMF_SUPERTRANSFORM, UDMF_FORCESPIN, UDMF_ZOOMTUBESTART, UDMF_ZOOMTUBEEND,
+	UDMF_FINISHLINE, UDMF_ROPEHANG, UDMF_JUMPFLIP, UDMF_GRAVITYOVERRIDE, UDMF_FRICTION,
+	UDMF_GRAVITY, UDMF_DAMAGETYPE, UDMF_TRIGGERTAG, UDMF_TRIGGERER,
+
+	// Sidedefs
+	UDMF_OFFSETX, UDMF_OFFSETY, UDMF_OFFSETX_TOP, UDMF_OFFSETX_MID, UDMF_OFFSETX_BOTTOM,
+	UDMF_OFFSETY_TOP, UDMF_OFFSETY_MID, UDMF_OFFSETY_BOTTOM, UDMF_TEXTURETOP, UDMF_TEXTUREBOTTOM,
+	UDMF_TEXTUREMIDDLE, UDMF_REPEATCNT,
+
+	// Linedefs
+	UDMF_SPECIAL, UDMF_V1, UDMF_V2, UDMF_SIDEFRONT, UDMF_SIDEBACK, UDMF_ALPHA, UDMF_BLENDMODE,
+	UDMF_RENDERSTYLE, UDMF_EXECUTORDELAY, UDMF_BLOCKING, UDMF_BLOCKMONSTERS, UDMF_TWOSIDED,
+	UDMF_DONTPEGTOP, UDMF_DONTPEGBOTTOM, UDMF_SKEWTD, UDMF_NOCLIMB, UDMF_NOSKEW, UDMF_MIDPEG,
+	UDMF_MIDSOLID, UDMF_WRAPMIDTEX, UDMF_NONET, UDMF_NETONLY, UDMF_BOUNCY, UDMF_TRANSFER,
+
+	// Things
+	UDMF_HEIGHT, UDMF_ANGLE, UDMF_PITCH, UDMF_ROLL, UDMF_TYPE, UDMF_SCALE, UDMF_SCALEX,
+	UDMF_SCALEY, UDMF_MOBJSCALE, UDMF_FLIP, UDMF_ABSOLUTEZ,
+
+	// Linedef and thing arguments; keep in order
+	UDMF_ARG0, UDMF_ARG1, UDMF_ARG2, UDMF_ARG3, UDMF_ARG4, UDMF_ARG5, UDMF_ARG6, UDMF_ARG7,
+	UDMF_ARG8, UDMF_ARG9, UDMF_STRINGARG0, UDMF_STRINGARG1,
+
+	NUMUDMFKEYS
+} udmfkey_t;
+
+static const char *const textmapkeynames[NUMUDMFKEYS] =
+{
+	NULL,
+
+	// Block types
+	"namespace", "thing", "linedef", "sidedef", "vertex", "sector",
+
+	// Shared
+	"id", "moreids", "x", "y",
+
+	// Vertices
+	"zfloor", "zceiling",
+
+	// Sectors
+	"heightfloor", "heightceiling", "texturefloor", "textureceiling", "lightlevel", "lightfloor",
+	"lightfloorabsolute", "lightceiling", "lightceilingabsolute", "xpanningfloor", "ypanningfloor",
+	"xpanningceiling", "ypanningceiling", "rotationfloor", "rotationceiling", "floorplane_a",
+	"floorplane_b", "floorplane_c", "floorplane_d", "ceilingplane_a", "ceilingplane_b",
+	"ceilingplane_c", "ceilingplane_d", "lightcolor", "lightalpha", "fadecolor", "fadealpha",
+	"fadestart", "fadeend", "colormapfog", "colormapfadesprites", "colormapprotected",
+	"flipspecial_nofloor", "flipspecial_ceiling", "triggerspecial_touch",
+	"triggerspecial_headbump", "triggerline_plane", "triggerline_mobj", "invertprecip",
+	"gravityflip", "heatwave", "noclipcamera", "outerspace", "doublestepup", "nostepdown",
+	"speedpad", "starpostactivator", "exit", "specialstagepit", "returnflag", "redteambase",
+	"blueteambase", "fan", "supertransform", "forcespin", "zoomtubestart", "zoomtubeend",
+	"finishline", "ropehang", "jumpflip", "gravityoverride", "friction", "gravity", "damagetype",
+	"triggertag", "triggerer",
+
+	// Sidedefs
+	"offsetx", "offsety", "offsetx_top", "offsetx_mid", "offsetx_bottom", "offsety_top",
+	"offsety_mid", "offsety_bottom", "texturetop", "texturebottom", "texturemiddle", "repeatcnt",
+
+	// Linedefs
+	"special", "v1", "v2", "sidefront", "sideback", "alpha", "blendmode", "renderstyle",
+	"executordelay", "blocking", "blockmonsters", "twosided", "dontpegtop", "dontpegbottom",
+	"skewtd", "noclimb", "noskew", "midpeg", "midsolid", "wrapmidtex", "nonet", "netonly",
+	"bouncy", "transfer",
+
+	// Things
+	"height", "angle", "pitch", "roll", "type", "scale", "scalex", "scaley", "mobjscale", "flip",
+	"absolutez",
+
+	// Linedef and thing arguments; keep in order
+	"arg0", "arg1", "arg2", "arg3", "arg4", "arg5", "arg6", "arg7", "arg8", "arg9", "stringarg0",
+	"stringarg1",
+};
+
+// Perfect hash of textmapkeynames: the seed is searched for once, so that
+// every keyword lands in a slot of its own and a lookup is a single compare.
+#define TEXTMAPKEYSLOTS 4096
+static UINT8 textmapkeyslots[TEXTMAPKEYSLOTS];
+static UINT32 textmapkeyseed = 0;
+
+static UINT32 TextmapHashKey(const char *s, size_t length, UINT32 seed)
+{
+	UINT32 hash = 2166136261u ^ seed; // FNV-1a
+
+	while (length--)
+	{
+		hash ^= (UINT8)*s++;
+		hash *= 16777619u;
+	}
+
+	return hash & (TEXTMAPKEYSLOTS - 1);
+}
+
+static void TextmapInitKeys(void)
+{
+	UINT32 seed;
+	INT32 i;
+
+	for (seed = 1;; seed++)
+	{
+		memset(textmapkeyslots, UDMF_UNKNOWN, sizeof textmapkeyslots);
+
+		for (i = 1; i < NUMUDMFKEYS; i++)
+		{
+			UINT32 slot = TextmapHashKey(textmapkeynames[i], strlen(textmapkeynames[i]), seed);
+			if (textmapkeyslots[slot] != UDMF_UNKNOWN)
+				break;
+			textmapkeyslots[slot] = (UINT8)i;
+		}
+
+		if (i == NUMUDMFKEYS)
+			break;
+	}
+
+	textmapkeyseed = seed;
+}
+
+static udmfkey_t TextmapKey(const tokenview_t *tkn)
+{
+	udmfkey_t key;
+
+	if (!textmapkeyseed)
+		TextmapInitKeys();
+
+	key = textmapkeyslots[TextmapHashKey(tkn->text, tkn->length, textmapkeyseed)];
+	if (key != UDMF_UNKNOWN && M_TokenIs(tkn, textmapkeynames[key]))
+		return key;
+	return UDMF_UNKNOWN;
+}
+
+// A field of a TEXTMAP block: its keyword, and where its value is in the lump.
+typedef struct
+{
+	UINT32 value;
+	UINT32 length;
+	udmfkey_t key; // UDMF_UNKNOWN ends the block.
+} textmapfield_t;
+
+static const char *textmapdata = NULL;
+static textmapfield_t *textmapfields = NULL;
+static size_t numtextmapfields = 0;
+static size_t maxtextmapfields = 0;
+
+// Time spent scanning and parsing the last TEXTMAP, for textmapbench.
+static precise_t textmapscantime = 0;
+static precise_t textmapparsetime = 0;
+
+// Stores the first field of each block of map data spread through a TEXTMAP.
 UINT32 mapthingsPos[UINT16_MAX];
 UINT32 linesPos[UINT16_MAX];
 UINT32 sidesPos[UINT16_MAX];
 UINT32 vertexesPos[UINT16_MAX];
 UINT32 sectorsPos[UINT16_MAX];
 
+static void TextmapAddField(udmfkey_t key, const tokenview_t *val)
+{
+	if (numtextmapfields == maxtextmapfields)
+	{
+		maxtextmapfields = maxtextmapfields ? maxtextmapfields * 2 : 8192;
+		textmapfields = Z_Realloc(textmapfields, maxtextmapfields * sizeof (*textmapfields), PU_STATIC, NULL);
+	}
+
+	textmapfields[numtextmapfields].key = key;
+	textmapfields[numtextmapfields].value = val ? val->start : 0;
+	textmapfields[numtextmapfields].length = val ? val->length : 0;
+	numtextmapfields++;
+}
+
+static void TextmapFreeFields(void)
+{
+	Z_Free(textmapfields);
+	textmapfields = NULL;
+	numtextmapfields = maxtextmapfields = 0;
+	textmapdata = NULL;
+}
+
+/** Reads a {}-encapsuled block, storing its known fields.
+  *
+  * \return false if the block is never closed.
+  */
+static boolean TextmapReadBlock(textscanner_t *scanner)
+{
+	tokenview_t param, val;
+
+	if (!M_ScannerRead(scanner, &param) || !M_TokenIs(&param, "{"))
+	{
+		CONS_Alert(CONS_WARNING, "Invalid UDMF data capsule!\n");
+		TextmapAddField(UDMF_UNKNOWN, NULL);
+		return true;
+	}
+
+	while (M_ScannerRead(scanner, &param))
+	{
+		udmfkey_t key;
+
+		if (M_TokenIs(&param, "}"))
+		{
+			TextmapAddField(UDMF_UNKNOWN, NULL);
+			return true;
+		}
+
+		if (!M_ScannerRead(scanner, &val))
+			break;
+
+		// Unknown fields would be ignored by the parsers anyway.
+		key = TextmapKey(&param);
+		if (key != UDMF_UNKNOWN)
+			TextmapAddField(key, &val);
+	}
+
+	return false;
+}
+
+/** Skips an unknown {}-encapsuled block.
+  *
+  * \return false if the block is never closed.
+  */
+static boolean TextmapSkipBlock(textscanner_t *scanner)
+{
+	tokenview_t tkn;
+	UINT8 brackets = 1;
+
+	while (M_ScannerRead(scanner, &tkn))
+	{
+		if (tkn.quoted || tkn.length != 1)
+			continue;
+		if (tkn.text[0] == '{')
+			brackets++;
+		else if (tkn.text[0] == '}' && !--brackets)
+			return true;
+	}
+
+	return false;
+}
+
 // Determine total amount of map data in TEXTMAP.
-static boolean TextmapCount(size_t size)
+// The whole lump is scanned once here; TextmapParse only reads back the stored fields.
+static boolean TextmapCount(const char *data, size_t size)
 {
-	const char *tkn = M_TokenizerRead(0);
-	UINT8 brackets = 0;
+	textscanner_t scanner;
+	tokenview_t tkn;
+	boolean closed = true;
 
 	nummapthings = 0;
 	numlines = 0;
@@ -1553,44 +1810,60 @@ static boolean TextmapCount(size_t size)
 	numvertexes = 0;
 	numsectors = 0;
 
+	textmapdata = data;
+	numtextmapfields = 0;
+
+	M_ScannerOpen(&scanner, data, size);
+
 	// Look for namespace at the beginning.
-	if (!fastcmp(tkn, "namespace"))
+	if (!M_ScannerRead(&scanner, &tkn) || TextmapKey(&tkn) != UDMF_NAMESPACE)
 	{
 		CONS_Alert(CONS_ERROR, "No namespace at beginning of lump!\n");
 		return false;
 	}
 
 	// Check if namespace is valid.
-	tkn = M_TokenizerRead(0);
-	if (!fastcmp(tkn, "srb2"))
-		CONS_Alert(CONS_WARNING, "Invalid namespace '%s', only 'srb2' is supported.\n", tkn);
+	if (!M_ScannerRead(&scanner, &tkn))
+		tkn.length = 0;
+	if (!M_TokenIs(&tkn, "srb2"))
+		CONS_Alert(CONS_WARNING, "Invalid namespace '%.*s', only 'srb2' is supported.\n", (int)tkn.length, tkn.text);
 
-	while ((tkn = M_TokenizerRead(0)) && M_TokenizerGetEndPos() < size)
+	while (closed && M_ScannerRead(&scanner, &tkn))
 	{
 		// Avoid anything inside bracketed stuff, only look for external keywords.
-		if (brackets)
+		if (M_TokenIs(&tkn, "{"))
 		{
-			if (fastcmp(tkn, "}"))
-				brackets--;
+			closed = TextmapSkipBlock(&scanner);
+			continue;
 		}
-		else if (fastcmp(tkn, "{"))
-			brackets++;
+
 		// Check for valid fields.
-		else if (fastcmp(tkn, "thing"))
-			mapthingsPos[nummapthings++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "linedef"))
-			linesPos[numlines++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "sidedef"))
-			sidesPos[numsides++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "vertex"))
-			vertexesPos[numvertexes++] = M_TokenizerGetEndPos();
-		else if (fastcmp(tkn, "sector"))
-			sectorsPos[numsectors++] = M_TokenizerGetEndPos();
-		else
-			CONS_Alert(CONS_NOTICE, "Unknown field '%s'.\n", tkn);
+		switch (TextmapKey(&tkn))
+		{
+			case UDMF_THING:
+				mapthingsPos[nummapthings++] = (UINT32)numtextmapfields;
+				break;
+			case UDMF_LINEDEF:
+				linesPos[numlines++] = (UINT32)numtextmapfields;
+				break;
+			case UDMF_SIDEDEF:
+				sidesPos[numsides++] = (UINT32)numtextmapfields;
+				break;
+			case UDMF_VERTEX:
+				vertexesPos[numvertexes++] = (UINT32)numtextmapfields;
+				break;
+			case UDMF_SECTOR:
+				sectorsPos[numsectors++] = (UINT32)numtextmapfields;
+				break;
+			default:
+				CONS_Alert(CONS_NOTICE, "Unknown field '%.*s'.\n", (int)tkn.length, tkn.text);
+				continue;
+		}
+
+		closed = TextmapReadBlock(&scanner);
 	}
 
-	if (brackets)
+	if (!closed)
 	{
 		CONS_Alert(CONS_ERROR, "Unclosed brackets detected in textmap lump.\n");
 		return false;
@@ -1599,21 +1872,93 @@ static boolean TextmapCount(size_t size)
 	return true;
 }
 
-static void ParseTextmapVertexParameter(UINT32 i, const char *param, const char *val)
+/** Console command: times scanning the current level's TEXTMAP with the
+  * zero-copy scanner against the old copying tokenizer, and shows how long
+  * the last UDMF level load spent scanning and parsing.
+  */
+void P_TextmapBenchmark(void)
 {
-	if (fastcmp(param, "x"))
+	virtres_t *virt;
+	virtlump_t *textmap;
+	char *text;
+	INT32 iterations = 10, n;
+	size_t tokens = 0, keys = 0;
+	precise_t tokenizertime = 0, scannertime = 0, t;
+	const double ms = 1000.0 / I_GetPrecisePrecision();
+
+	if (gamestate != GS_LEVEL || !udmf)
+	{
+		CONS_Printf(M_GetText("You must be in a UDMF level to use this.\n"));
+		return;
+	}
+
+	if (COM_Argc() > 1)
+		iterations = max(1, atoi(COM_Argv(1)));
+
+	CONS_Printf(M_GetText("Last level load: scanned TEXTMAP in %.2f ms, parsed it in %.2f ms\n"),
+		textmapscantime * ms, textmapparsetime * ms);
+
+	virt = vres_GetMap(lastloadedmaplumpnum);
+	textmap = vres_Find(virt, "TEXTMAP");
+
+	// The old tokenizer needs a NUL-terminated copy.
+	text = Z_Malloc(textmap->size + 1, PU_STATIC, NULL);
+	M_Memcpy(text, textmap->data, textmap->size);
+	text[textmap->size] = '\0';
+
+	for (n = 0; n < iterations; n++)
+	{
+		textscanner_t scanner;
+		tokenview_t tkn;
+
+		t = I_GetPreciseTime();
+		M_TokenizerOpen(text);
+		while (M_TokenizerRead(0))
+			;
+		M_TokenizerClose();
+		tokenizertime += I_GetPreciseTime() - t;
+
+		t = I_GetPreciseTime();
+		tokens = keys = 0;
+		M_ScannerOpen(&scanner, (const char *)textmap->data, textmap->size);
+		while (M_ScannerRead(&scanner, &tkn))
+		{
+			if (TextmapKey(&tkn) != UDMF_UNKNOWN)
+				keys++;
+			tokens++;
+		}
+		scannertime += I_GetPreciseTime() - t;
+	}
+
+	CONS_Printf(M_GetText("TEXTMAP: %s bytes, %s tokens, %s keywords\n"), sizeu1(textmap->size), sizeu2(tokens), sizeu3(keys));
+
+	Z_Free(text);
+	vres_Free(virt);
+
+	CONS_Printf(M_GetText("Tokenizer: %.2f ms per pass\n"), tokenizertime * ms / iterations);
+	CONS_Printf(M_GetText("Scanner + keyword lookup: %.2f ms per pass\n"), scannertime * ms / iterations);
+}
+
+static void ParseTextmapVertexParameter(UINT32 i, udmfkey_t key, const char *val)
+{
+	switch (key)
+	{
+	case UDMF_X:
 		vertexes[i].x = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "y"))
+		break;
+	case UDMF_Y:
 		vertexes[i].y = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "zfloor"))
-	{
+		break;
+	case UDMF_ZFLOOR:
 		vertexes[i].floorz = FLOAT_TO_FIXED(atof(val));
 		vertexes[i].floorzset = true;
-	}
-	else if (fastcmp(param, "zceiling"))
-	{
+		break;
+	case UDMF_ZCEILING:
 		vertexes[i].ceilingz = FLOAT_TO_FIXED(atof(val));
 		vertexes[i].ceilingzset = true;
+		break;
+	default:
+		break;
 	}
 }
 
@@ -1646,29 +1991,43 @@ typedef struct textmap_plane_s {
 textmap_plane_t textmap_planefloor = {0, 0, 0, 0, 0};
 textmap_plane_t textmap_planeceiling = {0, 0, 0, 0, 0};
 
-static void ParseTextmapSectorParameter(UINT32 i, const char *param, const char *val)
+static void ParseTextmapSectorParameter(UINT32 i, udmfkey_t key, const char *val)
 {
-	if (fastcmp(param, "heightfloor"))
+	switch (key)
+	{
+	case UDMF_HEIGHTFLOOR:
 		sectors[i].floorheight = atol(val) << FRACBITS;
-	else if (fastcmp(param, "heightceiling"))
+		break;
+	case UDMF_HEIGHTCEILING:
 		sectors[i].ceilingheight = atol(val) << FRACBITS;
-	if (fastcmp(param, "texturefloor"))
+		break;
+	case UDMF_TEXTUREFLOOR:
 		sectors[i].floorpic = P_AddLevelFlat(val, foundflats);
-	else if (fastcmp(param, "textureceiling"))
+		break;
+	case UDMF_TEXTURECEILING:
 		sectors[i].ceilingpic = P_AddLevelFlat(val, foundflats);
-	else if (fastcmp(param, "lightlevel"))
+		break;
+	case UDMF_LIGHTLEVEL:
 		sectors[i].lightlevel = atol(val);
-	else if (fastcmp(param, "lightfloor"))
+		break;
+	case UDMF_LIGHTFLOOR:
 		sectors[i].floorlightlevel = atol(val);
-	else if (fastcmp(param, "lightfloorabsolute") && fastcmp("true", val))
-		sectors[i].floorlightabsolute = true;
-	else if (fastcmp(param, "lightceiling"))
+		break;
+	case UDMF_LIGHTFLOORABSOLUTE:
+		if (fastcmp("true", val))
+			sectors[i].floorlightabsolute = true;
+		break;
+	case UDMF_LIGHTCEILING:
 		sectors[i].ceilinglightlevel = atol(val);
-	else if (fastcmp(param, "lightceilingabsolute") && fastcmp("true", val))
-		sectors[i].ceilinglightabsolute = true;
-	else if (fastcmp(param, "id"))
+		break;
+	case UDMF_LIGHTCEILINGABSOLUTE:
+		if (fastcmp("true", val))
+			sectors[i].ceilinglightabsolute = true;
+		break;
+	case UDMF_ID:
 		Tag_FSet(&sectors[i].tags, atol(val));
-	else if (fastcmp(param, "moreids"))
+		break;
+	case UDMF_MOREIDS:
 	{
 		const char* id = val;
 		while (id)
@@ -1677,165 +2036,223 @@ static void ParseTextmapSectorParameter(UINT32 i, const char *param, const char
 			if ((id = strchr(id, ' ')))
 				id++;
 		}
-	}	
-	else if (fastcmp(param, "xpanningfloor"))
+		break;
+	}
+	case UDMF_XPANNINGFLOOR:
 		sectors[i].floorxoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "ypanningfloor"))
+		break;
+	case UDMF_YPANNINGFLOOR:
 		sectors[i].flooryoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "xpanningceiling"))
+		break;
+	case UDMF_XPANNINGCEILING:
 		sectors[i].ceilingxoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "ypanningceiling"))
+		break;
+	case UDMF_YPANNINGCEILING:
 		sectors[i].ceilingyoffset = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "rotationfloor"))
+		break;
+	case UDMF_ROTATIONFLOOR:
 		sectors[i].floorangle = FixedAngle(FLOAT_TO_FIXED(atof(val)));
-	else if (fastcmp(param, "rotationceiling"))
+		break;
+	case UDMF_ROTATIONCEILING:
 		sectors[i].ceilingangle = FixedAngle(FLOAT_TO_FIXED(atof(val)));
-	else if (fastcmp(param, "floorplane_a"))
-	{
+		break;
+	case UDMF_FLOORPLANE_A:
 		textmap_planefloor.defined |= PD_A;
 		textmap_planefloor.a = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "floorplane_b"))
-	{
+		break;
+	case UDMF_FLOORPLANE_B:
 		textmap_planefloor.defined |= PD_B;
 		textmap_planefloor.b = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "floorplane_c"))
-	{
+		break;
+	case UDMF_FLOORPLANE_C:
 		textmap_planefloor.defined |= PD_C;
 		textmap_planefloor.c = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "floorplane_d"))
-	{
+		break;
+	case UDMF_FLOORPLANE_D:
 		textmap_planefloor.defined |= PD_D;
 		textmap_planefloor.d = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_a"))
-	{
+		break;
+	case UDMF_CEILINGPLANE_A:
 		textmap_planeceiling.defined |= PD_A;
 		textmap_planeceiling.a = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_b"))
-	{
+		break;
+	case UDMF_CEILINGPLANE_B:
 		textmap_planeceiling.defined |= PD_B;
 		textmap_planeceiling.b = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_c"))
-	{
+		break;
+	case UDMF_CEILINGPLANE_C:
 		textmap_planeceiling.defined |= PD_C;
 		textmap_planeceiling.c = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "ceilingplane_d"))
-	{
+		break;
+	case UDMF_CEILINGPLANE_D:
 		textmap_planeceiling.defined |= PD_D;
 		textmap_planeceiling.d = FLOAT_TO_FIXED(atof(val));
-	}
-	else if (fastcmp(param, "lightcolor"))
-	{
+		break;
+	case UDMF_LIGHTCOLOR:
 		textmap_colormap.used = true;
 		textmap_colormap.lightcolor = atol(val);
-	}
-	else if (fastcmp(param, "lightalpha"))
-	{
+		break;
+	case UDMF_LIGHTALPHA:
 		textmap_colormap.used = true;
 		textmap_colormap.lightalpha = atol(val);
-	}
-	else if (fastcmp(param, "fadecolor"))
-	{
+		break;
+	case UDMF_FADECOLOR:
 		textmap_colormap.used = true;
 		textmap_colormap.fadecolor = atol(val);
-	}
-	else if (fastcmp(param, "fadealpha"))
-	{
+		break;
+	case UDMF_FADEALPHA:
 		textmap_colormap.used = true;
 		textmap_colormap.fadealpha = atol(val);
-	}
-	else if (fastcmp(param, "fadestart"))
-	{
+		break;
+	case UDMF_FADESTART:
 		textmap_colormap.used = true;
 		textmap_colormap.fadestart = atol(val);
-	}
-	else if (fastcmp(param, "fadeend"))
-	{
+		break;
+	case UDMF_FADEEND:
 		textmap_colormap.used = true;
 		textmap_colormap.fadeend = atol(val);
-	}
-	else if (fastcmp(param, "colormapfog") && fastcmp("true", val))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.flags |= CMF_FOG;
-	}
-	else if (fastcmp(param, "colormapfadesprites") && fastcmp("true", val))
-	{
-		textmap_colormap.used = true;
-		textmap_colormap.flags |= CMF_FADEFULLBRIGHTSPRITES;
-	}
-	else if (fastcmp(param, "colormapprotected") && fastcmp("true", val))
-		sectors[i].colormap_protected = true;
-	else if (fastcmp(param, "flipspecial_nofloor") && fastcmp("true", val))
-		sectors[i].flags &= ~MSF_FLIPSPECIAL_FLOOR;
-	else if (fastcmp(param, "flipspecial_ceiling") && fastcmp("true", val))
-		sectors[i].flags |= MSF_FLIPSPECIAL_CEILING;
-	else if (fastcmp(param, "triggerspecial_touch") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERSPECIAL_TOUCH;
-	else if (fastcmp(param, "triggerspecial_headbump") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERSPECIAL_HEADBUMP;
-	else if (fastcmp(param, "triggerline_plane") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERLINE_PLANE;
-	else if (fastcmp(param, "triggerline_mobj") && fastcmp("true", val))
-		sectors[i].flags |= MSF_TRIGGERLINE_MOBJ;
-	else if (fastcmp(param, "invertprecip") && fastcmp("true", val))
-		sectors[i].flags |= MSF_INVERTPRECIP;
-	else if (fastcmp(param, "gravityflip") && fastcmp("true", val))
-		sectors[i].flags |= MSF_GRAVITYFLIP;
-	else if (fastcmp(param, "heatwave") && fastcmp("true", val))
-		sectors[i].flags |= MSF_HEATWAVE;
-	else if (fastcmp(param, "noclipcamera") && fastcmp("true", val))
-		sectors[i].flags |= MSF_NOCLIPCAMERA;
-	else if (fastcmp(param, "outerspace") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_OUTERSPACE;
-	else if (fastcmp(param, "doublestepup") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_DOUBLESTEPUP;
-	else if (fastcmp(param, "nostepdown") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_NOSTEPDOWN;
-	else if (fastcmp(param, "speedpad") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_SPEEDPAD;
-	else if (fastcmp(param, "starpostactivator") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_STARPOSTACTIVATOR;
-	else if (fastcmp(param, "exit") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_EXIT;
-	else if (fastcmp(param, "specialstagepit") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_SPECIALSTAGEPIT;
-	else if (fastcmp(param, "returnflag") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_RETURNFLAG;
-	else if (fastcmp(param, "redteambase") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_REDTEAMBASE;
-	else if (fastcmp(param, "blueteambase") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_BLUETEAMBASE;
-	else if (fastcmp(param, "fan") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_FAN;
-	else if (fastcmp(param, "supertransform") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_SUPERTRANSFORM;
-	else if (fastcmp(param, "forcespin") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_FORCESPIN;
-	else if (fastcmp(param, "zoomtubestart") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_ZOOMTUBESTART;
-	else if (fastcmp(param, "zoomtubeend") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_ZOOMTUBEEND;
-	else if (fastcmp(param, "finishline") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_FINISHLINE;
-	else if (fastcmp(param, "ropehang") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_ROPEHANG;
-	else if (fastcmp(param, "jumpflip") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_JUMPFLIP;
-	else if (fastcmp(param, "gravityoverride") && fastcmp("true", val))
-		sectors[i].specialflags |= SSF_GRAVITYOVERRIDE;
-	else if (fastcmp(param, "friction"))
+		break;
+	case UDMF_COLORMAPFOG:
+		if (fastcmp("true", val))
+		{
+			textmap_colormap.used = true;
+			textmap_colormap.flags |= CMF_FOG;
+		}
+		break;
+	case UDMF_COLORMAPFADESPRITES:
+		if (fastcmp("true", val))
+		{
+			textmap_colormap.used = true;
+			textmap_colormap.flags |= CMF_FADEFULLBRIGHTSPRITES;
+		}
+		break;
+	case UDMF_COLORMAPPROTECTED:
+		if (fastcmp("true", val))
+			sectors[i].colormap_protected = true;
+		break;
+	case UDMF_FLIPSPECIAL_NOFLOOR:
+		if (fastcmp("true", val))
+			sectors[i].flags &= ~MSF_FLIPSPECIAL_FLOOR;
+		break;
+	case UDMF_FLIPSPECIAL_CEILING:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_FLIPSPECIAL_CEILING;
+		break;
+	case UDMF_TRIGGERSPECIAL_TOUCH:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_TRIGGERSPECIAL_TOUCH;
+		break;
+	case UDMF_TRIGGERSPECIAL_HEADBUMP:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_TRIGGERSPECIAL_HEADBUMP;
+		break;
+	case UDMF_TRIGGERLINE_PLANE:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_TRIGGERLINE_PLANE;
+		break;
+	case UDMF_TRIGGERLINE_MOBJ:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_TRIGGERLINE_MOBJ;
+		break;
+	case UDMF_INVERTPRECIP:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_INVERTPRECIP;
+		break;
+	case UDMF_GRAVITYFLIP:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_GRAVITYFLIP;
+		break;
+	case UDMF_HEATWAVE:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_HEATWAVE;
+		break;
+	case UDMF_NOCLIPCAMERA:
+		if (fastcmp("true", val))
+			sectors[i].flags |= MSF_NOCLIPCAMERA;
+		break;
+	case UDMF_OUTERSPACE:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_OUTERSPACE;
+		break;
+	case UDMF_DOUBLESTEPUP:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_DOUBLESTEPUP;
+		break;
+	case UDMF_NOSTEPDOWN:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_NOSTEPDOWN;
+		break;
+	case UDMF_SPEEDPAD:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_SPEEDPAD;
+		break;
+	case UDMF_STARPOSTACTIVATOR:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_STARPOSTACTIVATOR;
+		break;
+	case UDMF_EXIT:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_EXIT;
+		break;
+	case UDMF_SPECIALSTAGEPIT:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_SPECIALSTAGEPIT;
+		break;
+	case UDMF_RETURNFLAG:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_RETURNFLAG;
+		break;
+	case UDMF_REDTEAMBASE:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_REDTEAMBASE;
+		break;
+	case UDMF_BLUETEAMBASE:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_BLUETEAMBASE;
+		break;
+	case UDMF_FAN:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_FAN;
+		break;
+	case UDMF_SUPERTRANSFORM:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_SUPERTRANSFORM;
+		break;
+	case UDMF_FORCESPIN:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_FORCESPIN;
+		break;
+	case UDMF_ZOOMTUBESTART:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_ZOOMTUBESTART;
+		break;
+	case UDMF_ZOOMTUBEEND:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_ZOOMTUBEEND;
+		break;
+	case UDMF_FINISHLINE:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_FINISHLINE;
+		break;
+	case UDMF_ROPEHANG:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_ROPEHANG;
+		break;
+	case UDMF_JUMPFLIP:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_JUMPFLIP;
+		break;
+	case UDMF_GRAVITYOVERRIDE:
+		if (fastcmp("true", val))
+			sectors[i].specialflags |= SSF_GRAVITYOVERRIDE;
+		break;
+	case UDMF_FRICTION:
 		sectors[i].friction = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "gravity"))
+		break;
+	case UDMF_GRAVITY:
 		sectors[i].gravity = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "damagetype"))
-	{
+		break;
+	case UDMF_DAMAGETYPE:
 		if (fastcmp(val, "Generic"))
 			sectors[i].damagetype = SD_GENERIC;
 		if (fastcmp(val, "Water"))
@@ -1856,55 +2273,79 @@ static void ParseTextmapSectorParameter(UINT32 i, const char *param, const char
 			sectors[i].damagetype = SD_INSTAKILL;
 		if (fastcmp(val, "SpecialStage"))
 			sectors[i].damagetype = SD_SPECIALSTAGE;
-	}
-	else if (fastcmp(param, "triggertag"))
+		break;
+	case UDMF_TRIGGERTAG:
 		sectors[i].triggertag = atol(val);
-	else if (fastcmp(param, "triggerer"))
-	{
+		break;
+	case UDMF_TRIGGERER:
 		if (fastcmp(val, "Player"))
 			sectors[i].triggerer = TO_PLAYER;
 		if (fastcmp(val, "AllPlayers"))
 			sectors[i].triggerer = TO_ALLPLAYERS;
 		if (fastcmp(val, "Mobj"))
 			sectors[i].triggerer = TO_MOBJ;
+		break;
+	default:
+		break;
 	}
 }
 
-static void ParseTextmapSidedefParameter(UINT32 i, const char *param, const char *val)
+static void ParseTextmapSidedefParameter(UINT32 i, udmfkey_t key, const char *val)
 {
-	if (fastcmp(param, "offsetx"))
+	switch (key)
+	{
+	case UDMF_OFFSETX:
 		sides[i].textureoffset = atol(val)<<FRACBITS;
-	else if (fastcmp(param, "offsety"))
+		break;
+	case UDMF_OFFSETY:
 		sides[i].rowoffset = atol(val)<<FRACBITS;
-	else if (fastcmp(param, "offsetx_top"))
+		break;
+	case UDMF_OFFSETX_TOP:
 		sides[i].offsetx_top = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsetx_mid"))
+		break;
+	case UDMF_OFFSETX_MID:
 		sides[i].offsetx_mid = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsetx_bottom"))
+		break;
+	case UDMF_OFFSETX_BOTTOM:
 		sides[i].offsetx_bot = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsety_top"))
+		break;
+	case UDMF_OFFSETY_TOP:
 		sides[i].offsety_top = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsety_mid"))
+		break;
+	case UDMF_OFFSETY_MID:
 		sides[i].offsety_mid = atol(val) << FRACBITS;
-	else if (fastcmp(param, "offsety_bottom"))
+		break;
+	case UDMF_OFFSETY_BOTTOM:
 		sides[i].offsety_bot = atol(val) << FRACBITS;
-	else if (fastcmp(param, "texturetop"))
+		break;
+	case UDMF_TEXTURETOP:
 		sides[i].toptexture = R_TextureNumForName(val);
-	else if (fastcmp(param, "texturebottom"))
+		break;
+	case UDMF_TEXTUREBOTTOM:
 		sides[i].bottomtexture = R_TextureNumForName(val);
-	else if (fastcmp(param, "texturemiddle"))
+		break;
+	case UDMF_TEXTUREMIDDLE:
 		sides[i].midtexture = R_TextureNumForName(val);
-	else if (fastcmp(param, "sector"))
+		break;
+	case UDMF_SECTOR:
 		P_SetSidedefSector(i, atol(val));
-	else if (fastcmp(param, "repeatcnt"))
+		break;
+	case UDMF_REPEATCNT:
 		sides[i].repeatcnt = atol(val);
+		break;
+	default:
+		break;
+	}
 }
 
-static void ParseTextmapLinedefParameter(UINT32 i, const char *param, const char *val)
+static void ParseTextmapLinedefParameter(UINT32 i, udmfkey_t key, const char *val)
 {
-	if (fastcmp(param, "id"))
+	switch (key)
+	{
+	case UDMF_ID:
 		Tag_FSet(&lines[i].tags, atol(val));
-	else if (fastcmp(param, "moreids"))
+		break;
+	case UDMF_MOREIDS:
 	{
 		const char* id = val;
 		while (id)
@@ -1913,36 +2354,55 @@ static void ParseTextmapLinedefParameter(UINT32 i, const char *param, const char
 			if ((id = strchr(id, ' ')))
 				id++;
 		}
+		break;
 	}
-	else if (fastcmp(param, "special"))
+	case UDMF_SPECIAL:
 		lines[i].special = atol(val);
-	else if (fastcmp(param, "v1"))
+		break;
+	case UDMF_V1:
 		P_SetLinedefV1(i, atol(val));
-	else if (fastcmp(param, "v2"))
+		break;
+	case UDMF_V2:
 		P_SetLinedefV2(i, atol(val));
-	else if (fastncmp(param, "stringarg", 9) && strlen(param) > 9)
+		break;
+	case UDMF_STRINGARG0:
+	case UDMF_STRINGARG1:
 	{
-		size_t argnum = atol(param + 9);
+		size_t argnum = key - UDMF_STRINGARG0;
 		if (argnum >= NUMLINESTRINGARGS)
-			return;
+			break;
 		lines[i].stringargs[argnum] = Z_Malloc(strlen(val) + 1, PU_LEVEL, NULL);
 		M_Memcpy(lines[i].stringargs[argnum], val, strlen(val) + 1);
+		break;
 	}
-	else if (fastncmp(param, "arg", 3) && strlen(param) > 3)
-	{
-		size_t argnum = atol(param + 3);
+	case UDMF_ARG0:
+	case UDMF_ARG1:
+	case UDMF_ARG2:
+	case UDMF_ARG3:
+	case UDMF_ARG4:
+	case UDMF_ARG5:
+	case UDMF_ARG6:
+	case UDMF_ARG7:
+	case UDMF_ARG8:
+	case UDMF_ARG9:
+	{
+		size_t argnum = key - UDMF_ARG0;
 		if (argnum >= NUMLINEARGS)
-			return;
+			break;
 		lines[i].args[argnum] = atol(val);
+		break;
 	}
-	else if (fastcmp(param, "sidefront"))
+	case UDMF_SIDEFRONT:
 		lines[i].sidenum[0] = atol(val);
-	else if (fastcmp(param, "sideback"))
+		break;
+	case UDMF_SIDEBACK:
 		lines[i].sidenum[1] = atol(val);
-	else if (fastcmp(param, "alpha"))
+		break;
+	case UDMF_ALPHA:
 		lines[i].alpha = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "blendmode") || fastcmp(param, "renderstyle"))
-	{
+		break;
+	case UDMF_BLENDMODE:
+	case UDMF_RENDERSTYLE:
 		if (fastcmp(val, "translucent"))
 			lines[i].blendmode = AST_COPY;
 		else if (fastcmp(val, "add"))
@@ -1955,50 +2415,88 @@ static void ParseTextmapLinedefParameter(UINT32 i, const char *param, const char
 			lines[i].blendmode = AST_MODULATE;
 		if (fastcmp(val, "fog"))
 			lines[i].blendmode = AST_FOG;
-	}
-	else if (fastcmp(param, "executordelay"))
+		break;
+	case UDMF_EXECUTORDELAY:
 		lines[i].executordelay = atol(val);
-
+		break;
 	// Flags
-	else if (fastcmp(param, "blocking") && fastcmp("true", val))
-		lines[i].flags |= ML_IMPASSIBLE;
-	else if (fastcmp(param, "blockmonsters") && fastcmp("true", val))
-		lines[i].flags |= ML_BLOCKMONSTERS;
-	else if (fastcmp(param, "twosided") && fastcmp("true", val))
-		lines[i].flags |= ML_TWOSIDED;
-	else if (fastcmp(param, "dontpegtop") && fastcmp("true", val))
-		lines[i].flags |= ML_DONTPEGTOP;
-	else if (fastcmp(param, "dontpegbottom") && fastcmp("true", val))
-		lines[i].flags |= ML_DONTPEGBOTTOM;
-	else if (fastcmp(param, "skewtd") && fastcmp("true", val))
-		lines[i].flags |= ML_SKEWTD;
-	else if (fastcmp(param, "noclimb") && fastcmp("true", val))
-		lines[i].flags |= ML_NOCLIMB;
-	else if (fastcmp(param, "noskew") && fastcmp("true", val))
-		lines[i].flags |= ML_NOSKEW;
-	else if (fastcmp(param, "midpeg") && fastcmp("true", val))
-		lines[i].flags |= ML_MIDPEG;
-	else if (fastcmp(param, "midsolid") && fastcmp("true", val))
-		lines[i].flags |= ML_MIDSOLID;
-	else if (fastcmp(param, "wrapmidtex") && fastcmp("true", val))
-		lines[i].flags |= ML_WRAPMIDTEX;
-	/*else if (fastcmp(param, "effect6") && fastcmp("true", val))
-		lines[i].flags |= ML_EFFECT6;*/
-	else if (fastcmp(param, "nonet") && fastcmp("true", val))
-		lines[i].flags |= ML_NONET;
-	else if (fastcmp(param, "netonly") && fastcmp("true", val))
-		lines[i].flags |= ML_NETONLY;
-	else if (fastcmp(param, "bouncy") && fastcmp("true", val))
-		lines[i].flags |= ML_BOUNCY;
-	else if (fastcmp(param, "transfer") && fastcmp("true", val))
-		lines[i].flags |= ML_TFERLINE;
-}
-
-static void ParseTextmapThingParameter(UINT32 i, const char *param, const char *val)
-{
-	if (fastcmp(param, "id"))
+	case UDMF_BLOCKING:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_IMPASSIBLE;
+		break;
+	case UDMF_BLOCKMONSTERS:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_BLOCKMONSTERS;
+		break;
+	case UDMF_TWOSIDED:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_TWOSIDED;
+		break;
+	case UDMF_DONTPEGTOP:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_DONTPEGTOP;
+		break;
+	case UDMF_DONTPEGBOTTOM:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_DONTPEGBOTTOM;
+		break;
+	case UDMF_SKEWTD:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_SKEWTD;
+		break;
+	case UDMF_NOCLIMB:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_NOCLIMB;
+		break;
+	case UDMF_NOSKEW:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_NOSKEW;
+		break;
+	case UDMF_MIDPEG:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_MIDPEG;
+		break;
+	case UDMF_MIDSOLID:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_MIDSOLID;
+		break;
+	case UDMF_WRAPMIDTEX:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_WRAPMIDTEX;
+		break;
+	/*case UDMF_EFFECT6:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_EFFECT6;
+		break;*/
+	case UDMF_NONET:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_NONET;
+		break;
+	case UDMF_NETONLY:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_NETONLY;
+		break;
+	case UDMF_BOUNCY:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_BOUNCY;
+		break;
+	case UDMF_TRANSFER:
+		if (fastcmp("true", val))
+			lines[i].flags |= ML_TFERLINE;
+		break;
+	default:
+		break;
+	}
+}
+
+static void ParseTextmapThingParameter(UINT32 i, udmfkey_t key, const char *val)
+{
+	switch (key)
+	{
+	case UDMF_ID:
 		Tag_FSet(&mapthings[i].tags, atol(val));
-	else if (fastcmp(param, "moreids"))
+		break;
+	case UDMF_MOREIDS:
 	{
 		const char* id = val;
 		while (id)
@@ -2007,77 +2505,105 @@ static void ParseTextmapThingParameter(UINT32 i, const char *param, const char *
 			if ((id = strchr(id, ' ')))
 				id++;
 		}
+		break;
 	}
-	else if (fastcmp(param, "x"))
+	case UDMF_X:
 		mapthings[i].x = atol(val);
-	else if (fastcmp(param, "y"))
+		break;
+	case UDMF_Y:
 		mapthings[i].y = atol(val);
-	else if (fastcmp(param, "height"))
+		break;
+	case UDMF_HEIGHT:
 		mapthings[i].z = atol(val);
-	else if (fastcmp(param, "angle"))
+		break;
+	case UDMF_ANGLE:
 		mapthings[i].angle = atol(val);
-	else if (fastcmp(param, "pitch"))
+		break;
+	case UDMF_PITCH:
 		mapthings[i].pitch = atol(val);
-	else if (fastcmp(param, "roll"))
+		break;
+	case UDMF_ROLL:
 		mapthings[i].roll = atol(val);
-	else if (fastcmp(param, "type"))
+		break;
+	case UDMF_TYPE:
 		mapthings[i].type = atol(val);
-	else if (fastcmp(param, "scale"))
+		break;
+	case UDMF_SCALE:
 		mapthings[i].spritexscale = mapthings[i].spriteyscale = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "scalex"))
+		break;
+	case UDMF_SCALEX:
 		mapthings[i].spritexscale = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "scaley"))
+		break;
+	case UDMF_SCALEY:
 		mapthings[i].spriteyscale = FLOAT_TO_FIXED(atof(val));
-	else if (fastcmp(param, "mobjscale"))
+		break;
+	case UDMF_MOBJSCALE:
 		mapthings[i].scale = FLOAT_TO_FIXED(atof(val));
+		break;
 	// Flags
-	else if (fastcmp(param, "flip") && fastcmp("true", val))
-		mapthings[i].options |= MTF_OBJECTFLIP;
-	else if (fastcmp(param, "absolutez") && fastcmp("true", val))
-		mapthings[i].options |= MTF_ABSOLUTEZ;
-
-	else if (fastncmp(param, "stringarg", 9) && strlen(param) > 9)
+	case UDMF_FLIP:
+		if (fastcmp("true", val))
+			mapthings[i].options |= MTF_OBJECTFLIP;
+		break;
+	case UDMF_ABSOLUTEZ:
+		if (fastcmp("true", val))
+			mapthings[i].options |= MTF_ABSOLUTEZ;
+		break;
+	case UDMF_STRINGARG0:
+	case UDMF_STRINGARG1:
 	{
-		size_t argnum = atol(param + 9);
+		size_t argnum = key - UDMF_STRINGARG0;
 		if (argnum >= NUMMAPTHINGSTRINGARGS)
-			return;
+			break;
 		mapthings[i].stringargs[argnum] = Z_Malloc(strlen(val) + 1, PU_LEVEL, NULL);
 		M_Memcpy(mapthings[i].stringargs[argnum], val, strlen(val) + 1);
+		break;
 	}
-	else if (fastncmp(param, "arg", 3) && strlen(param) > 3)
-	{
-		size_t argnum = atol(param + 3);
+	case UDMF_ARG0:
+	case UDMF_ARG1:
+	case UDMF_ARG2:
+	case UDMF_ARG3:
+	case UDMF_ARG4:
+	case UDMF_ARG5:
+	case UDMF_ARG6:
+	case UDMF_ARG7:
+	case UDMF_ARG8:
+	case UDMF_ARG9:
+	{
+		size_t argnum = key - UDMF_ARG0;
 		if (argnum >= NUMMAPTHINGARGS)
-			return;
+			break;
 		mapthings[i].args[argnum] = atol(val);
+		break;
+	}
+	default:
+		break;
 	}
 }
 
-/** From a given position table, run a specified parser function through a {}-encapsuled text.
+/** From a given position table, run a specified parser function through the fields of a {}-encapsuled block.
   *
-  * \param Position of the data to parse, in the textmap.
+  * \param First field of the block, as stored by TextmapCount.
   * \param Structure number (mapthings, sectors, ...).
   * \param Parser function pointer.
   */
-static void TextmapParse(UINT32 dataPos, size_t num, void (*parser)(UINT32, const char *, const char *))
+static void TextmapParse(UINT32 firstField, size_t num, void (*parser)(UINT32, udmfkey_t, const char *))
 {
-	const char *param, *val;
+	const textmapfield_t *field;
+	char buf[256];
 
-	M_TokenizerSetEndPos(dataPos);
-	param = M_TokenizerRead(0);
-	if (!fastcmp(param, "{"))
+	for (field = &textmapfields[firstField]; field->key != UDMF_UNKNOWN; field++)
 	{
-		CONS_Alert(CONS_WARNING, "Invalid UDMF data capsule!\n");
-		return;
-	}
+		// The lump isn't NUL-terminated, so short values are copied to the stack.
+		char *val = (field->length < sizeof buf) ? buf : Z_Malloc(field->length + 1, PU_STATIC, NULL);
 
-	while (true)
-	{
-		param = M_TokenizerRead(0);
-		if (fastcmp(param, "}"))
-			break;
-		val = M_TokenizerRead(1);
-		parser(num, param, val);
+		M_Memcpy(val, textmapdata + field->value, field->length);
+		val[field->length] = '\0';
+
+		parser(num, field->key, val);
+
+		if (val != buf)
+			Z_Free(val);
 	}
 }
 
@@ -3088,10 +3614,15 @@ static boolean P_LoadMapData(const virtres_t *virt)
 	if (udmf) // Count how many entries for each type we got in textmap.
 	{
 		virtlump_t *textmap = vres_Find(virt, "TEXTMAP");
-		M_TokenizerOpen((char *)textmap->data);
-		if (!TextmapCount(textmap->size))
+		boolean counted;
+
+		textmapscantime = I_GetPreciseTime();
+		counted = TextmapCount((const char *)textmap->data, textmap->size);
+		textmapscantime = I_GetPreciseTime() - textmapscantime;
+
+		if (!counted)
 		{
-			M_TokenizerClose();
+			TextmapFreeFields();
 			return false;
 		}
 	}
@@ -3148,8 +3679,14 @@ static boolean P_LoadMapData(const virtres_t *virt)
 	// Load map data.
 	if (udmf)
 	{
+		textmapparsetime = I_GetPreciseTime();
 		P_LoadTextmap();
-		M_TokenizerClose();
+		textmapparsetime = I_GetPreciseTime() - textmapparsetime;
+		TextmapFreeFields();
+
+		CONS_Debug(DBG_SETUP, "TEXTMAP: scanned in %.2f ms, parsed in %.2f ms\n",
+			(double)textmapscantime * 1000.0 / I_GetPrecisePrecision(),
+			(double)textmapparsetime * 1000.0 / I_GetPrecisePrecision());
 	}
 	else
 	{
@@ -3739,9 +4276,10 @@ static boolean LineInBlock(fixed_t cx1, fixed_t cy1, fixed_t cx2, fixed_t cy2, f
 //
 // Please note: This section of code is not interchangable with TeamTNT's
 // code which attempts to fix the same problem.
-static void P_CreateBlockMap(void)
+static size_t P_CreateBlockMap(void)
 {
 	register size_t i;
+	size_t count;
 	fixed_t minx = INT32_MAX, miny = INT32_MAX, maxx = INT32_MIN, maxy = INT32_MIN;
 	// First find limits of map
 
@@ -3884,7 +4422,7 @@ static void P_CreateBlockMap(void)
 		//
 		// 4 words, unused if this routine is called, are reserved at the start.
 		{
-			size_t count = tot + 6; // we need at least 1 word per block, plus reserved's
+			count = tot + 6; // we need at least 1 word per block, plus reserved's
 
 			for (i = 0; i < tot; i++)
 				if (bmap[i].n)
@@ -3919,15 +4457,157 @@ static void P_CreateBlockMap(void)
 		}
 	}
 	{
-		size_t count = sizeof (*blocklinks) * bmapwidth * bmapheight;
+		size_t linkcount = sizeof (*blocklinks) * bmapwidth * bmapheight;
 		// clear out mobj chains (copied from from P_LoadBlockMap)
-		blocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+		blocklinks = Z_Calloc(linkcount, PU_LEVEL, NULL);
 		blockmap = blockmaplump + 4;
 
 		// haleyjd 2/22/06: setup polyobject blockmap
-		count = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
-		polyblocklinks = Z_Calloc(count, PU_LEVEL, NULL);
+		linkcount = sizeof(*polyblocklinks) * bmapwidth * bmapheight;
+		polyblocklinks = Z_Calloc(linkcount, PU_LEVEL, NULL);
 	}
+
+	return count;
+}
+
+//
+// Compiled map cache
+//
+// Blockmaps built by P_CreateBlockMap only depend on the map's geometry,
+// so they are saved under srb2home, keyed by the map's MD5, and loaded
+// back as-is the next time the same map is loaded.
+//
+
+#define MAPCACHEHEADER "SRB2MAPC"
+#define MAPCACHEVERSION 1
+#define MAPCACHEHEADERSIZE (8 + 2 + 16 + 4*6) // Magic, version, MD5, checksum, blockmap parameters
+
+consvar_t cv_mapcache = CVAR_INIT ("mapcache", "On", CV_SAVE, CV_OnOff, NULL);
+
+// Guards against MD5 collisions between binary maps that only differ in their
+// VERTEXES lump, which isn't part of mapmd5, and extra vertices from the nodes.
+static UINT32 P_MapGeometryChecksum(void)
+{
+	UINT32 sum = 2166136261u; // FNV-1a
+	size_t i;
+
+#define MIX(v) sum = (sum ^ (UINT32)(v)) * 16777619u
+	MIX(numvertexes);
+	MIX(numlines);
+	for (i = 0; i < numvertexes; i++)
+	{
+		MIX(vertexes[i].x);
+		MIX(vertexes[i].y);
+	}
+	for (i = 0; i < numlines; i++)
+	{
+		MIX(lines[i].v1 - vertexes);
+		MIX(lines[i].v2 - vertexes);
+	}
+#undef MIX
+
+	return sum;
+}
+
+static const char *P_MapCachePath(void)
+{
+	char md5hex[33];
+	INT32 i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(&md5hex[i*2], "%02x", mapmd5[i]);
+
+	return va("%s"PATHSEP"mapcache"PATHSEP"%s.dat", srb2home, md5hex);
+}
+
+static boolean P_LoadCachedBlockMap(void)
+{
+	UINT8 *buffer = NULL, *p;
+	size_t length, count, i;
+	UINT16 version;
+	UINT32 checksum;
+
+	if (!cv_mapcache.value)
+		return false;
+
+	length = FIL_ReadFile(P_MapCachePath(), &buffer);
+	if (!length)
+		return false;
+
+	if (length < MAPCACHEHEADERSIZE || memcmp(buffer, MAPCACHEHEADER, 8))
+	{
+		Z_Free(buffer);
+		return false;
+	}
+
+	p = buffer + 8;
+	version = READUINT16(p);
+	if (version != MAPCACHEVERSION || memcmp(p, mapmd5, 16))
+	{
+		Z_Free(buffer);
+		return false;
+	}
+
+	p += 16;
+	checksum = READUINT32(p);
+	bmaporgx = READINT32(p);
+	bmaporgy = READINT32(p);
+	bmapwidth = READINT32(p);
+	bmapheight = READINT32(p);
+	count = READUINT32(p);
+
+	if (checksum != P_MapGeometryChecksum() || bmapwidth <= 0 || bmapheight <= 0
+		|| count != (length - MAPCACHEHEADERSIZE) / sizeof (*blockmaplump))
+	{
+		Z_Free(buffer);
+		return false;
+	}
+
+	blockmaplump = Z_Malloc(sizeof (*blockmaplump) * count, PU_LEVEL, NULL);
+	for (i = 0; i < count; i++)
+		blockmaplump[i] = READINT32(p);
+	Z_Free(buffer);
+
+	// clear out mobj chains
+	blocklinks = Z_Calloc(sizeof (*blocklinks) * bmapwidth * bmapheight, PU_LEVEL, NULL);
+	blockmap = blockmaplump + 4;
+
+	// haleyjd 2/22/06: setup polyobject blockmap
+	polyblocklinks = Z_Calloc(sizeof(*polyblocklinks) * bmapwidth * bmapheight, PU_LEVEL, NULL);
+
+	CONS_Debug(DBG_SETUP, "P_LoadCachedBlockMap: loaded blockmap from %s\n", P_MapCachePath());
+	return true;
+}
+
+static void P_SaveCachedBlockMap(size_t count)
+{
+	UINT8 *buffer, *p;
+	size_t i;
+
+	if (!cv_mapcache.value)
+		return;
+
+	p = buffer = Z_Malloc(MAPCACHEHEADERSIZE + sizeof (*blockmaplump) * count, PU_STATIC, NULL);
+
+	M_Memcpy(p, MAPCACHEHEADER, 8);
+	p += 8;
+	WRITEUINT16(p, MAPCACHEVERSION);
+	M_Memcpy(p, mapmd5, 16);
+	p += 16;
+	WRITEUINT32(p, P_MapGeometryChecksum());
+	WRITEINT32(p, bmaporgx);
+	WRITEINT32(p, bmaporgy);
+	WRITEINT32(p, bmapwidth);
+	WRITEINT32(p, bmapheight);
+	WRITEUINT32(p, count);
+	for (i = 0; i < count; i++)
+		WRITEINT32(p, blockmaplump[i]);
+
+	I_mkdir(va("%s"PATHSEP"mapcache", srb2home), 0755);
+	if (!FIL_WriteFile(P_MapCachePath(), buffer, p - buffer))
+		CONS_Debug(DBG_SETUP, "P_SaveCachedBlockMap: couldn't write %s\n", P_MapCachePath());
+
+	Z_Free(buffer);
 }
 
 // PK3 version
@@ -3957,8 +4637,9 @@ static void P_LoadMapLUT(const virtres_t *virt)
 	else
 		rejectmatrix = NULL;
 
-	if (!(virtblockmap && P_LoadBlockMap(virtblockmap->data, virtblockmap->size)))
-		P_CreateBlockMap();
+	if (!(virtblockmap && P_LoadBlockMap(virtblockmap->data, virtblockmap->size))
+		&& !P_LoadCachedBlockMap())
+		P_SaveCachedBlockMap(P_CreateBlockMap());
 }
 
 //
@@ -6944,6 +7625,7 @@ static boolean P_LoadMapFromFile(void)
 
 	if (!P_LoadMapData(virt))
 		return false;
+	P_MakeMapMD5(virt, &mapmd5); // Also keys the compiled map cache
 	P_LoadMapBSP(virt);
 	P_LoadMapLUT(virt);
 
@@ -6970,8 +7652,6 @@ static boolean P_LoadMapFromFile(void)
 		if (sectors[i].tags.count)
 			spawnsectors[i].tags.tags = memcpy(Z_Malloc(sectors[i].tags.count*sizeof(mtag_t), PU_LEVEL, NULL), sectors[i].tags.tags, sectors[i].tags.count*sizeof(mtag_t));
 
-	P_MakeMapMD5(virt, &mapmd5);
-
 	vres_Free(virt);
 	return true;
 }
@@ -7633,6 +8313,7 @@ static void P_InitGametype(void)
 		P_LoadRecordGhosts();
 	else if (modeattacking == ATTACKING_NIGHTS && !demoplayback)
 		P_LoadNightsGhosts();
+	G_FinishGhosts();
 
 	if (G_TagGametype())
 		P_InitTagGametype();
@@ -7911,6 +8592,8 @@ boolean P_LoadLevel(boolean fromnetsave, boolean reloadinggamestate)
 
 	P_RunCachedActions();
 
+	S_PrecacheLevelSounds();
+
 	P_MapEnd(); // tmthing is no longer needed from this point onwards
 
 	// Took me 3 hours to figure out why my progression kept on getting overwritten with the titlemap...
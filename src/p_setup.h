@@ -20,6 +20,7 @@
 
 // map md5, sent to players via PT_SERVERINFO
 extern unsigned char mapmd5[16];
+extern consvar_t cv_mapcache;
 
 // Player spawn spots for deathmatch.
 #define MAX_DM_STARTS 64
@@ -99,6 +100,7 @@ void P_ScanThings(INT16 mapnum, INT16 wadnum, INT16 lumpnum);
 #endif
 void P_RespawnThings(void);
 boolean P_LoadLevel(boolean fromnetsave, boolean reloadinggamestate);
+void P_TextmapBenchmark(void);
 #ifdef HWRENDER
 void HWR_LoadLevel(void);
 #endif
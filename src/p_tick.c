@@ -781,6 +781,7 @@ void P_Ticker(boolean run)
 	if (run)
 	{
 		PS_START_TIMING(ps_thinkertime);
+		LUA_HookMobjThinkerBatch();
 		P_RunThinkers();
 		PS_STOP_TIMING(ps_thinkertime);
 
@@ -904,6 +905,9 @@ void P_Ticker(boolean run)
 
 	P_MapEnd();
 
+	if (run && demoplayback)
+		G_StoreDemoSnapshot();
+
 //	Z_CheckMemCleanup();
 }
 
@@ -944,6 +948,7 @@ void P_PreTicker(INT32 frames)
 				memcpy(&players[i].cmd, &temptic, sizeof(ticcmd_t));
 			}
 
+		LUA_HookMobjThinkerBatch();
 		P_RunThinkers();
 
 		// Run any "after all the other thinkers" stuff
@@ -1463,48 +1463,42 @@ static texture_t *R_ParseTexture(boolean actuallyLoadTexture)
 }
 
 // Parses the TEXTURES lump... but just to count the number of textures.
+// Only the top-level keywords matter here, so the lump is scanned in place
+// instead of being copied and parsed texture by texture; R_ParseTEXTURESLump
+// still complains about anything malformed.
 int R_CountTexturesInTEXTURESLump(UINT16 wadNum, UINT16 lumpNum)
 {
 	char *texturesLump;
-	size_t texturesLumpLength;
-	char *texturesText;
+	textscanner_t scanner;
+	tokenview_t tkn;
 	UINT32 numTexturesInLump = 0;
-	char *texturesToken;
+	UINT32 brackets = 0;
 
-	// Since lumps AREN'T \0-terminated like I'd assumed they should be, I'll
-	// need to make a space of memory where I can ensure that it will terminate
-	// correctly. Start by loading the relevant data from the WAD.
 	texturesLump = (char *)W_CacheLumpNumPwad(wadNum, lumpNum, PU_STATIC);
 	// If that didn't exist, we have nothing to do here.
 	if (texturesLump == NULL) return 0;
-	// If we're still here, then it DOES exist; figure out how long it is, and allot memory accordingly.
-	texturesLumpLength = W_LumpLengthPwad(wadNum, lumpNum);
-	texturesText = (char *)Z_Malloc((texturesLumpLength+1)*sizeof(char),PU_STATIC,NULL);
-	// Now move the contents of the lump into this new location.
-	memmove(texturesText,texturesLump,texturesLumpLength);
-	// Make damn well sure the last character in our new memory location is \0.
-	texturesText[texturesLumpLength] = '\0';
-	// Finally, free up the memory from the first data load, because we really
-	// don't need it.
-	Z_Free(texturesLump);
 
-	texturesToken = M_GetToken(texturesText);
-	while (texturesToken != NULL)
+	M_ScannerOpen(&scanner, texturesLump, W_LumpLengthPwad(wadNum, lumpNum));
+	while (M_ScannerRead(&scanner, &tkn))
 	{
-		if (stricmp(texturesToken, "WALLTEXTURE") == 0 || stricmp(texturesToken, "TEXTURE") == 0)
+		if (tkn.quoted)
+			continue;
+		else if (M_TokenIs(&tkn, "{"))
+			brackets++;
+		else if (M_TokenIs(&tkn, "}"))
 		{
-			numTexturesInLump++;
-			Z_Free(texturesToken);
-			R_ParseTexture(false);
+			if (brackets)
+				brackets--;
 		}
-		else
+		else if (!brackets && (M_TokenIsI(&tkn, "WALLTEXTURE") || M_TokenIsI(&tkn, "TEXTURE")))
 		{
-			I_Error("Error parsing TEXTURES lump: Expected \"WALLTEXTURE\" or \"TEXTURE\", got \"%s\"",texturesToken);
+			numTexturesInLump++;
+			// Skip the name, in case a texture is called TEXTURE.
+			M_ScannerRead(&scanner, &tkn);
 		}
-		texturesToken = M_GetToken(NULL);
 	}
-	Z_Free(texturesToken);
-	Z_Free((void *)texturesText);
+
+	Z_Free(texturesLump);
 
 	return numTexturesInLump;
 }
@@ -159,10 +159,23 @@ consvar_t cv_modfilter = CVAR_INIT ("modfilter", "0", CV_SAVE|CV_CALL, interpola
 // percent attenuation from front to back
 #define S_IFRACVOL 30
 
+// smallest volume or separation change worth sending to the mixer
+#define S_PARAM_THRESHOLD 2
+
 // the set of channels available
 static channel_t *channels = NULL;
 static INT32 numofchannels = 0;
 
+// Busy channels as a min-heap on (priority, volume), so the voice
+// to kick out for a more important sound is always voiceheap[0].
+static INT32 *voiceheap = NULL;
+static INT32 *voiceheappos = NULL; // channel -> heap slot, or -1
+static INT32 voiceheapsize = 0;
+
+// listeners as of the last S_UpdateSounds
+static listener_t lastlistener, lastlistener2;
+static mobj_t *lastlistenmobj, *lastlistenmobj2;
+
 caption_t closedcaptions[NUMCAPTIONS];
 
 void S_ResetCaptions(void)
@@ -182,6 +195,89 @@ void S_ResetCaptions(void)
 //
 static void S_StopChannel(INT32 cnum);
 
+//
+// Voice priority heap
+//
+static boolean S_VoiceLess(INT32 a, INT32 b)
+{
+	const channel_t *ca = &channels[a];
+	const channel_t *cb = &channels[b];
+
+	if (ca->sfxinfo->priority != cb->sfxinfo->priority)
+		return (ca->sfxinfo->priority < cb->sfxinfo->priority);
+	return (ca->lastvolume < cb->lastvolume);
+}
+
+static void S_VoiceHeapSet(INT32 slot, INT32 cnum)
+{
+	voiceheap[slot] = cnum;
+	voiceheappos[cnum] = slot;
+}
+
+static void S_VoiceHeapSift(INT32 slot)
+{
+	INT32 cnum = voiceheap[slot];
+	INT32 child;
+
+	// up
+	while (slot > 0 && S_VoiceLess(cnum, voiceheap[(slot - 1)/2]))
+	{
+		S_VoiceHeapSet(slot, voiceheap[(slot - 1)/2]);
+		slot = (slot - 1)/2;
+	}
+
+	// down
+	while ((child = slot*2 + 1) < voiceheapsize)
+	{
+		if (child + 1 < voiceheapsize && S_VoiceLess(voiceheap[child + 1], voiceheap[child]))
+			child++;
+		if (!S_VoiceLess(voiceheap[child], cnum))
+			break;
+		S_VoiceHeapSet(slot, voiceheap[child]);
+		slot = child;
+	}
+
+	S_VoiceHeapSet(slot, cnum);
+}
+
+static void S_VoiceHeapInsert(INT32 cnum)
+{
+	S_VoiceHeapSet(voiceheapsize++, cnum);
+	S_VoiceHeapSift(voiceheapsize - 1);
+}
+
+static void S_VoiceHeapRemove(INT32 cnum)
+{
+	INT32 slot = voiceheappos[cnum];
+
+	if (slot < 0)
+		return;
+
+	voiceheappos[cnum] = -1;
+	if (slot == --voiceheapsize)
+		return;
+
+	S_VoiceHeapSet(slot, voiceheap[voiceheapsize]);
+	S_VoiceHeapSift(slot);
+}
+
+//
+// S_SetChannelParams
+//
+// Remembers what the mixer was last told about a channel.
+//
+static void S_SetChannelParams(INT32 cnum, INT32 volume, INT32 sep, INT32 pitch)
+{
+	channel_t *c = &channels[cnum];
+
+	c->lastvolume = volume;
+	c->lastsep = sep;
+	c->lastpitch = pitch;
+
+	if (voiceheappos[cnum] >= 0)
+		S_VoiceHeapSift(voiceheappos[cnum]);
+}
+
 //
 // S_getChannel
 //
@@ -232,12 +328,8 @@ static INT32 S_getChannel(const void *origin, sfxinfo_t *sfxinfo)
 	// None available
 	if (cnum == numofchannels)
 	{
-		// Look for lower priority
-		for (cnum = 0; cnum < numofchannels; cnum++)
-			if (channels[cnum].sfxinfo->priority <= sfxinfo->priority)
-				break;
-
-		if (cnum == numofchannels)
+		// Look for lower priority, the quietest one first
+		if (!voiceheapsize || channels[voiceheap[0]].sfxinfo->priority > sfxinfo->priority)
 		{
 			// No lower priority. Sorry, Charlie.
 			return -1;
@@ -245,6 +337,7 @@ static INT32 S_getChannel(const void *origin, sfxinfo_t *sfxinfo)
 		else
 		{
 			// Otherwise, kick out lower priority.
+			cnum = voiceheap[0];
 			S_StopChannel(cnum);
 		}
 	}
@@ -254,10 +347,245 @@ static INT32 S_getChannel(const void *origin, sfxinfo_t *sfxinfo)
 	// channel is decided to be cnum.
 	c->sfxinfo = sfxinfo;
 	c->origin = origin;
+	c->lastvolume = 255;
+	c->spatialized = false;
+	S_VoiceHeapInsert(cnum);
 
 	return cnum;
 }
 
+//
+// S_UpdateChannelParams
+//
+// Skips the mixer call when nothing changed enough to hear.
+//
+static void S_UpdateChannelParams(INT32 cnum, INT32 volume, INT32 sep, INT32 pitch)
+{
+	channel_t *c = &channels[cnum];
+
+	if (abs(volume - c->lastvolume) < S_PARAM_THRESHOLD
+		&& abs(sep - c->lastsep) < S_PARAM_THRESHOLD
+		&& pitch == c->lastpitch)
+		return;
+
+	I_UpdateSoundParams(c->handle, volume, sep, pitch);
+	S_SetChannelParams(cnum, volume, sep, pitch);
+}
+
+//
+// Sound effect cache
+//
+// Decoded sound effects are kept within sfxcachesize megabytes, dropping
+// the least recently played ones first. Sounds the level's objects can make
+// are queued when it loads and decoded ahead of their first play: as many
+// as fit in SFXPREWARMLOADTIME while loading, the rest SFXPREWARMFRAMETIME
+// at a time from S_UpdateSounds.
+//
+
+#define SFXPREWARMLOADTIME 100 // milliseconds
+#define SFXPREWARMFRAMETIME 1 // milliseconds
+
+static CV_PossibleValue_t sfxcachesize_cons_t[] = {{1, "MIN"}, {1024, "MAX"}, {0, NULL}};
+consvar_t cv_sfxcachesize = CVAR_INIT ("sfxcachesize", "64", CV_SAVE, sfxcachesize_cons_t, NULL);
+
+static UINT32 sfxclock; // bumped every time a sound is used
+static UINT32 sfxlastused[NUMSFX];
+static UINT32 sfxcachehits, sfxcachemisses, sfxcacheprewarms;
+
+static UINT16 sfxprewarmqueue[NUMSFX];
+static boolean sfxprewarmqueued[NUMSFX];
+static size_t sfxprewarmlen, sfxprewarmpos;
+
+static size_t S_SfxCacheSize(size_t *count)
+{
+	size_t i, size = 0;
+
+	if (count)
+		*count = 0;
+
+	for (i = 1; i < NUMSFX; i++)
+		if (S_sfx[i].data)
+		{
+			size += S_sfx[i].length;
+			if (count)
+				(*count)++;
+		}
+
+	return size;
+}
+
+static boolean S_SfxPlaying(sfxinfo_t *sfx)
+{
+	INT32 cnum;
+
+	for (cnum = 0; cnum < numofchannels; cnum++)
+		if (channels[cnum].sfxinfo == sfx)
+			return true;
+
+	return false;
+}
+
+// Frees the least recently used sounds until the cache is within its budget.
+static void S_TrimSfxCache(sfxinfo_t *keep)
+{
+	const size_t budget = (size_t)cv_sfxcachesize.value << 20;
+	size_t size = S_SfxCacheSize(NULL);
+
+	while (size > budget)
+	{
+		sfxinfo_t *oldest = NULL;
+		size_t i;
+
+		for (i = 1; i < NUMSFX; i++)
+		{
+			sfxinfo_t *sfx = &S_sfx[i];
+			if (!sfx->data || sfx == keep || S_SfxPlaying(sfx))
+				continue;
+			if (!oldest || sfxlastused[i] < sfxlastused[oldest - S_sfx])
+				oldest = sfx;
+		}
+
+		if (!oldest)
+			break;
+
+		size -= oldest->length;
+		I_FreeSfx(oldest);
+	}
+}
+
+// Makes sure a sound is decoded before playing it.
+static void S_CacheSfx(sfxinfo_t *sfx)
+{
+	sfxlastused[sfx - S_sfx] = ++sfxclock;
+
+	if (sfx->data)
+	{
+		sfxcachehits++;
+		return;
+	}
+
+	sfxcachemisses++;
+	sfx->data = I_GetSfx(sfx);
+	if (sfx->data)
+		S_TrimSfxCache(sfx);
+}
+
+static void S_QueueSfx(INT32 id)
+{
+	if (id <= sfx_None || id >= NUMSFX || !S_sfx[id].name || S_sfx[id].data || sfxprewarmqueued[id])
+		return;
+
+	sfxprewarmqueued[id] = true;
+	sfxprewarmqueue[sfxprewarmlen++] = (UINT16)id;
+}
+
+// Queues the sounds of an object type, including A_PlaySound calls in its states.
+static void S_QueueMobjSfx(mobjtype_t type, UINT8 *statesseen)
+{
+	const mobjinfo_t *info = &mobjinfo[type];
+	const statenum_t firststates[] = {
+		info->spawnstate, info->seestate, info->painstate, info->meleestate,
+		info->missilestate, info->deathstate, info->xdeathstate, info->raisestate
+	};
+	size_t i;
+
+	S_QueueSfx(info->seesound);
+	S_QueueSfx(info->attacksound);
+	S_QueueSfx(info->painsound);
+	S_QueueSfx(info->deathsound);
+	S_QueueSfx(info->activesound);
+
+	for (i = 0; i < sizeof firststates / sizeof *firststates; i++)
+	{
+		statenum_t st;
+		for (st = firststates[i]; st > S_NULL && st < NUMSTATES && !statesseen[st]; st = states[st].nextstate)
+		{
+			statesseen[st] = 1;
+			if (states[st].action.acp1 == (actionf_p1)A_PlaySound)
+				S_QueueSfx(states[st].var1);
+		}
+	}
+}
+
+// Decodes queued sounds for up to budget, unless the cache is full.
+static void S_PrewarmSfx(precise_t budget)
+{
+	const precise_t start = I_GetPreciseTime();
+	const size_t cachesize = (size_t)cv_sfxcachesize.value << 20;
+
+	while (sfxprewarmpos < sfxprewarmlen)
+	{
+		sfxinfo_t *sfx = &S_sfx[sfxprewarmqueue[sfxprewarmpos]];
+
+		if (S_SfxCacheSize(NULL) >= cachesize)
+		{
+			sfxprewarmpos = sfxprewarmlen; // don't push out sounds that were actually played
+			break;
+		}
+
+		sfxprewarmqueued[sfxprewarmqueue[sfxprewarmpos++]] = false;
+		if (!sfx->data)
+		{
+			sfx->data = I_GetSfx(sfx);
+			sfxcacheprewarms++;
+		}
+
+		if (I_GetPreciseTime() - start >= budget)
+			break;
+	}
+
+	if (sfxprewarmpos == sfxprewarmlen)
+	{
+		while (sfxprewarmlen)
+			sfxprewarmqueued[sfxprewarmqueue[--sfxprewarmlen]] = false;
+		sfxprewarmpos = 0;
+	}
+}
+
+// Queues up the sounds used by the level's objects, and decodes what it can right away.
+void S_PrecacheLevelSounds(void)
+{
+	UINT8 *typesseen, *statesseen;
+	thinker_t *th;
+
+	if (sound_disabled || dedicated)
+		return;
+
+	typesseen = Z_Calloc(NUMMOBJTYPES, PU_STATIC, NULL);
+	statesseen = Z_Calloc(NUMSTATES, PU_STATIC, NULL);
+
+	S_QueueMobjSfx(MT_PLAYER, statesseen);
+	typesseen[MT_PLAYER] = 1;
+
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+	{
+		mobj_t *mo = (mobj_t *)th;
+
+		if (th->function.acp1 == (actionf_p1)P_RemoveThinkerDelayed || typesseen[mo->type])
+			continue;
+
+		typesseen[mo->type] = 1;
+		S_QueueMobjSfx(mo->type, statesseen);
+	}
+
+	Z_Free(typesseen);
+	Z_Free(statesseen);
+
+	S_PrewarmSfx(SFXPREWARMLOADTIME * (I_GetPrecisePrecision() / 1000));
+}
+
+static void Command_SfxCache_f(void)
+{
+	size_t count, size = S_SfxCacheSize(&count);
+	UINT32 plays = sfxcachehits + sfxcachemisses;
+
+	CONS_Printf(M_GetText("%s sounds cached, %s / %d KB\n"), sizeu1(count), sizeu2(size >> 10), cv_sfxcachesize.value << 10);
+	CONS_Printf(M_GetText("%u hits, %u misses (%u%% hit rate), %u decoded ahead of time\n"),
+		sfxcachehits, sfxcachemisses, plays ? (UINT32)((UINT64)sfxcachehits * 100 / plays) : 0, sfxcacheprewarms);
+	if (sfxprewarmpos < sfxprewarmlen)
+		CONS_Printf(M_GetText("%s sounds left to decode\n"), sizeu1(sfxprewarmlen - sfxprewarmpos));
+}
+
 void S_RegisterSoundStuff(void)
 {
 	if (dedicated)
@@ -268,6 +596,7 @@ void S_RegisterSoundStuff(void)
 
 	CV_RegisterVar(&stereoreverse);
 	CV_RegisterVar(&precachesound);
+	CV_RegisterVar(&cv_sfxcachesize);
 
 	CV_RegisterVar(&surround);
 	CV_RegisterVar(&cv_samplerate);
@@ -291,6 +620,7 @@ void S_RegisterSoundStuff(void)
 
 	COM_AddCommand("tunes", Command_Tunes_f, COM_LUA);
 	COM_AddCommand("restartaudio", Command_RestartAudio_f, COM_LUA);
+	COM_AddCommand("sfxcache", Command_SfxCache_f, 0);
 }
 
 static void SetChannelsNum(void)
@@ -305,6 +635,11 @@ static void SetChannelsNum(void)
 
 	Z_Free(channels);
 	channels = NULL;
+	Z_Free(voiceheap);
+	voiceheap = NULL;
+	Z_Free(voiceheappos);
+	voiceheappos = NULL;
+	voiceheapsize = 0;
 
 
 	if (cv_numChannels.value == 999999999) //Alam_GBC: OH MY ROD!(ROD rimmiced with GOD!)
@@ -318,12 +653,19 @@ static void SetChannelsNum(void)
 	}
 #endif
 	if (cv_numChannels.value)
+	{
 		channels = (channel_t *)Z_Malloc(cv_numChannels.value * sizeof (channel_t), PU_STATIC, NULL);
+		voiceheap = (INT32 *)Z_Malloc(cv_numChannels.value * sizeof (INT32), PU_STATIC, NULL);
+		voiceheappos = (INT32 *)Z_Malloc(cv_numChannels.value * sizeof (INT32), PU_STATIC, NULL);
+	}
 	numofchannels = cv_numChannels.value;
 
 	// Free all channels for use
 	for (i = 0; i < numofchannels; i++)
+	{
 		channels[i].sfxinfo = 0;
+		voiceheappos[i] = -1;
+	}
 
 	S_ResetCaptions();
 }
@@ -642,8 +984,7 @@ void S_StartSoundAtVolume(const void *origin_p, sfxenum_t sfx_id, INT32 volume)
 
 		// cache data if necessary
 		// NOTE: set sfx->data NULL sfx->lump -1 to force a reload
-		if (!sfx->data)
-			sfx->data = I_GetSfx(sfx);
+		S_CacheSfx(sfx);
 
 		// increase the usefulness
 		if (sfx->usefulness++ < 0)
@@ -664,6 +1005,7 @@ void S_StartSoundAtVolume(const void *origin_p, sfxenum_t sfx_id, INT32 volume)
 		// Assigns the handle to one of the channels in the
 		// mix/output buffer.
 		channels[cnum].handle = I_StartSound(sfx_id, volume, sep, pitch, priority, cnum);
+		S_SetChannelParams(cnum, volume, sep, pitch);
 	}
 
 dontplay:
@@ -695,8 +1037,7 @@ dontplay:
 
 	// cache data if necessary
 	// NOTE: set sfx->data NULL sfx->lump -1 to force a reload
-	if (!sfx->data)
-		sfx->data = I_GetSfx(sfx);
+	S_CacheSfx(sfx);
 
 	// increase the usefulness
 	if (sfx->usefulness++ < 0)
@@ -718,6 +1059,7 @@ dontplay:
 	// mix/output buffer.
 	channels[cnum].volume = initial_volume;
 	channels[cnum].handle = I_StartSound(sfx_id, volume, sep, pitch, priority, cnum);
+	S_SetChannelParams(cnum, volume, sep, pitch);
 }
 
 void S_StartSound(const void *origin, sfxenum_t sfx_id)
@@ -832,6 +1174,7 @@ void S_UpdateSounds(void)
 {
 	INT32 audible, cnum, volume, sep, pitch;
 	channel_t *c;
+	boolean listenersmoved;
 
 	listener_t listener;
 	listener_t listener2;
@@ -864,6 +1207,9 @@ void S_UpdateSounds(void)
 	if (dedicated || sound_disabled)
 		return;
 
+	if (sfxprewarmlen)
+		S_PrewarmSfx(SFXPREWARMFRAMETIME * (I_GetPrecisePrecision() / 1000));
+
 	if (players[displayplayer].awayviewtics)
 		listenmobj = players[displayplayer].awayviewmobj;
 
@@ -919,6 +1265,15 @@ void S_UpdateSounds(void)
 		}
 	}
 
+	listenersmoved = (listenmobj != lastlistenmobj || listenmobj2 != lastlistenmobj2
+		|| memcmp(&listener, &lastlistener, sizeof (listener_t))
+		|| memcmp(&listener2, &lastlistener2, sizeof (listener_t)));
+
+	lastlistenmobj = listenmobj;
+	lastlistenmobj2 = listenmobj2;
+	lastlistener = listener;
+	lastlistener2 = listener2;
+
 	for (cnum = 0; cnum < numofchannels; cnum++)
 	{
 		c = &channels[cnum];
@@ -937,11 +1292,22 @@ void S_UpdateSounds(void)
 				if (c->origin && ((c->origin != players[consoleplayer].mo) ||
 					(splitscreen && c->origin != players[secondarydisplayplayer].mo)))
 				{
+					const mobj_t *soundmobj = c->origin;
+
+					// Neither the sound nor anyone listening has moved,
+					// so the parameters from last time still stand.
+					if (c->spatialized && !listenersmoved
+						&& soundmobj->x == c->lastx && soundmobj->y == c->lasty && soundmobj->z == c->lastz)
+						continue;
+
+					c->spatialized = true;
+					c->lastx = soundmobj->x;
+					c->lasty = soundmobj->y;
+					c->lastz = soundmobj->z;
+
 					// Whomever is closer gets the sound, but only in splitscreen.
 					if (listenmobj && listenmobj2 && splitscreen)
 					{
-						const mobj_t *soundmobj = c->origin;
-
 						fixed_t dist1, dist2;
 						dist1 = P_AproxDistance(listener.x-soundmobj->x, listener.y-soundmobj->y);
 						dist2 = P_AproxDistance(listener2.x-soundmobj->x, listener2.y-soundmobj->y);
@@ -960,7 +1326,7 @@ void S_UpdateSounds(void)
 						}
 
 						if (audible)
-							I_UpdateSoundParams(c->handle, volume, sep, pitch);
+							S_UpdateChannelParams(cnum, volume, sep, pitch);
 						else
 							S_StopChannel(cnum);
 					}
@@ -971,7 +1337,7 @@ void S_UpdateSounds(void)
 							c->sfxinfo);
 
 						if (audible)
-							I_UpdateSoundParams(c->handle, volume, sep, pitch);
+							S_UpdateChannelParams(cnum, volume, sep, pitch);
 						else
 							S_StopChannel(cnum);
 					}
@@ -1051,6 +1417,7 @@ static void S_StopChannel(INT32 cnum)
 		// degrade usefulness of sound data
 		c->sfxinfo->usefulness--;
 		c->sfxinfo = 0;
+		S_VoiceHeapRemove(cnum);
 	}
 
 	c->origin = NULL;
@@ -2633,7 +3000,6 @@ void MusicPref_OnChange(void)
 #ifdef HAVE_OPENMPT
 void ModFilter_OnChange(void)
 {
-	if (openmpt_mhandle)
-		openmpt_module_set_render_param(openmpt_mhandle, OPENMPT_MODULE_RENDER_INTERPOLATIONFILTER_LENGTH, cv_modfilter.value);
+	I_SetModFilter(cv_modfilter.value);
 }
 #endif
@@ -61,6 +61,8 @@ extern consvar_t cv_midisoundfontpath;
 extern consvar_t cv_miditimiditypath;
 #endif
 
+extern consvar_t cv_sfxcachesize;
+
 extern CV_PossibleValue_t soundvolume_cons_t[];
 
 typedef enum
@@ -93,6 +95,14 @@ typedef struct
 	// handle of the sound being played
 	INT32 handle;
 
+	// parameters last sent to the mixer
+	INT32 lastvolume, lastsep, lastpitch;
+
+	// where the origin was when they were worked out;
+	// spatialized is false until the first update
+	fixed_t lastx, lasty, lastz;
+	boolean spatialized;
+
 } channel_t;
 
 typedef struct {
@@ -125,6 +135,7 @@ void S_InitSfxChannels(INT32 sfxVolume);
 //
 void S_StopSounds(void);
 void S_ClearSfx(void);
+void S_PrecacheLevelSounds(void);
 void S_StartEx(boolean reset);
 #define S_Start() S_StartEx(false)
 
@@ -255,6 +255,162 @@ SDL_bool framebuffer = SDL_FALSE;
 
 UINT8 keyboard_started = false;
 
+#ifdef LOGMESSAGES
+//
+// Log writer
+//
+// Messages are copied into a ring buffer and written out by a thread, so
+// printing every tic doesn't stall on fwrite and fflush. The thread sleeps
+// while the ring is empty and only exits to be flushed. I_SyncLog switches
+// back to writing directly, for I_Error and shutdown. Signal handlers use
+// I_SyncLogNoWait instead, since the crash may be in the writer itself.
+//
+#define LOGRINGSIZE (64*1024)
+
+static boolean logsync = false;
+static boolean lognowait = false; // don't wait on the writer thread either
+
+#ifdef HAVE_THREADS
+static char logring[LOGRINGSIZE];
+static char logwritebuf[LOGRINGSIZE]; // only touched by the writer thread
+static size_t logringhead, logringused;
+static boolean logwriting; // writer thread running
+static boolean logquit; // writer should exit once the ring is empty
+
+static I_mutex log_mutex;
+static I_cond  log_cond;
+
+static void I_LogWriterThread(void *userdata)
+{
+	char *buf = logwritebuf;
+	size_t len, tail;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		I_lock_mutex(&log_mutex);
+		{
+			while (!logringused && !logquit)
+				I_hold_cond(&log_cond, log_mutex);
+
+			len = logringused;
+			if (!len)
+			{
+				logwriting = false;
+				I_wake_all_cond(&log_cond);
+				I_unlock_mutex(log_mutex);
+				return;
+			}
+
+			tail = (logringhead + LOGRINGSIZE - len) % LOGRINGSIZE;
+			if (tail + len > LOGRINGSIZE)
+			{
+				M_Memcpy(buf, &logring[tail], LOGRINGSIZE - tail);
+				M_Memcpy(&buf[LOGRINGSIZE - tail], logring, len - (LOGRINGSIZE - tail));
+			}
+			else
+				M_Memcpy(buf, &logring[tail], len);
+
+			logringused = 0;
+			I_wake_all_cond(&log_cond); // there's room again
+		}
+		I_unlock_mutex(log_mutex);
+
+		if (logstream)
+		{
+			size_t d = fwrite(buf, len, 1, logstream);
+			fflush(logstream);
+			(void)d;
+		}
+	}
+}
+#endif
+
+// Waits until everything queued so far is in the log file, and for the
+// writer to exit. The next message queued starts it again.
+static void I_FlushLog(void)
+{
+#ifdef HAVE_THREADS
+	if (I_thread_is_stopped())
+		return; // the writer has been joined
+	I_lock_mutex(&log_mutex);
+	if (logwriting)
+	{
+		logquit = true;
+		I_wake_all_cond(&log_cond);
+		while (logwriting)
+			I_hold_cond(&log_cond, log_mutex);
+		logquit = false;
+	}
+	I_unlock_mutex(log_mutex);
+#endif
+}
+
+// Writes everything from here on directly, after what's already queued.
+static void I_SyncLog(void)
+{
+	I_FlushLog();
+	logsync = true;
+}
+
+// Writes everything from here on directly, without taking the log mutex.
+// Whatever is still queued may come out after this, or not at all.
+static void I_SyncLogNoWait(void)
+{
+	lognowait = true;
+	logsync = true;
+}
+
+static void I_WriteLog(const char *txt, size_t len)
+{
+	if (!logstream)
+		return;
+
+#ifdef HAVE_THREADS
+	if (!logsync && len <= LOGRINGSIZE && !I_thread_is_stopped())
+	{
+		I_lock_mutex(&log_mutex);
+		{
+			while (logringused + len > LOGRINGSIZE && logwriting)
+				I_hold_cond(&log_cond, log_mutex);
+
+			if (logringused + len <= LOGRINGSIZE)
+			{
+				size_t first = min(len, LOGRINGSIZE - logringhead);
+				boolean wasempty = (logringused == 0);
+
+				M_Memcpy(&logring[logringhead], txt, first);
+				M_Memcpy(logring, txt + first, len - first);
+				logringhead = (logringhead + len) % LOGRINGSIZE;
+				logringused += len;
+
+				if (!logwriting)
+				{
+					logwriting = true;
+					I_spawn_thread("log-writer", (I_thread_fn)I_LogWriterThread, NULL);
+				}
+				else if (wasempty)
+					I_wake_all_cond(&log_cond); // the writer is waiting for this
+
+				I_unlock_mutex(log_mutex);
+				return;
+			}
+		}
+		I_unlock_mutex(log_mutex);
+	}
+#endif
+
+	if (!lognowait)
+		I_FlushLog();
+	{
+		size_t d = fwrite(txt, len, 1, logstream);
+		fflush(logstream);
+		(void)d;
+	}
+}
+#endif
+
 #ifdef UNIXBACKTRACE
 #define STDERR_WRITE(string) if (fd != -1) I_OutputMsg("%s", string)
 #define CRASHLOG_WRITE(string) if (fd != -1) junk = write(fd, string, strlen(string))
@@ -418,6 +574,9 @@ static void I_ReportSignal(int num, int coredumped)
 #ifndef NEWSIGNALHANDLER
 FUNCNORETURN static ATTRNORETURN void signal_handler(INT32 num)
 {
+#ifdef LOGMESSAGES
+	I_SyncLogNoWait();
+#endif
 	D_QuitNetGame(); // Fix server freezes
 	CL_AbortDownloadResume();
 #ifdef UNIXBACKTRACE
@@ -843,6 +1002,9 @@ static void I_RegisterSignals (void)
 #ifdef NEWSIGNALHANDLER
 static void signal_handler_child(INT32 num)
 {
+#ifdef LOGMESSAGES
+	I_SyncLogNoWait();
+#endif
 #ifdef UNIXBACKTRACE
 	write_backtrace(num);
 #endif
@@ -891,12 +1053,7 @@ void I_OutputMsg(const char *fmt, ...)
 	len = strlen(txt);
 
 #ifdef LOGMESSAGES
-	if (logstream)
-	{
-		size_t d = fwrite(txt, len, 1, logstream);
-		fflush(logstream);
-		(void)d;
-	}
+	I_WriteLog(txt, len);
 #endif
 
 #if defined (_WIN32)
@@ -2154,6 +2311,10 @@ static void I_Fork(void)
 	int signum;
 	int c;
 
+#ifdef LOGMESSAGES
+	I_FlushLog(); // the writer thread doesn't come along
+#endif
+
 	child = fork();
 
 	switch (child)
@@ -2224,6 +2385,9 @@ INT32 I_StartupSystem(void)
 #ifdef HAVE_THREADS
 	I_start_threads();
 	I_AddExitFunc(I_stop_threads);
+#ifdef LOGMESSAGES
+	I_AddExitFunc(I_SyncLog); // lets the log writer go before it's joined
+#endif
 #endif
 	I_StartupConsole();
 	I_SetupSignalHandler();
@@ -2363,6 +2527,10 @@ void I_Error(const char *error, ...)
 
 	shutdowning = true;
 
+#ifdef LOGMESSAGES
+	I_SyncLog();
+#endif
+
 	// Display error message in the console before we start shutting it down
 	va_start(argptr, error);
 	vsprintf(buffer, error, argptr);
@@ -2622,6 +2790,7 @@ void I_ShutdownSystem(void)
 		if (quit_funcs[c])
 			(*quit_funcs[c])();
 #ifdef LOGMESSAGES
+	I_SyncLog();
 	if (logstream)
 	{
 		I_OutputMsg("I_ShutdownSystem(): end of logstream.\n");
@@ -16,6 +16,8 @@
 
 typedef void * (*Create_fn)(void);
 
+#define MAX_JOB_THREADS 16
+
 struct Link;
 struct Thread;
 
@@ -197,6 +199,87 @@ I_thread_is_stopped (void)
 	return ( ! SDL_AtomicGet(&i_threads_running) );
 }
 
+struct Jobs
+{
+	I_job_fn       fn;
+	void         * userdata;
+	size_t         count;
+	SDL_atomic_t   next;
+};
+
+static int
+Job_worker (
+		struct Jobs * jobs
+){
+	int index;
+
+	while (( index = SDL_AtomicAdd(&jobs->next, 1) ) < (int)jobs->count)
+		(*jobs->fn)(jobs->userdata, index);
+
+	return 0;
+}
+
+int
+I_job_threads (void)
+{
+	int n = SDL_GetCPUCount();
+
+	if (n < 1)
+		n = 1;
+	else if (n > MAX_JOB_THREADS)
+		n = MAX_JOB_THREADS;
+
+	return n;
+}
+
+void
+I_parallel_jobs (
+		size_t     count,
+		I_job_fn   fn,
+		void     * userdata
+){
+	SDL_Thread  * threads[MAX_JOB_THREADS];
+	struct Jobs   jobs;
+	int           n;
+	int           i;
+
+	if (! count)
+		return;
+
+	jobs.fn       = fn;
+	jobs.userdata = userdata;
+	jobs.count    = count;
+	SDL_AtomicSet(&jobs.next, 0);
+
+	/* the calling thread takes jobs too */
+	n = I_job_threads() - 1;
+
+	if ((size_t)n > count - 1)
+		n = (int)count - 1;
+
+	if (! SDL_AtomicGet(&i_threads_running))
+		n = 0;
+
+	for (i = 0; i < n; ++i)
+	{
+		threads[i] = SDL_CreateThread(
+				(SDL_ThreadFunction)Job_worker,
+				"parallel-job",
+				&jobs
+		);
+
+		if (! threads[i])
+			break;
+	}
+
+	n = i;
+
+	Job_worker(&jobs);
+
+	for (i = 0; i < n; ++i)
+		SDL_WaitThread(threads[i], NULL);
+}
+
 void
 I_start_threads (void)
 {
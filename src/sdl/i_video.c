@@ -172,6 +172,10 @@ static      INT32        mousemovex = 0, mousemovey = 0;
 static      SDL_Surface *vidSurface = NULL;
 static      SDL_Surface *bufSurface = NULL;
 static      SDL_Color    localPalette[256];
+static      UINT32       presentPalette32[256];
+static      UINT16       presentPalette16[256];
+static       SDL_bool    presentPaletteDirty = SDL_TRUE;
+static      INT32        textureScale = 1;
 static       SDL_bool    mousegrabok = SDL_TRUE;
 static       SDL_bool    wrapmouseok = SDL_FALSE;
 #define HalfWarpMouse(x,y) if (wrapmouseok) SDL_WarpMouseInWindow(window, (Uint16)(x/2),(Uint16)(y/2))
@@ -202,6 +206,7 @@ static void Impl_VideoSetupBuffer(void);
 static void Impl_SetupSoftwareBuffer(void);
 
 static void Impl_BlitSurfaceRegion(void);
+static void Impl_PresentTexture(void);
 
 static void Impl_InitOpenGL(void);
 
@@ -328,6 +333,7 @@ static SDL_bool Impl_RenderContextReset(void)
 	{
 		SDL_DestroyRenderer(renderer);
 		texture = NULL; // Destroying a renderer also destroys all of its textures
+		textureScale = 1;
 	}
 	renderer = NULL;
 
@@ -406,6 +412,7 @@ static void Impl_VideoSetupSurfaces(int width, int height)
 
 		SDL_PixelFormatEnumToMasks(sw_texture_format, &bpp, &rmask, &gmask, &bmask, &amask);
 		vidSurface = SDL_CreateRGBSurface(0, width, height, bpp, rmask, gmask, bmask, amask);
+		presentPaletteDirty = SDL_TRUE;
 	}
 }
 
@@ -732,6 +739,42 @@ static void VID_Command_Info_f (void)
 	SurfaceInfo(vidSurface, M_GetText("Current Video Mode"));
 }
 
+// Time the software presentation path on its own, re-presenting the
+// current screen without running the renderer.
+static void VID_Command_PresentBench_f(void)
+{
+	INT32 frames = 300, i;
+	precise_t start, blittime = 0, presenttime = 0;
+	double usperunit = 1000000.0 / I_GetPrecisePrecision();
+
+	if (rendermode != render_soft || !screens[0])
+	{
+		CONS_Printf(M_GetText("vid_presentbench is only available in Software mode\n"));
+		return;
+	}
+
+	if (COM_Argc() > 1)
+		frames = max(1, atoi(COM_Argv(1)));
+
+	if (!bufSurface)
+		Impl_VideoSetupBuffer();
+
+	for (i = 0; i < frames; i++)
+	{
+		start = I_GetPreciseTime();
+		Impl_BlitSurfaceRegion();
+		blittime += I_GetPreciseTime() - start;
+
+		start = I_GetPreciseTime();
+		Impl_PresentTexture();
+		presenttime += I_GetPreciseTime() - start;
+	}
+
+	CONS_Printf(M_GetText("%d frames at %dx%d (x%d): %.1f us blit, %.1f us present per frame\n"),
+		frames, vid.width, vid.height, textureScale,
+		(double)blittime * usperunit / frames, (double)presenttime * usperunit / frames);
+}
+
 static void VID_Command_ModeList_f(void)
 {
 	for (INT32 i = 0; i < MAXWINMODES; i++)
@@ -1746,6 +1789,20 @@ void I_OsPolling(void)
 	if (mod & KMOD_CAPS) capslock = true;
 }
 
+static void Impl_PresentTexture(void)
+{
+	SDL_Rect rect;
+
+	rect.x = src_rect.x * textureScale;
+	rect.y = src_rect.y * textureScale;
+	rect.w = src_rect.w * textureScale;
+	rect.h = src_rect.h * textureScale;
+
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, texture, &rect, NULL);
+	SDL_RenderPresent(renderer);
+}
+
 //
 // I_UpdateNoBlit
 //
@@ -1791,10 +1848,7 @@ void I_FinishUpdate(void)
 			Impl_VideoSetupBuffer();
 
 		Impl_BlitSurfaceRegion();
-
-		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, texture, &src_rect, NULL);
-		SDL_RenderPresent(renderer);
+		Impl_PresentTexture();
 	}
 #ifdef HWRENDER
 	else if (rendermode == render_opengl)
@@ -1841,6 +1895,7 @@ void I_SetPalette(RGBA_t *palette)
 	//if (vidSurface) SDL_SetPaletteColors(vidSurface->format->palette, localPalette, 0, 256);
 	// Fury -- SDL2 vidSurface is a 32-bit surface buffer copied to the texture. It's not palletized, like bufSurface.
 	if (bufSurface) SDL_SetPaletteColors(bufSurface->format->palette, localPalette, 0, 256);
+	presentPaletteDirty = SDL_TRUE;
 }
 
 // return number of fullscreen + X11 modes
@@ -2077,8 +2132,102 @@ INT32 VID_SetMode(INT32 modeNum)
 	return SDL_TRUE;
 }
 
+// Pick how many times the software screen is upscaled before it's handed to
+// the renderer. Only SDL's software renderer (-softblit) benefits, since
+// it would otherwise scale the texture on the CPU with a generic scaler.
+static INT32 Impl_GetPresentScale(void)
+{
+	int outwidth, outheight;
+	INT32 scale;
+
+	if (!usesdl2soft || !realwidth || !realheight)
+		return 1;
+	if (SDL_GetRendererOutputSize(renderer, &outwidth, &outheight) != 0)
+		return 1;
+
+	scale = min(outwidth / realwidth, outheight / realheight);
+	return max(1, min(scale, 4));
+}
+
+static void Impl_SetTextureScale(INT32 scale)
+{
+	Uint32 format;
+
+	if (scale == textureScale || texture == NULL)
+		return;
+
+	if (SDL_QueryTexture(texture, &format, NULL, NULL, NULL) != 0)
+		return;
+
+	SDL_DestroyTexture(texture);
+	texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, realwidth * scale, realheight * scale);
+	if (texture == NULL)
+	{
+		// Go back to an unscaled texture
+		texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, realwidth, realheight);
+		scale = 1;
+	}
+
+	textureScale = scale;
+}
+
+static void Impl_UpdatePresentPalette(void)
+{
+	size_t i;
+
+	for (i = 0; i < 256; i++)
+	{
+		Uint32 color = SDL_MapRGB(vidSurface->format, localPalette[i].r, localPalette[i].g, localPalette[i].b);
+		presentPalette32[i] = color;
+		presentPalette16[i] = (UINT16)color;
+	}
+
+	presentPaletteDirty = SDL_FALSE;
+}
+
+// Expand the 8bpp screen straight into the streaming texture through the
+// palette LUT, skipping the intermediate SDL_BlitSurface to vidSurface.
+static SDL_bool Impl_BlitPalettedRegion(void)
+{
+	SDL_Rect rect;
+	const UINT8 *src;
+	void *pixels;
+	int pitch;
+
+	Impl_SetTextureScale(Impl_GetPresentScale());
+
+	if (presentPaletteDirty)
+		Impl_UpdatePresentPalette();
+
+	rect.x = src_rect.x * textureScale;
+	rect.y = src_rect.y * textureScale;
+	rect.w = src_rect.w * textureScale;
+	rect.h = src_rect.h * textureScale;
+
+	if (SDL_LockTexture(texture, &rect, &pixels, &pitch) != 0)
+		return SDL_FALSE;
+
+	src = (UINT8 *)bufSurface->pixels + (src_rect.y * bufSurface->pitch) + src_rect.x;
+
+	if (vidSurface->format->BytesPerPixel == 4)
+		VID_BlitPalettedScreen32(src, pixels, src_rect.w, src_rect.h, bufSurface->pitch, pitch, textureScale, presentPalette32);
+	else
+		VID_BlitPalettedScreen16(src, pixels, src_rect.w, src_rect.h, bufSurface->pitch, pitch, textureScale, presentPalette16);
+
+	SDL_UnlockTexture(texture);
+	return SDL_TRUE;
+}
+
 static void Impl_BlitSurfaceRegion(void)
 {
+	if (bufSurface->format->BitsPerPixel == 8 && vidSurface->format->BytesPerPixel >= 2)
+	{
+		if (Impl_BlitPalettedRegion())
+			return;
+	}
+
+	Impl_SetTextureScale(1);
+
 	SDL_BlitSurface(bufSurface, &src_rect, vidSurface, &src_rect);
 	// Fury -- there's no way around UpdateTexture, the GL backend uses it anyway
 	SDL_LockSurface(vidSurface);
@@ -2282,6 +2431,7 @@ void I_StartupGraphics(void)
 	COM_AddCommand ("vid_info", VID_Command_Info_f, COM_LUA);
 	COM_AddCommand ("vid_modelist", VID_Command_ModeList_f, COM_LUA);
 	COM_AddCommand ("vid_mode", VID_Command_Mode_f, 0);
+	COM_AddCommand ("vid_presentbench", VID_Command_PresentBench_f, 0);
 	CV_RegisterVar (&cv_vidwait);
 	CV_RegisterVar (&cv_stretch);
 #ifdef DITHER
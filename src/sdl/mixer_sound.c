@@ -40,6 +40,7 @@
 #include "../w_wad.h"
 #include "../z_zone.h"
 #include "../byteptr.h"
+#include "../i_threads.h"
 
 #if defined(HAVE_MIXERX) && defined(__ANDROID__)
 #include "../d_main.h" // srb2home
@@ -134,6 +135,38 @@ static size_t probesize;
 static int result;
 #endif
 
+#if defined (HAVE_THREADS) && (defined (HAVE_GME) || defined (HAVE_OPENMPT))
+#define MUSIC_DECODE_THREAD
+
+// GME and OpenMPT songs are rendered ahead on their own thread into this
+// ring, so a slow chunk never stalls the audio callback. Only the decoder
+// thread moves the head and only the callback moves the tail.
+#define MUSICRING_SAMPLES 16384 // power of two, ~186ms of 44.1kHz stereo
+#define MUSICRING_CHUNK 2048 // divides MUSICRING_SAMPLES, so a chunk never wraps
+
+static INT16 musicring[MUSICRING_SAMPLES];
+static SDL_atomic_t musicring_head;
+static SDL_atomic_t musicring_tail;
+static SDL_atomic_t musicring_flush; // callback drops what is buffered
+
+static I_mutex decoder_mutex; // guards the gme/openmpt handles
+static I_cond decoder_cond;
+static boolean decoder_threaded; // set while a decoder thread feeds the ring
+static boolean decoder_running;
+static boolean decoder_quit;
+#ifdef HAVE_GME
+static INT32 decoder_starttrack = -1; // gme_start_track can be slow, so the thread does it
+#endif
+
+static void StopDecoder(void);
+
+#  define Lock_decoder()   I_lock_mutex(&decoder_mutex)
+#  define Unlock_decoder() I_unlock_mutex(decoder_mutex)
+#else
+#  define Lock_decoder()   SDL_LockAudio()
+#  define Unlock_decoder() SDL_UnlockAudio()
+#endif
+
 #ifdef HAVE_MIXERX
 static const char *Midiplayer_GetSoundFontPath(void)
 {
@@ -360,6 +393,9 @@ void I_ShutdownSound(void)
 
 	SDL_QuitSubSystem(SDL_INIT_AUDIO);
 
+#ifdef MUSIC_DECODE_THREAD
+	StopDecoder();
+#endif
 #ifdef HAVE_GME
 	if (gme)
 		gme_delete(gme);
@@ -497,7 +533,7 @@ static Mix_Chunk *ds2chunk(void *stream)
 	return Mix_QuickLoad_RAW(sound, (Uint32)((UINT8*)d-sound));
 }
 
-void *I_GetSfx(sfxinfo_t *sfx)
+static Mix_Chunk *LoadSfx(sfxinfo_t *sfx)
 {
 	void *lump;
 	Mix_Chunk *chunk;
@@ -615,6 +651,16 @@ void *I_GetSfx(sfxinfo_t *sfx)
 	return NULL; // haven't been able to get anything
 }
 
+void *I_GetSfx(sfxinfo_t *sfx)
+{
+	Mix_Chunk *chunk = LoadSfx(sfx);
+
+	// From here on, length is the size of the decoded sound, like in sdl_sound.c.
+	// The sound cache in s_sound.c budgets by it.
+	sfx->length = chunk ? chunk->alen : 0;
+	return chunk;
+}
+
 void I_FreeSfx(sfxinfo_t *sfx)
 {
 	if (sfx->data)
@@ -777,21 +823,188 @@ static UINT32 music_fade(UINT32 interval, void *param)
 	}
 }
 
+#if defined (HAVE_GME) || defined (HAVE_OPENMPT)
+// Renders the next samples of the GME or OpenMPT song.
+// Returns false once there is nothing left to play.
+static boolean DecodeMusic(short *out, int samples)
+{
 #ifdef HAVE_GME
-static void mix_gme(void *udata, Uint8 *stream, int len)
+	if (gme)
+	{
+#ifdef MUSIC_DECODE_THREAD
+		if (decoder_starttrack >= 0)
+		{
+			gme_err_t gme_e = gme_start_track(gme, decoder_starttrack);
+			if (gme_e != NULL)
+				CONS_Alert(CONS_ERROR, "GME error: %s\n", gme_e);
+			decoder_starttrack = -1;
+		}
+#endif
+		if (gme_track_ended(gme))
+			return false;
+		gme_play(gme, samples, out);
+		return true;
+	}
+#endif
+#ifdef HAVE_OPENMPT
+	if (openmpt_mhandle)
+	{
+		size_t frames = openmpt_module_read_interleaved_stereo(openmpt_mhandle, SAMPLERATE, samples/2, out);
+		if (frames < (size_t)samples/2)
+			memset(out + frames*2, 0, (samples - frames*2) * sizeof (*out));
+		return (frames > 0);
+	}
+#endif
+	return false;
+}
+
+#ifdef MUSIC_DECODE_THREAD
+static void DecoderThread(void *userdata)
+{
+	UINT32 head, tail;
+	boolean decoded;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		decoded = false;
+
+		Lock_decoder();
+		{
+			if (decoder_quit || I_thread_is_stopped())
+			{
+				decoder_running = false;
+				I_wake_all_cond(&decoder_cond);
+				Unlock_decoder();
+				return;
+			}
+
+			// Nothing is written while a flush is pending, so the callback
+			// only ever throws away audio from before the seek.
+			if (!SDL_AtomicGet(&musicring_flush))
+			{
+				head = (UINT32)SDL_AtomicGet(&musicring_head);
+				tail = (UINT32)SDL_AtomicGet(&musicring_tail);
+
+				if (MUSICRING_SAMPLES - (head - tail) >= MUSICRING_CHUNK
+					&& DecodeMusic(&musicring[head & (MUSICRING_SAMPLES-1)], MUSICRING_CHUNK))
+				{
+					SDL_AtomicSet(&musicring_head, (int)(head + MUSICRING_CHUNK)); // full barrier
+					decoded = true;
+				}
+			}
+		}
+		Unlock_decoder();
+
+		// Ring is full, song ended or paused: one chunk lasts ~23ms
+		if (!decoded)
+			SDL_Delay(5);
+	}
+}
+
+static void StartDecoder(void)
+{
+	SDL_AtomicSet(&musicring_head, 0);
+	SDL_AtomicSet(&musicring_tail, 0);
+	SDL_AtomicSet(&musicring_flush, 0);
+
+	// Threads are already gone during shutdown; decode in the callback then
+	decoder_threaded = !I_thread_is_stopped();
+	if (decoder_threaded)
+	{
+		decoder_quit = false;
+		decoder_running = true;
+		I_spawn_thread("music-decoder", (I_thread_fn)DecoderThread, NULL);
+	}
+}
+
+// Only call once the hook is removed, so the callback no longer reads the ring.
+static void StopDecoder(void)
+{
+	if (!decoder_threaded)
+		return;
+
+	Lock_decoder();
+	{
+		decoder_quit = true;
+		while (decoder_running)
+			I_hold_cond(&decoder_cond, decoder_mutex);
+	}
+	Unlock_decoder();
+
+	decoder_threaded = false;
+}
+
+// Call with the decoder locked, after repositioning the song.
+static void FlushDecoder(void)
+{
+	SDL_AtomicSet(&musicring_flush, 1);
+}
+
+// How far the decoder has run ahead of what is being heard.
+static UINT32 DecoderLatencyMS(void)
+{
+	UINT32 buffered;
+
+	if (!decoder_threaded)
+		return 0;
+
+	buffered = (UINT32)SDL_AtomicGet(&musicring_head) - (UINT32)SDL_AtomicGet(&musicring_tail);
+	return buffered * 500 / SAMPLERATE; // stereo
+}
+
+static boolean ReadMusicRing(short *out, int samples)
+{
+	UINT32 head, tail, avail, pos, n;
+
+	if (SDL_AtomicGet(&musicring_flush))
+	{
+		SDL_AtomicSet(&musicring_tail, SDL_AtomicGet(&musicring_head));
+		SDL_AtomicSet(&musicring_flush, 0);
+	}
+
+	head = (UINT32)SDL_AtomicGet(&musicring_head);
+	tail = (UINT32)SDL_AtomicGet(&musicring_tail);
+	avail = min(head - tail, (UINT32)samples);
+
+	if (!avail) // decoder fell behind or the song ended
+		return false;
+
+	pos = tail & (MUSICRING_SAMPLES-1);
+	n = min(avail, MUSICRING_SAMPLES - pos);
+	memcpy(out, &musicring[pos], n * sizeof (*out));
+	memcpy(out + n, musicring, (avail - n) * sizeof (*out));
+	if (avail < (UINT32)samples)
+		memset(out + avail, 0, (samples - avail) * sizeof (*out));
+
+	SDL_AtomicSet(&musicring_tail, (int)(tail + avail));
+	return true;
+}
+#endif
+
+static void mix_decoded(Uint8 *stream, int len)
 {
 	int i;
 	short *p;
+	boolean played;
 
-	(void)udata;
+#ifdef MUSIC_DECODE_THREAD
+	if (decoder_threaded)
+		played = ReadMusicRing((short *)stream, len/2);
+	else
+	{
+		Lock_decoder();
+		played = DecodeMusic((short *)stream, len/2);
+		Unlock_decoder();
+	}
+#else
+	played = DecodeMusic((short *)stream, len/2);
+#endif
 
-	// no gme? no music.
-	if (!gme || gme_track_ended(gme) || songpaused)
+	if (!played)
 		return;
 
-	// play gme into stream
-	gme_play(gme, len/2, (short *)stream);
-
 	// Limiter to prevent music from being disorted with some formats
 	if (music_volume >= 18)
 		music_volume = 18;
@@ -802,27 +1015,28 @@ static void mix_gme(void *udata, Uint8 *stream, int len)
 }
 #endif
 
+#ifdef HAVE_GME
+static void mix_gme(void *udata, Uint8 *stream, int len)
+{
+	(void)udata;
+
+	// no gme? no music.
+	if (!gme || songpaused)
+		return;
+
+	mix_decoded(stream, len);
+}
+#endif
+
 #ifdef HAVE_OPENMPT
 static void mix_openmpt(void *udata, Uint8 *stream, int len)
 {
-	int i;
-	short *p;
-
 	(void)udata;
 
 	if (!openmpt_mhandle || songpaused)
 		return;
 
-	// Play module into stream
-	openmpt_module_read_interleaved_stereo(openmpt_mhandle, SAMPLERATE, BUFFERSIZE, (short *)stream);
-
-	// Limiter to prevent music from being disorted with some formats
-	if (music_volume >= 18)
-		music_volume = 18;
-
-	// apply volume to stream
-	for (i = 0, p = (short *)stream; i < len/2; i++, p++)
-		*p = ((INT32)*p) * (music_volume*internal_volume/100)*2 / 40;
+	mix_decoded(stream, len);
 }
 #endif
 
@@ -902,9 +1116,9 @@ boolean I_SetSongSpeed(float speed)
 #ifdef HAVE_GME
 	if (gme)
 	{
-		SDL_LockAudio();
+		Lock_decoder();
 		gme_set_tempo(gme, speed);
-		SDL_UnlockAudio();
+		Unlock_decoder();
 		return true;
 	}
 	else
@@ -914,6 +1128,7 @@ boolean I_SetSongSpeed(float speed)
 	{
 		if (speed > 4.0f)
 			speed = 4.0f; // Limit this to 4x to prevent crashing, stupid fix but... ~SteelT 27/9/19
+		Lock_decoder();
 #if OPENMPT_API_VERSION_MAJOR < 1 && OPENMPT_API_VERSION_MINOR < 5
 		{
 			// deprecated in 0.5.0
@@ -924,6 +1139,7 @@ boolean I_SetSongSpeed(float speed)
 #else
 		openmpt_module_ctl_set_floatingpoint(openmpt_mhandle, "play.tempo_factor", (double)speed);
 #endif
+		Unlock_decoder();
 		return true;
 	}
 #else
@@ -933,6 +1149,20 @@ boolean I_SetSongSpeed(float speed)
 	return false;
 }
 
+void I_SetModFilter(INT32 filter)
+{
+#ifdef HAVE_OPENMPT
+	if (openmpt_mhandle)
+	{
+		Lock_decoder();
+		openmpt_module_set_render_param(openmpt_mhandle, OPENMPT_MODULE_RENDER_INTERPOLATIONFILTER_LENGTH, filter);
+		Unlock_decoder();
+	}
+#else
+	(void)filter;
+#endif
+}
+
 /// ------------------------
 ///  MUSIC SEEKING
 /// ------------------------
@@ -1070,7 +1300,12 @@ boolean I_SetSongPosition(UINT32 position)
 	{
 		// This isn't 100% correct because we don't account for loop points because we can't get them.
 		// But if you seek past end of song, OpenMPT seeks to 0. So adjust the position anyway.
+		Lock_decoder();
 		openmpt_module_set_position_seconds(openmpt_mhandle, (double)(get_adjusted_position(position)/1000.0L)); // returns new position
+#ifdef MUSIC_DECODE_THREAD
+		FlushDecoder();
+#endif
+		Unlock_decoder();
 		return true;
 	}
 	else
@@ -1106,10 +1341,18 @@ UINT32 I_GetSongPosition(void)
 #ifdef HAVE_GME
 	if (gme)
 	{
-		INT32 position = gme_tell(gme);
-
+		INT32 position;
 		gme_info_t *info;
-		gme_err_t gme_e = gme_track_info(gme, &info, current_track);
+		gme_err_t gme_e;
+
+		Lock_decoder();
+		position = gme_tell(gme);
+		Unlock_decoder();
+#ifdef MUSIC_DECODE_THREAD
+		position = max(position - (INT32)DecoderLatencyMS(), 0);
+#endif
+
+		gme_e = gme_track_info(gme, &info, current_track);
 
 		if (gme_e != NULL)
 		{
@@ -1134,10 +1377,20 @@ UINT32 I_GetSongPosition(void)
 #endif
 #ifdef HAVE_OPENMPT
 	if (openmpt_mhandle)
+	{
 		// This will be incorrect if we adjust for length because we can't get loop points.
 		// So return unadjusted. See note in SetMusicPosition: we adjust for that.
-		return (UINT32)(openmpt_module_get_position_seconds(openmpt_mhandle)*1000.);
+		UINT32 position;
+
+		Lock_decoder();
+		position = (UINT32)(openmpt_module_get_position_seconds(openmpt_mhandle)*1000.);
+		Unlock_decoder();
+#ifdef MUSIC_DECODE_THREAD
+		position -= min(position, DecoderLatencyMS());
+#endif
+		return position;
 		//return get_adjusted_position((UINT32)(openmpt_module_get_position_seconds(openmpt_mhandle)*1000.));
+	}
 	else
 #endif
 	if (!music || I_SongType() == MU_MID)
@@ -1356,7 +1609,12 @@ boolean I_PlaySong(boolean looping)
 			gme_set_autoload_playback_limit(gme, 0);
 #endif
 		gme_set_equalizer(gme, &eq);
+#ifdef MUSIC_DECODE_THREAD
+		decoder_starttrack = 0;
+		StartDecoder();
+#else
 		gme_start_track(gme, 0);
+#endif
 		current_track = 0;
 		Mix_HookMusic(mix_gme, gme);
 		return true;
@@ -1371,6 +1629,9 @@ boolean I_PlaySong(boolean looping)
 		if (looping)
 			openmpt_module_set_repeat_count(openmpt_mhandle, -1); // Always repeat
 		current_subsong = 0;
+#ifdef MUSIC_DECODE_THREAD
+		StartDecoder();
+#endif
 		Mix_HookMusic(mix_openmpt, openmpt_mhandle);
 		return true;
 	}
@@ -1426,6 +1687,9 @@ void I_StopSong(void)
 		Mix_HookMusic(NULL, NULL);
 		current_subsong = -1;
 	}
+#endif
+#ifdef MUSIC_DECODE_THREAD
+	StopDecoder();
 #endif
 	if (music)
 	{
@@ -1492,20 +1756,26 @@ boolean I_SetSongTrack(int track)
 	{
 		if (current_track == track)
 			return false;
-		SDL_LockAudio();
+		Lock_decoder();
 		if (track >= 0 && track < gme_track_count(gme)-1)
 		{
+#ifdef MUSIC_DECODE_THREAD
+			decoder_starttrack = track;
+			FlushDecoder();
+#else
 			gme_err_t gme_e = gme_start_track(gme, track);
 			if (gme_e != NULL)
 			{
 				CONS_Alert(CONS_ERROR, "GME error: %s\n", gme_e);
+				Unlock_decoder();
 				return false;
 			}
+#endif
 			current_track = track;
-			SDL_UnlockAudio();
+			Unlock_decoder();
 			return true;
 		}
-		SDL_UnlockAudio();
+		Unlock_decoder();
 		return false;
 	}
 	else
@@ -1515,15 +1785,18 @@ boolean I_SetSongTrack(int track)
 	{
 		if (current_subsong == track)
 			return false;
-		SDL_LockAudio();
+		Lock_decoder();
 		if (track >= 0 && track < openmpt_module_get_num_subsongs(openmpt_mhandle))
 		{
 			openmpt_module_select_subsong(openmpt_mhandle, track);
+#ifdef MUSIC_DECODE_THREAD
+			FlushDecoder();
+#endif
 			current_subsong = track;
-			SDL_UnlockAudio();
+			Unlock_decoder();
 			return true;
 		}
-		SDL_UnlockAudio();
+		Unlock_decoder();
 
 		return false;
 	}
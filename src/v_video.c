@@ -34,6 +34,14 @@
 #include "hardware/hw_glob.h"
 #endif
 
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VID_SSE2
+#include <emmintrin.h>
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+#define VID_NEON
+#include <arm_neon.h>
+#endif
+
 // Each screen is [vid.width*vid.height];
 UINT8 *screens[5];
 // screens[0] = main display window
@@ -476,6 +484,151 @@ void VID_BlitLinearScreen(const UINT8 *srcptr, UINT8 *destptr, INT32 width, INT3
 	}
 }
 
+// --------------------------------------------------------------------------
+// Expand an 8bpp paletted area into a true color bitmap through a lookup
+// table, replicating every pixel scale times horizontally and vertically.
+// There is no gather in SSE2 or NEON, so the palette lookups stay scalar;
+// the stores and the horizontal pixel replication are vectorized.
+// --------------------------------------------------------------------------
+static void VID_ExpandRow32(UINT32 *dest, const UINT8 *src, INT32 width, INT32 scale, const UINT32 *palette)
+{
+	INT32 x = 0;
+
+	if (scale == 1)
+	{
+		for (; x + 4 <= width; x += 4, src += 4, dest += 4)
+		{
+			dest[0] = palette[src[0]];
+			dest[1] = palette[src[1]];
+			dest[2] = palette[src[2]];
+			dest[3] = palette[src[3]];
+		}
+	}
+#if defined (VID_SSE2)
+	else if (scale == 2)
+	{
+		for (; x + 4 <= width; x += 4, src += 4, dest += 8)
+		{
+			__m128i px = _mm_set_epi32(palette[src[3]], palette[src[2]], palette[src[1]], palette[src[0]]);
+			_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi32(px, px));
+			_mm_storeu_si128((__m128i *)(dest + 4), _mm_unpackhi_epi32(px, px));
+		}
+	}
+	else if (scale == 4)
+	{
+		for (; x + 4 <= width; x += 4, src += 4, dest += 16)
+		{
+			__m128i px = _mm_set_epi32(palette[src[3]], palette[src[2]], palette[src[1]], palette[src[0]]);
+			_mm_storeu_si128((__m128i *)dest, _mm_shuffle_epi32(px, 0x00));
+			_mm_storeu_si128((__m128i *)(dest + 4), _mm_shuffle_epi32(px, 0x55));
+			_mm_storeu_si128((__m128i *)(dest + 8), _mm_shuffle_epi32(px, 0xAA));
+			_mm_storeu_si128((__m128i *)(dest + 12), _mm_shuffle_epi32(px, 0xFF));
+		}
+	}
+#elif defined (VID_NEON)
+	else if (scale == 2)
+	{
+		for (; x + 4 <= width; x += 4, src += 4, dest += 8)
+		{
+			const UINT32 quad[4] = { palette[src[0]], palette[src[1]], palette[src[2]], palette[src[3]] };
+			uint32x4_t px = vld1q_u32(quad);
+			uint32x4x2_t pair = vzipq_u32(px, px);
+			vst1q_u32(dest, pair.val[0]);
+			vst1q_u32(dest + 4, pair.val[1]);
+		}
+	}
+	else if (scale == 4)
+	{
+		for (; x + 4 <= width; x += 4, src += 4, dest += 16)
+		{
+			vst1q_u32(dest, vdupq_n_u32(palette[src[0]]));
+			vst1q_u32(dest + 4, vdupq_n_u32(palette[src[1]]));
+			vst1q_u32(dest + 8, vdupq_n_u32(palette[src[2]]));
+			vst1q_u32(dest + 12, vdupq_n_u32(palette[src[3]]));
+		}
+	}
+#endif
+
+	for (; x < width; x++, src++)
+	{
+		const UINT32 color = palette[*src];
+		INT32 i;
+		for (i = 0; i < scale; i++)
+			*dest++ = color;
+	}
+}
+
+static void VID_ExpandRow16(UINT16 *dest, const UINT8 *src, INT32 width, INT32 scale, const UINT16 *palette)
+{
+	INT32 x = 0;
+
+	if (scale == 1)
+	{
+#if defined (VID_SSE2)
+		for (; x + 8 <= width; x += 8, src += 8, dest += 8)
+		{
+			__m128i px = _mm_set_epi16(palette[src[7]], palette[src[6]], palette[src[5]], palette[src[4]],
+				palette[src[3]], palette[src[2]], palette[src[1]], palette[src[0]]);
+			_mm_storeu_si128((__m128i *)dest, px);
+		}
+#elif defined (VID_NEON)
+		for (; x + 8 <= width; x += 8, src += 8, dest += 8)
+		{
+			const UINT16 oct[8] = { palette[src[0]], palette[src[1]], palette[src[2]], palette[src[3]],
+				palette[src[4]], palette[src[5]], palette[src[6]], palette[src[7]] };
+			vst1q_u16(dest, vld1q_u16(oct));
+		}
+#endif
+		for (; x < width; x++)
+			*dest++ = palette[*src++];
+		return;
+	}
+
+	for (; x < width; x++, src++)
+	{
+		const UINT16 color = palette[*src];
+		INT32 i;
+		for (i = 0; i < scale; i++)
+			*dest++ = color;
+	}
+}
+
+void VID_BlitPalettedScreen32(const UINT8 *srcptr, void *destptr, INT32 width, INT32 height, size_t srcrowbytes,
+	size_t destrowbytes, INT32 scale, const UINT32 *palette)
+{
+	const size_t rowsize = (size_t)width * scale * sizeof (UINT32);
+	UINT8 *dest = destptr;
+	INT32 i;
+
+	while (height--)
+	{
+		VID_ExpandRow32((UINT32 *)dest, srcptr, width, scale, palette);
+		for (i = 1; i < scale; i++)
+			M_Memcpy(dest + destrowbytes*i, dest, rowsize);
+
+		dest += destrowbytes * scale;
+		srcptr += srcrowbytes;
+	}
+}
+
+void VID_BlitPalettedScreen16(const UINT8 *srcptr, void *destptr, INT32 width, INT32 height, size_t srcrowbytes,
+	size_t destrowbytes, INT32 scale, const UINT16 *palette)
+{
+	const size_t rowsize = (size_t)width * scale * sizeof (UINT16);
+	UINT8 *dest = destptr;
+	INT32 i;
+
+	while (height--)
+	{
+		VID_ExpandRow16((UINT16 *)dest, srcptr, width, scale, palette);
+		for (i = 1; i < scale; i++)
+			M_Memcpy(dest + destrowbytes*i, dest, rowsize);
+
+		dest += destrowbytes * scale;
+		srcptr += srcrowbytes;
+	}
+}
+
 static UINT8 hudplusalpha[11]  = { 10,  8,  6,  4,  2,  0,  0,  0,  0,  0,  0};
 static UINT8 hudminusalpha[11] = { 10,  9,  9,  8,  8,  7,  7,  6,  6,  5,  5};
 
@@ -532,7 +685,8 @@ void V_DrawStretchyFixedPatch(fixed_t x, fixed_t y, fixed_t pscale, fixed_t vsca
 	INT32 dupx, dupy;
 	const column_t *column;
 	UINT8 *desttop, *dest, *deststart, *destend;
-	const UINT8 *source, *deststop;
+	const UINT8 *source, *deststop, *screenstart;
+	INT32 pitch;
 	fixed_t pwidth; // patch width
 	fixed_t offx = 0; // x offset
 
@@ -683,6 +837,9 @@ void V_DrawStretchyFixedPatch(fixed_t x, fixed_t y, fixed_t pscale, fixed_t vsca
 	if (!desttop)
 		return;
 
+	// Kept in locals, since the stores to dest could alias the globals.
+	screenstart = desttop;
+	pitch = vid.width;
 	deststop = desttop + vid.rowbytes * vid.height;
 
 	if (scrn & V_NOSCALESTART)
@@ -776,6 +933,7 @@ void V_DrawStretchyFixedPatch(fixed_t x, fixed_t y, fixed_t pscale, fixed_t vsca
 
 		while (column->topdelta != 0xff)
 		{
+			const fixed_t length = column->length<<FRACBITS;
 			topdelta = column->topdelta;
 			if (topdelta <= prevdelta)
 				topdelta += prevdelta;
@@ -784,13 +942,27 @@ void V_DrawStretchyFixedPatch(fixed_t x, fixed_t y, fixed_t pscale, fixed_t vsca
 			dest = desttop;
 			if (scrn & V_FLIP)
 				dest = deststart + (destend - desttop);
-			dest += FixedInt(FixedMul(topdelta<<FRACBITS,vdup))*vid.width;
+			dest += FixedInt(FixedMul(topdelta<<FRACBITS,vdup))*pitch;
 
-			for (ofs = 0; dest < deststop && (ofs>>FRACBITS) < column->length; ofs += rowfrac)
+			// Opaque posts (most text and HUD graphics) are copied directly
+			// instead of calling patchdrawfunc for every pixel.
+			if (patchdrawfunc == standardpdraw)
 			{
-				if (dest >= screens[scrn&V_PARAMMASK]) // don't draw off the top of the screen (CRASH PREVENTION)
-					*dest = patchdrawfunc(dest, source, ofs);
-				dest += vid.width;
+				for (ofs = 0; dest < deststop && ofs < length; ofs += rowfrac, dest += pitch)
+					if (dest >= screenstart) // don't draw off the top of the screen (CRASH PREVENTION)
+						*dest = source[ofs>>FRACBITS];
+			}
+			else if (patchdrawfunc == mappedpdraw)
+			{
+				for (ofs = 0; dest < deststop && ofs < length; ofs += rowfrac, dest += pitch)
+					if (dest >= screenstart)
+						*dest = colormap[source[ofs>>FRACBITS]];
+			}
+			else
+			{
+				for (ofs = 0; dest < deststop && ofs < length; ofs += rowfrac, dest += pitch)
+					if (dest >= screenstart)
+						*dest = patchdrawfunc(dest, source, ofs);
 			}
 			column = (const column_t *)((const UINT8 *)column + column->length + 4);
 		}
@@ -3606,7 +3778,7 @@ INT32 V_NameTagWidth(const char *string)
 	if (!string)
 		return 0;
 
-	for (i = 0; i < strlen(string); i++)
+	for (i = 0; string[i]; i++)
 	{
 		c = toupper(string[i]) - NT_FONTSTART;
 		if (c < 0 || c >= NT_FONTSIZE || !ntb_font[c] || !nto_font[c])
@@ -3629,7 +3801,7 @@ INT32 V_CreditStringWidth(const char *string)
 	if (!string)
 		return 0;
 
-	for (i = 0; i < strlen(string); i++)
+	for (i = 0; string[i]; i++)
 	{
 		c = toupper(string[i]) - CRED_FONTSTART;
 		if (c < 0 || c >= CRED_FONTSIZE)
@@ -3717,7 +3889,7 @@ INT32 V_LevelNameWidth(const char *string)
 	INT32 c, w = 0;
 	size_t i;
 
-	for (i = 0; i < strlen(string); i++)
+	for (i = 0; string[i]; i++)
 	{
 		if (string[i] & 0x80)
 			continue;
@@ -3738,7 +3910,7 @@ INT32 V_LevelNameHeight(const char *string)
 	INT32 c, w = 0;
 	size_t i;
 
-	for (i = 0; i < strlen(string); i++)
+	for (i = 0; string[i]; i++)
 	{
 		c = string[i] - LT_FONTSTART;
 		if (c < 0 || c >= LT_FONTSIZE || !lt_font[c])
@@ -3792,7 +3964,7 @@ INT32 V_StringWidth(const char *string, INT32 option)
 			break;
 	}
 
-	for (i = 0; i < strlen(string); i++)
+	for (i = 0; string[i]; i++)
 	{
 		if (string[i] & 0x80)
 			continue;
@@ -3832,7 +4004,7 @@ INT32 V_SmallStringWidth(const char *string, INT32 option)
 			break;
 	}
 
-	for (i = 0; i < strlen(string); i++)
+	for (i = 0; string[i]; i++)
 	{
 		if (string[i] & 0x80)
 			continue;
@@ -3869,7 +4041,7 @@ INT32 V_ThinStringWidth(const char *string, INT32 option)
 			break;
 	}
 
-	for (i = 0; i < strlen(string); i++)
+	for (i = 0; string[i]; i++)
 	{
 		if (string[i] & 0x80)
 			continue;
@@ -294,4 +294,10 @@ void V_DrawPatchFill(patch_t *pat);
 void VID_BlitLinearScreen(const UINT8 *srcptr, UINT8 *destptr, INT32 width, INT32 height, size_t srcrowbytes,
 	size_t destrowbytes);
 
+// Expand an 8bpp area to 32bpp/16bpp through a palette LUT, integer scaled
+void VID_BlitPalettedScreen32(const UINT8 *srcptr, void *destptr, INT32 width, INT32 height, size_t srcrowbytes,
+	size_t destrowbytes, INT32 scale, const UINT32 *palette);
+void VID_BlitPalettedScreen16(const UINT8 *srcptr, void *destptr, INT32 width, INT32 height, size_t srcrowbytes,
+	size_t destrowbytes, INT32 scale, const UINT16 *palette);
+
 #endif
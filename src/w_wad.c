@@ -44,6 +44,8 @@
 #include "lzf.h"
 #endif
 
+#include <sys/stat.h>
+
 #include "doomdef.h"
 #include "doomstat.h"
 #include "doomtype.h"
@@ -66,6 +68,7 @@
 #include "i_time.h"
 #include "i_system.h"
 #include "i_video.h" // rendermode
+#include "i_threads.h"
 #include "md5.h"
 #include "lua_script.h"
 #ifdef SCANTHINGS
@@ -147,6 +150,8 @@ void W_Shutdown(void)
 	}
 
 	Z_Free(wadfiles);
+
+	W_SaveMD5Cache();
 }
 
 //===========================================================================
@@ -199,6 +204,411 @@ static void MD5FromString(const char *matchmd5, UINT8 *realmd5)
 }
 #endif
 
+//===========================================================================
+//                                                                 MD5 CACHE
+//===========================================================================
+
+// Hashing every addon on every startup and every join gets slow once there
+// are a few hundred megabytes of them, so sums are remembered by path, size
+// and modification time, and kept across sessions in MD5CACHEFILE.
+// Files can also be hashed ahead of time by a few worker threads.
+
+#define MD5CACHEFILE "md5cache.txt"
+#define MD5CACHEBUCKETS 512
+
+#ifndef NOMD5
+typedef struct md5cacheentry_s
+{
+	struct md5cacheentry_s *next;
+	unsigned long size;
+	unsigned long mtime;
+	UINT8 md5sum[MD5_LEN];
+	char path[1]; // allocated with the entry
+} md5cacheentry_t;
+
+static md5cacheentry_t *md5cache[MD5CACHEBUCKETS];
+static boolean md5cacheloaded = false;
+static boolean md5cachedirty = false;
+
+// Totals for the startup log
+static UINT32 md5fileshashed, md5cachehits;
+static UINT64 md5byteshashed;
+
+#ifdef HAVE_THREADS
+static I_mutex md5cache_mutex;
+#define Lock_md5cache() I_lock_mutex(&md5cache_mutex)
+#define Unlock_md5cache() I_unlock_mutex(md5cache_mutex)
+#else
+#define Lock_md5cache()
+#define Unlock_md5cache()
+#endif
+
+static UINT32 W_MD5CacheBucket(const char *path)
+{
+	UINT32 hash = 2166136261u;
+	while (*path)
+		hash = (hash ^ (UINT8)*path++) * 16777619u;
+	return hash % MD5CACHEBUCKETS;
+}
+
+// Must be called with md5cache_mutex held.
+static md5cacheentry_t *W_FindMD5CacheEntry(const char *path)
+{
+	md5cacheentry_t *entry;
+
+	for (entry = md5cache[W_MD5CacheBucket(path)]; entry; entry = entry->next)
+		if (!strcmp(entry->path, path))
+			return entry;
+
+	return NULL;
+}
+
+// Must be called with md5cache_mutex held.
+static void W_SetMD5CacheEntry(const char *path, unsigned long size, unsigned long mtime, const UINT8 *md5sum)
+{
+	md5cacheentry_t *entry = W_FindMD5CacheEntry(path);
+
+	if (!entry)
+	{
+		UINT32 bucket = W_MD5CacheBucket(path);
+		size_t len = strlen(path);
+
+		entry = malloc(sizeof (*entry) + len);
+		if (!entry)
+			return;
+		memcpy(entry->path, path, len + 1);
+		entry->next = md5cache[bucket];
+		md5cache[bucket] = entry;
+	}
+
+	entry->size = size;
+	entry->mtime = mtime;
+	memcpy(entry->md5sum, md5sum, MD5_LEN);
+}
+
+// Must be called with md5cache_mutex held.
+static void W_LoadMD5Cache(void)
+{
+	char line[MAX_WADPATH + 64];
+	FILE *f;
+
+	md5cacheloaded = true;
+
+	snprintf(line, sizeof line, "%s" PATHSEP MD5CACHEFILE, srb2home);
+	f = fopen(line, "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof line, f))
+	{
+		char hex[2*MD5_LEN + 1];
+		unsigned long size, mtime;
+		UINT8 md5sum[MD5_LEN];
+		size_t len;
+		int pathstart = 0;
+
+		if (sscanf(line, "%32s %lu %lu %n", hex, &size, &mtime, &pathstart) < 3
+			|| !pathstart || strlen(hex) != 2*MD5_LEN)
+			continue;
+
+		len = strlen(line);
+		while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+			line[--len] = '\0';
+		if ((size_t)pathstart >= len)
+			continue;
+
+		MD5FromString(hex, md5sum);
+		W_SetMD5CacheEntry(&line[pathstart], size, mtime, md5sum);
+	}
+
+	fclose(f);
+}
+
+/** Hashes a file on disk, or takes its sum from the MD5 cache if the file's
+  * size and modification time haven't changed since it was last hashed.
+  * Safe to call from any thread.
+  *
+  * \param filename path of file
+  * \param resblock resulting MD5 checksum
+  * \return 0 if MD5 checksum was made, and is at resblock, 1 if error was found
+  */
+INT32 W_GetFileMD5(const char *filename, void *resblock)
+{
+	struct stat fsstat;
+	md5cacheentry_t *entry;
+	unsigned long size, mtime;
+	FILE *f;
+	INT32 ret;
+
+	if (stat(filename, &fsstat) != 0 || S_ISDIR(fsstat.st_mode))
+		return 1;
+
+	size = (unsigned long)fsstat.st_size;
+	mtime = (unsigned long)fsstat.st_mtime;
+
+	Lock_md5cache();
+	{
+		if (!md5cacheloaded)
+			W_LoadMD5Cache();
+
+		entry = W_FindMD5CacheEntry(filename);
+		if (entry && entry->size == size && entry->mtime == mtime)
+		{
+			memcpy(resblock, entry->md5sum, MD5_LEN);
+			md5cachehits++;
+			Unlock_md5cache();
+			return 0;
+		}
+	}
+	Unlock_md5cache();
+
+	if ((f = fopen(filename, "rb")) == NULL)
+		return 1;
+
+	// No per-file timing here, since this runs on the hashing threads;
+	// W_HashMultipleFiles prints the totals instead.
+	ret = md5_stream(f, resblock);
+	fclose(f);
+
+	if (ret)
+		return 1;
+
+	Lock_md5cache();
+	{
+		W_SetMD5CacheEntry(filename, size, mtime, resblock);
+		md5cachedirty = true;
+		md5fileshashed++;
+		md5byteshashed += size;
+	}
+	Unlock_md5cache();
+
+	return 0;
+}
+
+/** Writes the MD5 cache back to srb2home if anything was hashed.
+  * Entries for files that no longer exist are dropped.
+  */
+void W_SaveMD5Cache(void)
+{
+	struct stat fsstat;
+	md5cacheentry_t *entry;
+	char hex[2*MD5_LEN + 1];
+	FILE *f;
+	size_t i;
+#ifdef HAVE_THREADS
+	boolean locked;
+#endif
+
+	W_WaitFileMD5s();
+
+	if (!md5cachedirty)
+		return;
+
+	f = fopen(va("%s" PATHSEP MD5CACHEFILE, srb2home), "w");
+	if (!f)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Couldn't save the MD5 cache: %s\n"), strerror(errno));
+		return;
+	}
+
+#ifdef HAVE_THREADS
+	// The mutex is destroyed when threads stop at shutdown, by which
+	// point nothing else can be touching the cache.
+	locked = !I_thread_is_stopped();
+	if (locked)
+		Lock_md5cache();
+#endif
+
+	for (i = 0; i < MD5CACHEBUCKETS; i++)
+	{
+		for (entry = md5cache[i]; entry; entry = entry->next)
+		{
+			if (stat(entry->path, &fsstat) != 0)
+				continue;
+
+			PrintMD5String(entry->md5sum, hex);
+			fprintf(f, "%s %lu %lu %s\n", hex, entry->size, entry->mtime, entry->path);
+		}
+	}
+
+	md5cachedirty = false;
+#ifdef HAVE_THREADS
+	if (locked)
+		Unlock_md5cache();
+#endif
+
+	fclose(f);
+}
+
+//
+// Hashing ahead
+//
+// W_QueueFileMD5 hands files to a few worker threads so that the sums are
+// already cached by the time W_InitFile or findfile asks for them.
+//
+#ifdef HAVE_THREADS
+#define MD5WORKERS 4
+
+typedef struct md5job_s
+{
+	struct md5job_s *next;
+	char filename[MAX_WADPATH];
+} md5job_t;
+
+static I_mutex md5job_mutex;
+static I_cond  md5job_cond;
+static md5job_t *md5jobs, **md5jobtail = &md5jobs;
+static INT32 md5workers; // worker threads running
+#endif
+
+// Finds the file the way W_OpenWadFile would, then hashes it into the cache.
+static void W_HashFileAhead(char *filename)
+{
+	struct stat fsstat;
+	UINT8 md5sum[MD5_LEN];
+
+	if (stat(filename, &fsstat) != 0)
+	{
+		nameonly(filename);
+		if (findfile(filename, NULL, true) != FS_FOUND)
+			return;
+	}
+
+	W_GetFileMD5(filename, md5sum);
+}
+
+#ifdef HAVE_THREADS
+static void W_MD5WorkerThread(void *userdata)
+{
+	md5job_t *job;
+
+	(void)userdata;
+
+	for (;;)
+	{
+		I_lock_mutex(&md5job_mutex);
+		{
+			job = md5jobs;
+			if (!job)
+			{
+				md5workers--;
+				I_wake_all_cond(&md5job_cond);
+				I_unlock_mutex(md5job_mutex);
+				return;
+			}
+			md5jobs = job->next;
+			if (!md5jobs)
+				md5jobtail = &md5jobs;
+		}
+		I_unlock_mutex(md5job_mutex);
+
+		W_HashFileAhead(job->filename);
+		free(job);
+	}
+}
+#endif
+
+/** Hashes a file into the MD5 cache in the background.
+  * Without threads, the file is hashed right away.
+  *
+  * \param filename path of file, or just its name to search for it
+  */
+void W_QueueFileMD5(const char *filename)
+{
+#ifdef HAVE_THREADS
+	if (!I_thread_is_stopped())
+	{
+		md5job_t *job = malloc(sizeof (*job));
+
+		if (job)
+		{
+			strlcpy(job->filename, filename, MAX_WADPATH);
+			job->next = NULL;
+
+			I_lock_mutex(&md5job_mutex);
+			{
+				*md5jobtail = job;
+				md5jobtail = &job->next;
+				if (md5workers < MD5WORKERS)
+				{
+					md5workers++;
+					I_spawn_thread("md5-worker", (I_thread_fn)W_MD5WorkerThread, NULL);
+				}
+			}
+			I_unlock_mutex(md5job_mutex);
+			return;
+		}
+	}
+#endif
+	{
+		char buf[MAX_WADPATH];
+		strlcpy(buf, filename, MAX_WADPATH);
+		W_HashFileAhead(buf);
+	}
+}
+
+// Returns true while queued files are still being hashed.
+boolean W_FileMD5sPending(void)
+{
+#ifdef HAVE_THREADS
+	boolean pending;
+
+	if (I_thread_is_stopped())
+		return false;
+
+	I_lock_mutex(&md5job_mutex);
+	pending = (md5workers != 0);
+	I_unlock_mutex(md5job_mutex);
+
+	return pending;
+#else
+	return false;
+#endif
+}
+
+// Blocks until every queued file has been hashed.
+void W_WaitFileMD5s(void)
+{
+#ifdef HAVE_THREADS
+	// The workers were joined when threads stopped.
+	if (I_thread_is_stopped())
+		return;
+
+	I_lock_mutex(&md5job_mutex);
+	{
+		while (md5workers)
+			I_hold_cond(&md5job_cond, md5job_mutex);
+	}
+	I_unlock_mutex(md5job_mutex);
+#endif
+}
+#else
+INT32 W_GetFileMD5(const char *filename, void *resblock)
+{
+	(void)filename;
+	memset(resblock, 0x00, 16);
+	return 0;
+}
+
+void W_SaveMD5Cache(void)
+{
+}
+
+void W_QueueFileMD5(const char *filename)
+{
+	(void)filename;
+}
+
+boolean W_FileMD5sPending(void)
+{
+	return false;
+}
+
+void W_WaitFileMD5s(void)
+{
+}
+#endif
+
 //===========================================================================
 //                                                             FILE UNPACKING
 //===========================================================================
@@ -792,14 +1202,14 @@ static inline INT32 W_MakeFileMD5(const char *filename, fhandletype_t handletype
 {
 #ifdef NOMD5
 	(void)filename;
-	(void)type;
+	(void)handletype;
 	memset(resblock, 0x00, 16);
 #else
 	void *fhandle;
 
-#ifndef HAVE_WHANDLE
-	(void)handletype;
-#endif
+	// Files on disk go through the MD5 cache
+	if (handletype == FILEHANDLE_STANDARD)
+		return W_GetFileMD5(filename, resblock);
 
 	if ((fhandle = File_Open(filename, "rb", handletype)) != NULL)
 	{
@@ -2047,6 +2457,57 @@ UINT16 W_InitFolder(const char *path, boolean mainfile, boolean startup)
 	return wadfile->numlumps;
 }
 
+/** Hashes a list of files into the MD5 cache in parallel, and prints how
+  * long it took.
+  *
+  * \param list A list of files to hash. Folders are skipped.
+  */
+static void W_HashMultipleFiles(addfilelist_t *list)
+{
+#ifndef NOMD5
+	static boolean savequeued = false;
+	UINT32 hashed = md5fileshashed, hits = md5cachehits;
+	UINT64 bytes = md5byteshashed;
+	precise_t t = I_GetPreciseTime();
+	double ms, mb;
+	size_t i;
+
+	for (i = 0; i < list->numfiles; i++)
+	{
+		const char *fn = list->files[i];
+		char pathsep = fn[strlen(fn) - 1];
+
+		if (pathsep != '\\' && pathsep != '/')
+			W_QueueFileMD5(fn);
+	}
+
+	W_WaitFileMD5s();
+
+	ms = (double)(I_GetPreciseTime() - t) * 1000.0 / I_GetPrecisePrecision();
+	hashed = md5fileshashed - hashed;
+	hits = md5cachehits - hits;
+	mb = (double)(md5byteshashed - bytes) / (1024.0 * 1024.0);
+
+	if (hashed)
+		CONS_Printf("W_InitMultipleFiles(): Hashed %u files (%.1f MB) in %.0f ms, %.1f MB/s, %u unchanged.\n",
+			hashed, mb, ms, ms > 0.0 ? mb * 1000.0 / ms : 0.0, hits);
+	else if (hits)
+		CONS_Printf("W_InitMultipleFiles(): %u files unchanged, using cached MD5s.\n", hits);
+
+	W_SaveMD5Cache();
+
+	// Also save at exit, before I_stop_threads takes the mutexes away.
+	// Quit functions run newest first, and threads start before this.
+	if (!savequeued)
+	{
+		I_AddExitFunc(W_SaveMD5Cache);
+		savequeued = true;
+	}
+#else
+	(void)list;
+#endif
+}
+
 /** Tries to load a series of files.
   * All files are wads unless they have an extension of ".soc" or ".lua".
   *
@@ -2060,6 +2521,11 @@ void W_InitMultipleFiles(addfilelist_t *list, fhandletype_t handletype)
 {
 	size_t i = 0;
 
+	// Hash everything up front on the worker threads, W_InitFile then
+	// only has to look the sums up.
+	if (handletype == FILEHANDLE_STANDARD)
+		W_HashMultipleFiles(list);
+
 	for (; i < list->numfiles; i++)
 	{
 		const char *fn = list->files[i];
@@ -174,6 +174,13 @@ void W_DeleteResourceFile(wadfile_t *wad);
 // W_InitMultipleFiles exits if a file was not found, but not if all is okay.
 void W_InitMultipleFiles(addfilelist_t *list, fhandletype_t handletype);
 
+// MD5 sums of files on disk, cached by path, size and modification time
+INT32 W_GetFileMD5(const char *filename, void *resblock);
+void W_QueueFileMD5(const char *filename);
+boolean W_FileMD5sPending(void);
+void W_WaitFileMD5s(void);
+void W_SaveMD5Cache(void);
+
 #define W_FileHasFolders(wadfile) ((wadfile)->type == RET_PK3 || (wadfile)->type == RET_FOLDER)
 
 // Prints an error in the console if something goes wrong while adding a file.